@@ -38,8 +38,17 @@
 
 #define BLOCK_SIZE 10240
 
+/* Most images have their size in the first KB, but JPEG files can have
+ * big EXIF data before the frame header */
+#define MAX_PROBE_SIZE (128 * 1024)
+
 typedef struct _ComicsDocumentClass ComicsDocumentClass;
 
+typedef struct {
+	int width;
+	int height;
+} PageSize;
+
 struct _ComicsDocumentClass
 {
 	EvDocumentClass parent_class;
@@ -52,7 +61,7 @@ struct _ComicsDocument
 	gchar         *archive_path;
 	gchar         *archive_uri;
 	GPtrArray     *page_names; /* elem: char * */
-	GHashTable    *page_positions; /* key: char *, value: uint + 1 */
+	PageSize      *page_sizes; /* 0x0 when not known yet */
 };
 
 G_DEFINE_TYPE (ComicsDocument, comics_document, EV_TYPE_DOCUMENT)
@@ -144,32 +153,6 @@ is_apple_double (const char *name)
 	return ret;
 }
 
-static gboolean
-archive_reopen_if_needed (ComicsDocument  *comics_document,
-			  const char      *page_wanted,
-			  GError         **error)
-{
-	const char *current_page;
-	guint current_page_idx, page_wanted_idx;
-
-	if (ev_archive_at_entry (comics_document->archive)) {
-		current_page = ev_archive_get_entry_pathname (comics_document->archive);
-		if (current_page) {
-			current_page_idx = GPOINTER_TO_UINT (g_hash_table_lookup (comics_document->page_positions, current_page));
-			page_wanted_idx = GPOINTER_TO_UINT (g_hash_table_lookup (comics_document->page_positions, page_wanted));
-
-			if (current_page_idx != 0 &&
-			    page_wanted_idx != 0 &&
-			    page_wanted_idx > current_page_idx)
-				return TRUE;
-		}
-
-		ev_archive_reset (comics_document->archive);
-	}
-
-	return ev_archive_open_filename (comics_document->archive, comics_document->archive_path, error);
-}
-
 static GPtrArray *
 comics_document_list (ComicsDocument  *comics_document,
 		      GError         **error)
@@ -274,18 +257,6 @@ out:
 	return array;
 }
 
-static GHashTable *
-save_positions (GPtrArray *page_names)
-{
-	guint i;
-	GHashTable *ht;
-
-	ht = g_hash_table_new (g_str_hash, g_str_equal);
-	for (i = 0; i < page_names->len; i++)
-		g_hash_table_insert (ht, page_names->pdata[i], GUINT_TO_POINTER(i + 1));
-	return ht;
-}
-
 /* This function chooses the archive decompression support
  * book based on its mime type. */
 static gboolean
@@ -381,8 +352,7 @@ comics_document_load (EvDocument *document,
 	if (!comics_document->page_names)
 		return FALSE;
 
-	/* Keep an index */
-	comics_document->page_positions = save_positions (comics_document->page_names);
+	comics_document->page_sizes = g_new0 (PageSize, comics_document->page_names->len);
 
         /* Now sort the pages */
         g_ptr_array_sort (comics_document->page_names, sort_page_names);
@@ -428,74 +398,276 @@ get_page_size_prepared_cb (GdkPixbufLoader *loader,
 	info->width = width;
 }
 
+typedef enum {
+	PROBE_FOUND,
+	PROBE_NEED_DATA,
+	PROBE_UNKNOWN
+} ProbeResult;
+
+static inline guint16
+read_be16 (const guchar *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static inline guint32
+read_be32 (const guchar *p)
+{
+	return ((guint32)read_be16 (p) << 16) | read_be16 (p + 2);
+}
+
+static inline guint16
+read_le16 (const guchar *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline guint32
+read_le24 (const guchar *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+static ProbeResult
+probe_jpeg_size (const guchar *data,
+		 gsize         len,
+		 int          *width,
+		 int          *height)
+{
+	gsize pos = 2;
+
+	while (pos + 4 <= len) {
+		guchar marker;
+
+		if (data[pos] != 0xff)
+			return PROBE_UNKNOWN;
+
+		marker = data[pos + 1];
+		if (marker == 0xff) {
+			/* Fill byte */
+			pos++;
+			continue;
+		}
+
+		if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8)) {
+			/* Markers without a segment */
+			pos += 2;
+			continue;
+		}
+
+		if (marker == 0xd9 || marker == 0xda)
+			return PROBE_UNKNOWN;
+
+		/* SOFn, except DHT, JPG and DAC */
+		if (marker >= 0xc0 && marker <= 0xcf &&
+		    marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+			if (pos + 9 > len)
+				return PROBE_NEED_DATA;
+
+			*height = read_be16 (data + pos + 5);
+			*width = read_be16 (data + pos + 7);
+
+			/* The height is 0 when it's given by a DNL marker
+			 * after the first scan, leave it to the loader */
+			if (*width == 0 || *height == 0)
+				return PROBE_UNKNOWN;
+
+			return PROBE_FOUND;
+		}
+
+		pos += 2 + read_be16 (data + pos + 2);
+	}
+
+	return PROBE_NEED_DATA;
+}
+
+/* Uses the biggest image spatial extents property, the primary image of
+ * a grid is bigger than its tiles */
+static ProbeResult
+probe_avif_size (const guchar *data,
+		 gsize         len,
+		 int          *width,
+		 int          *height)
+{
+	gsize    pos;
+	guint64  max_area = 0;
+
+	for (pos = 4; pos + 16 <= len; pos++) {
+		guint32 w, h;
+
+		if (memcmp (data + pos, "ispe", 4) != 0)
+			continue;
+
+		w = read_be32 (data + pos + 8);
+		h = read_be32 (data + pos + 12);
+		if ((guint64)w * h > max_area && w <= G_MAXINT && h <= G_MAXINT) {
+			max_area = (guint64)w * h;
+			*width = w;
+			*height = h;
+		}
+	}
+
+	/* The properties are in the meta box, before the image data */
+	if (max_area > 0)
+		return PROBE_FOUND;
+
+	return len < MAX_PROBE_SIZE ? PROBE_NEED_DATA : PROBE_UNKNOWN;
+}
+
+/* Gets the size of an image from its header, without decoding it */
+static ProbeResult
+probe_image_size (const guchar *data,
+		  gsize         len,
+		  int          *width,
+		  int          *height)
+{
+	if (len < 32)
+		return PROBE_NEED_DATA;
+
+	if (memcmp (data, "\x89PNG\r\n\x1a\n", 8) == 0) {
+		if (memcmp (data + 12, "IHDR", 4) != 0)
+			return PROBE_UNKNOWN;
+
+		*width = read_be32 (data + 16);
+		*height = read_be32 (data + 20);
+	} else if (data[0] == 0xff && data[1] == 0xd8) {
+		return probe_jpeg_size (data, len, width, height);
+	} else if (memcmp (data, "GIF87a", 6) == 0 || memcmp (data, "GIF89a", 6) == 0) {
+		*width = read_le16 (data + 6);
+		*height = read_le16 (data + 8);
+	} else if (memcmp (data, "RIFF", 4) == 0 && memcmp (data + 8, "WEBP", 4) == 0) {
+		if (memcmp (data + 12, "VP8 ", 4) == 0) {
+			if (data[23] != 0x9d || data[24] != 0x01 || data[25] != 0x2a)
+				return PROBE_UNKNOWN;
+
+			*width = read_le16 (data + 26) & 0x3fff;
+			*height = read_le16 (data + 28) & 0x3fff;
+		} else if (memcmp (data + 12, "VP8L", 4) == 0) {
+			guint32 bits;
+
+			if (data[20] != 0x2f)
+				return PROBE_UNKNOWN;
+
+			bits = read_le24 (data + 21) | (data[24] << 24);
+			*width = (bits & 0x3fff) + 1;
+			*height = ((bits >> 14) & 0x3fff) + 1;
+		} else if (memcmp (data + 12, "VP8X", 4) == 0) {
+			*width = read_le24 (data + 24) + 1;
+			*height = read_le24 (data + 27) + 1;
+		} else {
+			return PROBE_UNKNOWN;
+		}
+	} else if (memcmp (data + 4, "ftyp", 4) == 0 &&
+		   (memcmp (data + 8, "avif", 4) == 0 || memcmp (data + 8, "avis", 4) == 0)) {
+		return probe_avif_size (data, len, width, height);
+	} else {
+		return PROBE_UNKNOWN;
+	}
+
+	return *width > 0 && *height > 0 ? PROBE_FOUND : PROBE_UNKNOWN;
+}
+
+/* How much to read of an entry with @left bytes left, entries of unknown
+ * size (-1) are read until the end */
+static gsize
+read_size (gint64 left)
+{
+	return left < 0 ? BLOCK_SIZE : MIN (BLOCK_SIZE, left);
+}
+
 static void
 comics_document_get_page_size (EvDocument *document,
 			       EvPage     *page,
 			       double     *width,
 			       double     *height)
 {
-	GdkPixbufLoader *loader;
+	GdkPixbufLoader *loader = NULL;
 	ComicsDocument *comics_document = COMICS_DOCUMENT (document);
+	PageSize *page_size = &comics_document->page_sizes[page->index];
 	const char *page_path;
 	PixbufInfo info;
 	GError *error = NULL;
+	GByteArray *header;
+	char buf[BLOCK_SIZE];
+	gssize read;
+	gint64 left;
+
+	if (page_size->width > 0) {
+		if (width)
+			*width = page_size->width;
+		if (height)
+			*height = page_size->height;
+		return;
+	}
 
 	page_path = g_ptr_array_index (comics_document->page_names, page->index);
 
-	if (!archive_reopen_if_needed (comics_document, page_path, &error)) {
-		g_warning ("Fatal error opening archive: %s", error->message);
+	if (!ev_archive_seek_entry (comics_document->archive, page_path, &error)) {
+		g_warning ("Fatal error handling archive (%s): %s", G_STRFUNC, error->message);
 		g_error_free (error);
 		return;
 	}
 
-	loader = gdk_pixbuf_loader_new ();
 	info.got_info = FALSE;
-	g_signal_connect (loader, "size-prepared",
-			  G_CALLBACK (get_page_size_prepared_cb),
-			  &info);
-
-	while (1) {
-		const char *name;
-		GError *error = NULL;
-
-		if (!ev_archive_read_next_header (comics_document->archive, &error)) {
-			if (error != NULL) {
-				g_warning ("Fatal error handling archive (%s): %s", G_STRFUNC, error->message);
-				g_error_free (error);
+	header = g_byte_array_new ();
+
+	/* Only decode the image when its size isn't in the header */
+	left = ev_archive_get_entry_size (comics_document->archive);
+	read = ev_archive_read_data (comics_document->archive, buf,
+				     read_size (left), &error);
+	while (read > 0 && !info.got_info) {
+		if (!loader) {
+			ProbeResult result;
+
+			g_byte_array_append (header, (guchar *) buf, read);
+			result = probe_image_size (header->data, header->len,
+						   &info.width, &info.height);
+			if (result == PROBE_FOUND) {
+				info.got_info = TRUE;
+				break;
 			}
-			break;
-		}
 
-		name = ev_archive_get_entry_pathname (comics_document->archive);
-		if (g_strcmp0 (name, page_path) == 0) {
-			char buf[BLOCK_SIZE];
-			gssize read;
-			gint64 left;
-
-			left = ev_archive_get_entry_size (comics_document->archive);
-			read = ev_archive_read_data (comics_document->archive, buf,
-						     MIN(BLOCK_SIZE, left), &error);
-			while (read > 0 && !info.got_info) {
-				if (!gdk_pixbuf_loader_write (loader, (guchar *) buf, read, &error)) {
+			if (result == PROBE_UNKNOWN || header->len >= MAX_PROBE_SIZE) {
+				g_debug ("Decoding '%s' to get its size", page_path);
+				loader = gdk_pixbuf_loader_new ();
+				g_signal_connect (loader, "size-prepared",
+						  G_CALLBACK (get_page_size_prepared_cb),
+						  &info);
+				if (!gdk_pixbuf_loader_write (loader, header->data, header->len, &error)) {
 					read = -1;
 					break;
 				}
-				left -= read;
-				read = ev_archive_read_data (comics_document->archive, buf,
-							     MIN(BLOCK_SIZE, left), &error);
-			}
-			if (read < 0) {
-				g_warning ("Fatal error reading '%s' in archive: %s", name, error->message);
-				g_error_free (error);
 			}
+		} else if (!gdk_pixbuf_loader_write (loader, (guchar *) buf, read, &error)) {
+			read = -1;
 			break;
 		}
+		left -= read;
+		read = ev_archive_read_data (comics_document->archive, buf,
+					     read_size (left), &error);
 	}
+	if (read < 0) {
+		g_warning ("Fatal error reading '%s' in archive: %s", page_path, error->message);
+		g_error_free (error);
+	} else if (!info.got_info && !loader) {
+		/* The whole image was read without finding its size */
+		loader = gdk_pixbuf_loader_new ();
+		g_signal_connect (loader, "size-prepared",
+				  G_CALLBACK (get_page_size_prepared_cb),
+				  &info);
+		gdk_pixbuf_loader_write (loader, header->data, header->len, NULL);
+	}
+	g_byte_array_unref (header);
 
-	gdk_pixbuf_loader_close (loader, NULL);
-	g_object_unref (loader);
+	if (loader) {
+		gdk_pixbuf_loader_close (loader, NULL);
+		g_object_unref (loader);
+	}
 
 	if (info.got_info) {
+		page_size->width = info.width;
+		page_size->height = info.height;
+
 		if (width)
 			*width = info.width;
 		if (height)
@@ -525,11 +697,14 @@ comics_document_render_pixbuf (EvDocument      *document,
 	ComicsDocument *comics_document = COMICS_DOCUMENT (document);
 	const char *page_path;
 	GError *error = NULL;
+	char buf[BLOCK_SIZE];
+	gssize read;
+	gint64 left;
 
 	page_path = g_ptr_array_index (comics_document->page_names, rc->page->index);
 
-	if (!archive_reopen_if_needed (comics_document, page_path, &error)) {
-		g_warning ("Fatal error opening archive: %s", error->message);
+	if (!ev_archive_seek_entry (comics_document->archive, page_path, &error)) {
+		g_warning ("Fatal error handling archive (%s): %s", G_STRFUNC, error->message);
 		g_error_free (error);
 		return NULL;
 	}
@@ -539,40 +714,26 @@ comics_document_render_pixbuf (EvDocument      *document,
 			  G_CALLBACK (render_pixbuf_size_prepared_cb),
 			  rc);
 
-	while (1) {
-		const char *name;
-
-		if (!ev_archive_read_next_header (comics_document->archive, &error)) {
-			if (error != NULL) {
-				g_warning ("Fatal error handling archive (%s): %s", G_STRFUNC, error->message);
-				g_error_free (error);
-			}
+	/* The image is fed as it's decompressed, the loader decodes it
+	 * directly at the size set in size-prepared when the format
+	 * supports it, like JPEG */
+	left = ev_archive_get_entry_size (comics_document->archive);
+	read = ev_archive_read_data (comics_document->archive, buf,
+				     read_size (left), &error);
+	if (read == 0)
+		g_warning ("Read an empty file from the archive");
+	while (read > 0) {
+		if (!gdk_pixbuf_loader_write (loader, (guchar *) buf, read, NULL))
 			break;
-		}
-
-		name = ev_archive_get_entry_pathname (comics_document->archive);
-		if (g_strcmp0 (name, page_path) == 0) {
-			size_t size = ev_archive_get_entry_size (comics_document->archive);
-			char *buf;
-			ssize_t read;
-
-			buf = g_malloc (size);
-			read = ev_archive_read_data (comics_document->archive, buf, size, &error);
-			if (read <= 0) {
-				if (read < 0) {
-					g_warning ("Fatal error reading '%s' in archive: %s", name, error->message);
-					g_error_free (error);
-				} else {
-					g_warning ("Read an empty file from the archive");
-				}
-			} else {
-				gdk_pixbuf_loader_write (loader, (guchar *) buf, size, NULL);
-			}
-			g_free (buf);
-			gdk_pixbuf_loader_close (loader, NULL);
-			break;
-		}
+		left -= read;
+		read = ev_archive_read_data (comics_document->archive, buf,
+					     read_size (left), &error);
 	}
+	if (read < 0) {
+		g_warning ("Fatal error reading '%s' in archive: %s", page_path, error->message);
+		g_error_free (error);
+	}
+	gdk_pixbuf_loader_close (loader, NULL);
 
 	tmp_pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
 	if (tmp_pixbuf) {
@@ -611,8 +772,8 @@ comics_document_finalize (GObject *object)
 	if (comics_document->page_names)
                 g_ptr_array_free (comics_document->page_names, TRUE);
 
-	g_clear_pointer (&comics_document->page_positions, g_hash_table_destroy);
 	g_clear_object (&comics_document->archive);
+	g_free (comics_document->page_sizes);
 	g_free (comics_document->archive_path);
 	g_free (comics_document->archive_uri);
 
@@ -20,19 +20,50 @@
 #include "config.h"
 #include "ev-archive.h"
 
+#include <errno.h>
+#include <string.h>
+
 #include <archive.h>
 #include <archive_entry.h>
 #include <gio/gio.h>
 
 #define BUFFER_SIZE (64 * 1024)
 
+#define ZIP_EOCD_SIGNATURE 0x06054b50
+#define ZIP_EOCD_SIZE      22
+#define ZIP_CDH_SIGNATURE  0x02014b50
+#define ZIP_CDH_SIZE       46
+
+#define ZIP_FLAG_DATA_DESCRIPTOR (1 << 3)
+#define ZIP_METHOD_STORED        0
+
+/* Where an entry is in the archive. ZIP and tar entries can be read
+ * directly from the offset of their header, the other formats need to
+ * be read from the start of the archive. */
+typedef struct {
+	gint   index;  /* -1 if not seen yet */
+	gint64 offset; /* -1 if the entry can't be read directly */
+	gint64 size;   /* Uncompressed size from the central directory, -1 if unknown */
+} EvArchiveEntry;
+
 struct _EvArchive {
 	GObject parent_instance;
 	EvArchiveType type;
+	gchar *path;
 
 	/* libarchive */
 	struct archive *libar;
 	struct archive_entry *libar_entry;
+
+	/* key: pathname, value: EvArchiveEntry */
+	GHashTable *entries;
+	gboolean central_directory_read;
+	/* Index of the current entry, -1 when unknown */
+	gint entry_index;
+
+	/* Stream of an archive opened at an entry */
+	GInputStream *stream;
+	guchar *buffer;
 };
 
 G_DEFINE_TYPE(EvArchive, ev_archive, G_TYPE_OBJECT);
@@ -53,6 +84,11 @@ ev_archive_finalize (GObject *object)
 		break;
 	}
 
+	g_clear_object (&archive->stream);
+	g_free (archive->buffer);
+	g_hash_table_destroy (archive->entries);
+	g_free (archive->path);
+
 	G_OBJECT_CLASS (ev_archive_parent_class)->finalize (object);
 }
 
@@ -119,6 +155,118 @@ ev_archive_set_archive_type (EvArchive *archive,
 	return TRUE;
 }
 
+static EvArchiveEntry *
+ev_archive_lookup_entry (EvArchive  *archive,
+			 const char *pathname)
+{
+	EvArchiveEntry *entry;
+
+	entry = g_hash_table_lookup (archive->entries, pathname);
+	if (!entry) {
+		entry = g_new (EvArchiveEntry, 1);
+		entry->index = -1;
+		entry->offset = -1;
+		entry->size = -1;
+		g_hash_table_insert (archive->entries, g_strdup (pathname), entry);
+	}
+
+	return entry;
+}
+
+static inline guint16
+read_le16 (const guchar *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline guint32
+read_le32 (const guchar *p)
+{
+	return (guint32)read_le16 (p) | ((guint32)read_le16 (p + 2) << 16);
+}
+
+/* Gets the offsets of the local headers and the sizes of the entries from
+ * the central directory at the end of the archive. ZIP64 archives are not
+ * indexed.
+ *
+ * Entries written with a data descriptor have no sizes in their local
+ * header, so the streamable reader used to read them directly relies on
+ * the sizes found here. Stored ones can't be read by it at all, they are
+ * left to the seekable reader.
+ */
+static void
+zip_read_central_directory (EvArchive *archive)
+{
+	GMappedFile  *mapped_file;
+	const guchar *data, *p, *end;
+	gsize         size, i, min_eocd;
+	guint         n_entries;
+	guint32       cd_size, cd_offset;
+
+	mapped_file = g_mapped_file_new (archive->path, FALSE, NULL);
+	if (!mapped_file)
+		return;
+
+	data = (const guchar *) g_mapped_file_get_contents (mapped_file);
+	size = g_mapped_file_get_length (mapped_file);
+	if (size < ZIP_EOCD_SIZE)
+		goto out;
+
+	/* The end of central directory record can be followed by a comment */
+	min_eocd = size > ZIP_EOCD_SIZE + G_MAXUINT16 ? size - ZIP_EOCD_SIZE - G_MAXUINT16 : 0;
+	for (i = size - ZIP_EOCD_SIZE + 1; i > min_eocd; i--) {
+		if (read_le32 (data + i - 1) == ZIP_EOCD_SIGNATURE)
+			break;
+	}
+	if (i == min_eocd)
+		goto out;
+	p = data + i - 1;
+
+	n_entries = read_le16 (p + 10);
+	cd_size = read_le32 (p + 12);
+	cd_offset = read_le32 (p + 16);
+	if (n_entries == G_MAXUINT16 || cd_size == G_MAXUINT32 || cd_offset == G_MAXUINT32 ||
+	    (gsize)cd_offset + cd_size > (gsize)(p - data))
+		goto out;
+
+	p = data + cd_offset;
+	end = p + cd_size;
+	for (i = 0; i < n_entries; i++) {
+		EvArchiveEntry *entry;
+		gchar          *name;
+		gsize           name_len, header_len;
+		guint16         flags, method;
+		guint32         offset, uncompressed_size;
+
+		if (end - p < ZIP_CDH_SIZE || read_le32 (p) != ZIP_CDH_SIGNATURE)
+			break;
+
+		name_len = read_le16 (p + 28);
+		header_len = ZIP_CDH_SIZE + name_len + read_le16 (p + 30) + read_le16 (p + 32);
+		if ((gsize)(end - p) < header_len)
+			break;
+
+		flags = read_le16 (p + 8);
+		method = read_le16 (p + 10);
+		uncompressed_size = read_le32 (p + 24);
+		offset = read_le32 (p + 42);
+		if (offset != G_MAXUINT32 && uncompressed_size != G_MAXUINT32) {
+			name = g_strndup ((const char *) p + ZIP_CDH_SIZE, name_len);
+			entry = ev_archive_lookup_entry (archive, name);
+			entry->size = uncompressed_size;
+			if (!(flags & ZIP_FLAG_DATA_DESCRIPTOR) || method != ZIP_METHOD_STORED)
+				entry->offset = offset;
+			g_free (name);
+		}
+
+		p += header_len;
+	}
+
+	g_debug ("Indexed %u entries from the central directory", (guint) i);
+out:
+	g_mapped_file_unref (mapped_file);
+}
+
 gboolean
 ev_archive_open_filename (EvArchive   *archive,
 			  const char  *path,
@@ -130,6 +278,14 @@ ev_archive_open_filename (EvArchive   *archive,
 	g_return_val_if_fail (archive->type != EV_ARCHIVE_TYPE_NONE, FALSE);
 	g_return_val_if_fail (path != NULL, FALSE);
 
+	if (g_strcmp0 (archive->path, path) != 0) {
+		g_free (archive->path);
+		archive->path = g_strdup (path);
+		g_hash_table_remove_all (archive->entries);
+		archive->central_directory_read = FALSE;
+	}
+	archive->entry_index = -1;
+
 	switch (archive->type) {
 	case EV_ARCHIVE_TYPE_NONE:
 		g_assert_not_reached ();
@@ -137,6 +293,11 @@ ev_archive_open_filename (EvArchive   *archive,
 	case EV_ARCHIVE_TYPE_ZIP:
 	case EV_ARCHIVE_TYPE_7Z:
 	case EV_ARCHIVE_TYPE_TAR:
+		if (archive->type == EV_ARCHIVE_TYPE_ZIP && !archive->central_directory_read) {
+			zip_read_central_directory (archive);
+			archive->central_directory_read = TRUE;
+		}
+
 		r = archive_read_open_filename (archive->libar, path, BUFFER_SIZE);
 		if (r != ARCHIVE_OK) {
 			g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
@@ -172,6 +333,16 @@ libarchive_read_next_header (EvArchive *archive,
 
 		g_debug ("At header for file '%s'", archive_entry_pathname (archive->libar_entry));
 
+		/* Index the entries while the archive is read from the start */
+		if (!archive->stream) {
+			EvArchiveEntry *entry;
+
+			entry = ev_archive_lookup_entry (archive, archive_entry_pathname (archive->libar_entry));
+			entry->index = ++archive->entry_index;
+			if (archive->type == EV_ARCHIVE_TYPE_TAR)
+				entry->offset = archive_read_header_position (archive->libar);
+		}
+
 		break;
 	}
 
@@ -230,6 +401,8 @@ ev_archive_get_entry_pathname (EvArchive *archive)
 gint64
 ev_archive_get_entry_size (EvArchive *archive)
 {
+	EvArchiveEntry *entry;
+
 	g_return_val_if_fail (EV_IS_ARCHIVE (archive), -1);
 	g_return_val_if_fail (archive->type != EV_ARCHIVE_TYPE_NONE, -1);
 
@@ -241,7 +414,13 @@ ev_archive_get_entry_size (EvArchive *archive)
 	case EV_ARCHIVE_TYPE_7Z:
 	case EV_ARCHIVE_TYPE_TAR:
 		g_return_val_if_fail (archive->libar_entry != NULL, -1);
-		return archive_entry_size (archive->libar_entry);
+		if (archive_entry_size_is_set (archive->libar_entry))
+			return archive_entry_size (archive->libar_entry);
+
+		/* Not in the local header of ZIP entries with a data descriptor */
+		entry = g_hash_table_lookup (archive->entries,
+					     archive_entry_pathname (archive->libar_entry));
+		return entry ? entry->size : -1;
 	}
 
 	return -1;
@@ -309,15 +488,163 @@ ev_archive_reset (EvArchive *archive)
 	case EV_ARCHIVE_TYPE_7Z:
 	case EV_ARCHIVE_TYPE_TAR:
 		g_clear_pointer (&archive->libar, archive_free);
+		g_clear_object (&archive->stream);
 		libarchive_set_archive_type (archive, archive->type);
 		archive->libar_entry = NULL;
+		archive->entry_index = -1;
 		break;
 	default:
 		g_assert_not_reached ();
 	}
 }
 
+static la_ssize_t
+libarchive_stream_read (struct archive *libar,
+			void           *client_data,
+			const void    **buffer)
+{
+	EvArchive *archive = client_data;
+	GError    *error = NULL;
+	gssize     r;
+
+	r = g_input_stream_read (archive->stream, archive->buffer, BUFFER_SIZE, NULL, &error);
+	if (r < 0) {
+		archive_set_error (libar, EIO, "%s", error->message);
+		g_error_free (error);
+		return -1;
+	}
+	*buffer = archive->buffer;
+
+	return r;
+}
+
+static la_int64_t
+libarchive_stream_skip (struct archive *libar,
+			void           *client_data,
+			la_int64_t      request)
+{
+	EvArchive *archive = client_data;
+
+	if (!g_seekable_seek (G_SEEKABLE (archive->stream), request, G_SEEK_CUR, NULL, NULL))
+		return 0;
+
+	return request;
+}
+
+/* Opens the archive at the header at @offset, only the entries from
+ * there on can be read */
+static gboolean
+libarchive_open_at (EvArchive *archive,
+		    gint64     offset,
+		    GError   **error)
+{
+	GFile            *file;
+	GFileInputStream *stream;
+	int               r;
+
+	file = g_file_new_for_path (archive->path);
+	stream = g_file_read (file, NULL, error);
+	g_object_unref (file);
+	if (!stream)
+		return FALSE;
+
+	if (!g_seekable_seek (G_SEEKABLE (stream), offset, G_SEEK_SET, NULL, error)) {
+		g_object_unref (stream);
+		return FALSE;
+	}
+
+	g_clear_pointer (&archive->libar, archive_free);
+	g_clear_object (&archive->stream);
+	archive->stream = G_INPUT_STREAM (stream);
+	if (!archive->buffer)
+		archive->buffer = g_malloc (BUFFER_SIZE);
+	archive->libar_entry = NULL;
+	archive->entry_index = -1;
+
+	/* The seekable ZIP reader would start again from the central
+	 * directory, the streamable one reads from the local header */
+	archive->libar = archive_read_new ();
+	if (archive->type == EV_ARCHIVE_TYPE_ZIP)
+		archive_read_support_format_zip_streamable (archive->libar);
+	else
+		archive_read_support_format_tar (archive->libar);
+
+	r = archive_read_open2 (archive->libar, archive, NULL,
+				libarchive_stream_read,
+				libarchive_stream_skip,
+				NULL);
+	if (r != ARCHIVE_OK) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			     "Error opening archive: %s", archive_error_string (archive->libar));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * ev_archive_seek_entry:
+ * @archive: an #EvArchive
+ * @pathname: the pathname of an entry
+ * @error: a #GError
+ *
+ * Moves @archive to the header of the entry @pathname, which can then be
+ * read with ev_archive_read_data(). ZIP and tar entries seen before are
+ * read directly, otherwise the archive is read from the current entry,
+ * or from the start if @pathname is before it.
+ *
+ * Returns: %TRUE if @archive is at the header of @pathname
+ */
+gboolean
+ev_archive_seek_entry (EvArchive   *archive,
+		       const char  *pathname,
+		       GError     **error)
+{
+	EvArchiveEntry *entry;
+	GError         *local_error = NULL;
+
+	g_return_val_if_fail (EV_IS_ARCHIVE (archive), FALSE);
+	g_return_val_if_fail (archive->type != EV_ARCHIVE_TYPE_NONE, FALSE);
+	g_return_val_if_fail (archive->path != NULL, FALSE);
+	g_return_val_if_fail (pathname != NULL, FALSE);
+
+	entry = g_hash_table_lookup (archive->entries, pathname);
+
+	if (entry && entry->offset >= 0) {
+		if (libarchive_open_at (archive, entry->offset, &local_error) &&
+		    libarchive_read_next_header (archive, &local_error) &&
+		    g_strcmp0 (archive_entry_pathname (archive->libar_entry), pathname) == 0)
+			return TRUE;
+
+		/* Read it from the start from now on */
+		g_debug ("Failed to read '%s' at offset %" G_GINT64_FORMAT ": %s", pathname,
+			 entry->offset, local_error ? local_error->message : "unexpected entry");
+		g_clear_error (&local_error);
+		entry->offset = -1;
+	}
+
+	if (!archive->libar_entry || archive->entry_index < 0 ||
+	    !entry || entry->index < 0 || entry->index <= archive->entry_index) {
+		ev_archive_reset (archive);
+		if (!ev_archive_open_filename (archive, archive->path, error))
+			return FALSE;
+	}
+
+	while (libarchive_read_next_header (archive, error)) {
+		if (g_strcmp0 (archive_entry_pathname (archive->libar_entry), pathname) == 0)
+			return TRUE;
+	}
+
+	if (error && !*error)
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+			     "File '%s' not found in archive", pathname);
+
+	return FALSE;
+}
+
 static void
 ev_archive_init (EvArchive *archive)
 {
+	archive->entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	archive->entry_index = -1;
 }
@@ -40,6 +40,10 @@ struct _DjvuDocument {
 	ddjvu_fileinfo_t *fileinfo_pages;
 	gint		  n_pages;
 	GHashTable	 *file_ids;
+
+	/* Decoded pages, indexed by page number */
+	ddjvu_page_t    **pages;
+	GQueue            pages_lru;
 };
 
 int  djvu_document_get_n_pages (EvDocument   *document);
@@ -37,6 +37,9 @@
 #include <glib/gi18n-lib.h>
 #include <string.h>
 
+/* Number of decoded pages kept */
+#define PAGE_CACHE_SIZE 8
+
 enum {
 	PROP_0,
 	PROP_TITLE
@@ -150,6 +153,53 @@ djvu_wait_for_message (DjvuDocument *djvu_document, ddjvu_message_tag_t message,
 		ddjvu_message_pop (ctx);
 }
 
+static void
+djvu_document_clear_pages (DjvuDocument *djvu_document)
+{
+	gint i;
+
+	if (!djvu_document->pages)
+		return;
+
+	for (i = 0; i < djvu_document->n_pages; i++) {
+		if (djvu_document->pages[i])
+			ddjvu_page_release (djvu_document->pages[i]);
+	}
+	g_clear_pointer (&djvu_document->pages, g_free);
+	g_queue_clear (&djvu_document->pages_lru);
+}
+
+/* Returns the page without waiting for it to be decoded, the decoding
+ * runs in the ddjvu threads and finishes while messages are handled.
+ * Only the most recently used pages are kept, so that rendering a page
+ * again at another scale or rotation doesn't decode it again.
+ */
+static ddjvu_page_t *
+djvu_document_get_page (DjvuDocument *djvu_document,
+			gint          index)
+{
+	ddjvu_page_t *d_page = djvu_document->pages[index];
+
+	if (d_page) {
+		g_queue_remove (&djvu_document->pages_lru, GINT_TO_POINTER (index));
+	} else {
+		d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, index);
+		if (!d_page)
+			return NULL;
+		djvu_document->pages[index] = d_page;
+	}
+	g_queue_push_head (&djvu_document->pages_lru, GINT_TO_POINTER (index));
+
+	while (g_queue_get_length (&djvu_document->pages_lru) > PAGE_CACHE_SIZE) {
+		gint old = GPOINTER_TO_INT (g_queue_pop_tail (&djvu_document->pages_lru));
+
+		ddjvu_page_release (djvu_document->pages[old]);
+		djvu_document->pages[old] = NULL;
+	}
+
+	return d_page;
+}
+
 static gboolean
 djvu_document_load (EvDocument  *document,
 		    const char  *uri,
@@ -185,6 +235,7 @@ djvu_document_load (EvDocument  *document,
 		return FALSE;
 	}
 
+	djvu_document_clear_pages (djvu_document);
 	if (djvu_document->d_document)
 	    ddjvu_document_release (djvu_document->d_document);
 
@@ -224,6 +275,7 @@ djvu_document_load (EvDocument  *document,
 	djvu_document->uri = g_strdup (uri);
 
 	djvu_document->n_pages = ddjvu_document_get_pagenum (djvu_document->d_document);
+	djvu_document->pages = g_new0 (ddjvu_page_t *, MAX (djvu_document->n_pages, 1));
 
 	if (djvu_document->n_pages > 0) {
 		djvu_document->fileinfo_pages = g_new0 (ddjvu_fileinfo_t, djvu_document->n_pages);
@@ -352,7 +404,13 @@ djvu_document_render (EvDocument      *document,
 	double page_width, page_height;
 	gint transformed_width, transformed_height;
 
-	d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, rc->page->index);
+	d_page = djvu_document_get_page (djvu_document, rc->page->index);
+	if (!d_page)
+		return NULL;
+
+	/* Start decoding the next page, it's likely to be rendered next */
+	if (rc->page->index + 1 < djvu_document->n_pages)
+		djvu_document_get_page (djvu_document, rc->page->index + 1);
 
 	while (!ddjvu_page_decoding_done (d_page))
 		djvu_handle_events(djvu_document, TRUE, NULL);
@@ -557,6 +615,7 @@ djvu_document_finalize (GObject *object)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (object);
 
+	djvu_document_clear_pages (djvu_document);
 	if (djvu_document->d_document)
 	    ddjvu_document_release (djvu_document->d_document);
 
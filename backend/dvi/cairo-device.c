@@ -40,6 +40,10 @@ typedef struct {
 
 } DviCairoDevice;
 
+#ifdef HAVE_SPECTRE
+static GMutex spectre_mutex;
+#endif
+
 static void
 dvi_cairo_draw_glyph (DviContext  *dvi,
 		      DviFontChar *ch,
@@ -145,10 +149,13 @@ dvi_cairo_draw_ps (DviContext *dvi,
 
 	cairo_device = (DviCairoDevice *) dvi->device.device_data;
 
+	/* Ghostscript can't run in several threads at once */
+	g_mutex_lock (&spectre_mutex);
 	psdoc = spectre_document_new ();
 	spectre_document_load (psdoc, filename);
 	if (spectre_document_status (psdoc)) {
 		spectre_document_free (psdoc);
+		g_mutex_unlock (&spectre_mutex);
 		return;
 	}
 
@@ -163,6 +170,7 @@ dvi_cairo_draw_ps (DviContext *dvi,
 
 	spectre_render_context_free (rc);
 	spectre_document_free (psdoc);
+	g_mutex_unlock (&spectre_mutex);
 
 	if (status) {
 		g_warning ("Error rendering PS document %s: %s\n",
@@ -243,6 +251,12 @@ dvi_cairo_free_image (void *ptr)
 	cairo_surface_destroy ((cairo_surface_t *)ptr);
 }
 
+static void *
+dvi_cairo_ref_image (void *ptr)
+{
+	return cairo_surface_reference ((cairo_surface_t *)ptr);
+}
+
 static void
 dvi_cairo_put_pixel (void *image, int x, int y, Ulong color)
 {
@@ -286,6 +300,7 @@ mdvi_cairo_device_init (DviDevice *device)
 	device->alloc_colors = dvi_cairo_alloc_colors;
 	device->create_image = dvi_cairo_create_image;
 	device->free_image = dvi_cairo_free_image;
+	device->ref_image = dvi_cairo_ref_image;
 	device->put_pixel = dvi_cairo_put_pixel;
         device->image_done = dvi_cairo_image_done;
 	device->set_color = dvi_cairo_set_color;
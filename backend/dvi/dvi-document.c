@@ -40,7 +40,8 @@
 #endif
 #include <stdlib.h>
 
-static GMutex dvi_context_mutex;
+/* Fonts are shared by all the contexts, see mdvi_set_font_lock() */
+static GRecMutex dvi_fonts_mutex;
 
 enum {
 	PROP_0,
@@ -66,6 +67,11 @@ struct _DviDocument
 
 	gchar *uri;
 
+	/* Offset of the postamble, the end of the last page */
+	long postamble;
+	/* Checksum of what every page depends on, like the fonts */
+	gchar *fonts_checksum;
+
 	/* PDF exporter */
 	gchar		 *exporter_filename;
 	GString 	 *exporter_opts;
@@ -82,6 +88,65 @@ G_DEFINE_TYPE_WITH_CODE (DviDocument, dvi_document, EV_TYPE_DOCUMENT,
 			 G_IMPLEMENT_INTERFACE (EV_TYPE_FILE_EXPORTER,
 						dvi_document_file_exporter_iface_init))
 
+/* The file ends with the offset of the postamble, the DVI id byte and
+ * at least four DVI_TRAILER bytes.
+ */
+static long
+dvi_document_find_postamble (FILE *in)
+{
+	long offset = 0;
+	int  c, i;
+
+	if (!in || fseek (in, -1, SEEK_END) == -1)
+		return -1;
+	while ((c = fgetc (in)) == DVI_TRAILER) {
+		if (fseek (in, -2, SEEK_CUR) == -1)
+			return -1;
+	}
+	if (c == EOF || fseek (in, -5, SEEK_CUR) == -1)
+		return -1;
+
+	for (i = 0; i < 4; i++) {
+		if ((c = fgetc (in)) == EOF)
+			return -1;
+		offset = (offset << 8) | c;
+	}
+
+	return offset;
+}
+
+static gchar *
+dvi_document_compute_fonts_checksum (DviContext *context)
+{
+	GChecksum  *checksum;
+	DviFontRef *ref;
+	gchar      *retval;
+	Int32       values[5];
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+	values[0] = context->num;
+	values[1] = context->den;
+	values[2] = context->dvimag;
+	values[3] = context->dvi_page_w;
+	values[4] = context->dvi_page_h;
+	g_checksum_update (checksum, (const guchar *)values, sizeof (values));
+
+	for (ref = context->fonts; ref; ref = ref->next) {
+		values[0] = ref->fontid;
+		values[1] = ref->ref->checksum;
+		values[2] = ref->ref->scale;
+		values[3] = ref->ref->design;
+		g_checksum_update (checksum, (const guchar *)values, 4 * sizeof (Int32));
+		g_checksum_update (checksum, (const guchar *)ref->ref->fontname, -1);
+	}
+
+	retval = g_strdup (g_checksum_get_string (checksum));
+	g_checksum_free (checksum);
+
+	return retval;
+}
+
 static gboolean
 dvi_document_load (EvDocument  *document,
 		   const char  *uri,
@@ -94,12 +159,14 @@ dvi_document_load (EvDocument  *document,
 	if (!filename)
         	return FALSE;
 
-	g_mutex_lock (&dvi_context_mutex);
-	if (dvi_document->context)
+	g_rec_mutex_lock (&dvi_fonts_mutex);
+	if (dvi_document->context) {
+		mdvi_cairo_device_free (&dvi_document->context->device);
 		mdvi_destroy_context (dvi_document->context);
+	}
 
 	dvi_document->context = mdvi_init_context(dvi_document->params, dvi_document->spec, filename);
-	g_mutex_unlock (&dvi_context_mutex);
+	g_rec_mutex_unlock (&dvi_fonts_mutex);
 	g_free (filename);
 
 	if (!dvi_document->context) {
@@ -110,15 +177,19 @@ dvi_document_load (EvDocument  *document,
         	return FALSE;
 	}
 
+	/* Only used to free the glyphs when the context is destroyed */
 	mdvi_cairo_device_init (&dvi_document->context->device);
 
-
 	dvi_document->base_width = dvi_document->context->dvi_page_w * dvi_document->context->params.conv
 		+ 2 * unit2pix(dvi_document->params->dpi, MDVI_HMARGIN) / dvi_document->params->hshrink;
 
 	dvi_document->base_height = dvi_document->context->dvi_page_h * dvi_document->context->params.vconv
 	        + 2 * unit2pix(dvi_document->params->vdpi, MDVI_VMARGIN) / dvi_document->params->vshrink;
 
+	dvi_document->postamble = dvi_document_find_postamble (dvi_document->context->in);
+	g_free (dvi_document->fonts_checksum);
+	dvi_document->fonts_checksum = dvi_document_compute_fonts_checksum (dvi_document->context);
+
 	g_free (dvi_document->uri);
 	dvi_document->uri = g_strdup (uri);
 
@@ -156,6 +227,47 @@ dvi_document_get_page_size (EvDocument *document,
         *height = dvi_document->base_height;;
 }
 
+/* Pages are stored one after the other. The fingerprint covers the
+ * bytes of the page but the pointer to the previous page, which
+ * changes when any of the previous pages change.
+ */
+static gchar *
+dvi_document_get_page_fingerprint (EvDocument *document,
+				   EvPage     *page)
+{
+	DviDocument *dvi_document = DVI_DOCUMENT (document);
+	DviContext  *context = dvi_document->context;
+	GChecksum   *checksum;
+	guchar      *data;
+	gchar       *retval = NULL;
+	long         start, end;
+	gsize        length;
+
+	start = context->pagemap[page->index][0];
+	if (page->index + 1 < context->npages)
+		end = context->pagemap[page->index + 1][0];
+	else
+		end = dvi_document->postamble;
+
+	/* BOP, ten counters and the pointer to the previous page */
+	if (!context->in || end - start < 45 || fseek (context->in, start, SEEK_SET) == -1)
+		return NULL;
+
+	length = end - start;
+	data = g_malloc (length);
+	if (fread (data, 1, length, context->in) == length) {
+		checksum = g_checksum_new (G_CHECKSUM_SHA1);
+		g_checksum_update (checksum, (const guchar *)dvi_document->fonts_checksum, -1);
+		g_checksum_update (checksum, data, 41);
+		g_checksum_update (checksum, data + 45, length - 45);
+		retval = g_strdup (g_checksum_get_string (checksum));
+		g_checksum_free (checksum);
+	}
+	g_free (data);
+
+	return retval;
+}
+
 static cairo_surface_t *
 dvi_document_render (EvDocument      *document,
 		     EvRenderContext *rc)
@@ -163,41 +275,46 @@ dvi_document_render (EvDocument      *document,
 	cairo_surface_t *surface;
 	cairo_surface_t *rotated_surface;
 	DviDocument *dvi_document = DVI_DOCUMENT(document);
+	DviContext *context;
 	gdouble xscale, yscale;
 	gint required_width, required_height;
 	gint proposed_width, proposed_height;
 	gint xmargin = 0, ymargin = 0;
 
-	/* We should protect our context since it's not
-	 * thread safe. The work to the future -
-	 * let context render page independently
+	/* The context of the document is never used to render, every
+	 * render has its own clone so that pages can be rendered in
+	 * parallel.
 	 */
-	g_mutex_lock (&dvi_context_mutex);
+	context = mdvi_clone_context (dvi_document->context);
+	if (!context)
+		return NULL;
 
-	mdvi_setpage (dvi_document->context, rc->page->index);
+	mdvi_cairo_device_init (&context->device);
+	mdvi_setpage (context, rc->page->index);
 
 	ev_render_context_compute_scales (rc, dvi_document->base_width, dvi_document->base_height,
 					  &xscale, &yscale);
-	mdvi_set_shrink (dvi_document->context,
+	mdvi_set_shrink (context,
 			 (int)((dvi_document->params->hshrink - 1) / xscale) + 1,
 			 (int)((dvi_document->params->vshrink - 1) / yscale) + 1);
 
 	ev_render_context_compute_scaled_size (rc, dvi_document->base_width, dvi_document->base_height,
 					       &required_width, &required_height);
-	proposed_width = dvi_document->context->dvi_page_w * dvi_document->context->params.conv;
-	proposed_height = dvi_document->context->dvi_page_h * dvi_document->context->params.vconv;
+	proposed_width = context->dvi_page_w * context->params.conv;
+	proposed_height = context->dvi_page_h * context->params.vconv;
 
 	if (required_width >= proposed_width)
 	    xmargin = (required_width - proposed_width) / 2;
 	if (required_height >= proposed_height)
 	    ymargin = (required_height - proposed_height) / 2;
 
-	mdvi_cairo_device_set_margins (&dvi_document->context->device, xmargin, ymargin);
-	mdvi_cairo_device_set_scale (&dvi_document->context->device, xscale, yscale);
-	mdvi_cairo_device_render (dvi_document->context);
-	surface = mdvi_cairo_device_get_surface (&dvi_document->context->device);
+	mdvi_cairo_device_set_margins (&context->device, xmargin, ymargin);
+	mdvi_cairo_device_set_scale (&context->device, xscale, yscale);
+	mdvi_cairo_device_render (context);
+	surface = mdvi_cairo_device_get_surface (&context->device);
 
-	g_mutex_unlock (&dvi_context_mutex);
+	mdvi_cairo_device_free (&context->device);
+	mdvi_destroy_context (context);
 
 	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
 								     required_width,
@@ -213,12 +330,12 @@ dvi_document_finalize (GObject *object)
 {
 	DviDocument *dvi_document = DVI_DOCUMENT(object);
 
-	g_mutex_lock (&dvi_context_mutex);
+	g_rec_mutex_lock (&dvi_fonts_mutex);
 	if (dvi_document->context) {
 		mdvi_cairo_device_free (&dvi_document->context->device);
 		mdvi_destroy_context (dvi_document->context);
 	}
-	g_mutex_unlock (&dvi_context_mutex);
+	g_rec_mutex_unlock (&dvi_fonts_mutex);
 
 	if (dvi_document->params)
 		g_free (dvi_document->params);
@@ -230,6 +347,7 @@ dvi_document_finalize (GObject *object)
 		g_string_free (dvi_document->exporter_opts, TRUE);
 
         g_free (dvi_document->uri);
+	g_free (dvi_document->fonts_checksum);
 
 	G_OBJECT_CLASS (dvi_document_parent_class)->finalize (object);
 }
@@ -240,6 +358,18 @@ dvi_document_support_synctex (EvDocument *document)
 	return TRUE;
 }
 
+static void
+dvi_document_lock_fonts (void)
+{
+	g_rec_mutex_lock (&dvi_fonts_mutex);
+}
+
+static void
+dvi_document_unlock_fonts (void)
+{
+	g_rec_mutex_unlock (&dvi_fonts_mutex);
+}
+
 static void
 dvi_document_class_init (DviDocumentClass *klass)
 {
@@ -255,13 +385,16 @@ dvi_document_class_init (DviDocumentClass *klass)
 
 	mdvi_register_special ("Color", "color", NULL, dvi_document_do_color_special, 1);
 	mdvi_register_fonts ();
+	mdvi_set_font_lock (dvi_document_lock_fonts, dvi_document_unlock_fonts);
 
 	ev_document_class->load = dvi_document_load;
 	ev_document_class->save = dvi_document_save;
 	ev_document_class->get_n_pages = dvi_document_get_n_pages;
 	ev_document_class->get_page_size = dvi_document_get_page_size;
 	ev_document_class->render = dvi_document_render;
+	ev_document_class->get_page_fingerprint = dvi_document_get_page_fingerprint;
 	ev_document_class->support_synctex = dvi_document_support_synctex;
+	ev_document_class->concurrent_reads = TRUE;
 }
 
 /* EvFileExporterIface */
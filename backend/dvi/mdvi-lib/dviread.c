@@ -168,6 +168,21 @@ static void dummy_dev_set_color(void *a, Ulong b, Ulong c)
 {
 }
 
+static void dummy_device_init(DviDevice *device)
+{
+	memzero(device, sizeof(DviDevice));
+	device->draw_glyph   = dummy_draw_glyph;
+	device->draw_rule    = dummy_draw_rule;
+	device->alloc_colors = dummy_alloc_colors;
+	device->create_image = dummy_create_image;
+	device->free_image   = dummy_free_image;
+	device->dev_destroy  = dummy_dev_destroy;
+	device->put_pixel    = dummy_dev_putpixel;
+	device->refresh      = dummy_dev_refresh;
+	device->set_color    = dummy_dev_set_color;
+	device->device_data  = NULL;
+}
+
 /* functions to report errors */
 __attribute__((__format__ (__printf__, 2, 3)))
 static void dvierr(DviContext *dvi, const char *format, ...)
@@ -567,15 +582,12 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 			break;
 		case MDVI_SET_SHRINK:
 			np.hshrink = np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_XSHRINK:
 			np.hshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_YSHRINK:
 			np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_ORIENTATION:
 			np.orientation = va_arg(ap, DviOrientation);
@@ -634,8 +646,12 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 	 * the DVI file again from scratch.
 	 */
 
-	if(reset_all)
+	if(reset_all) {
+		/* the file data of a clone belongs to its parent */
+		if(dvi->parent)
+			return -1;
 		return (mdvi_reload(dvi, &np) == 0);
+	}
 
 	if(np.hshrink != dvi->params.hshrink) {
 		np.conv = dvi->dviconv;
@@ -649,7 +665,9 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 	}
 
 	if(reset_font) {
+		mdvi_lock_fonts();
 		font_reset_chain_glyphs(&dvi->device, dvi->fonts, reset_font);
+		mdvi_unlock_fonts();
 	}
 	dvi->params = np;
 	if((reset_font & MDVI_FONTSEL_GLYPH) && dvi->device.refresh) {
@@ -887,16 +905,7 @@ DviContext *mdvi_init_context(DviParams *par, DviPageSpec *spec, const char *fil
 	dvi->curr_layer = 0;
 	dvi->stack = xnalloc(DviState, dvi->stacksize + 8);
 
-	dvi->device.draw_glyph   = dummy_draw_glyph;
-	dvi->device.draw_rule    = dummy_draw_rule;
-	dvi->device.alloc_colors = dummy_alloc_colors;
-	dvi->device.create_image = dummy_create_image;
-	dvi->device.free_image   = dummy_free_image;
-	dvi->device.dev_destroy  = dummy_dev_destroy;
-	dvi->device.put_pixel    = dummy_dev_putpixel;
-	dvi->device.refresh      = dummy_dev_refresh;
-	dvi->device.set_color    = dummy_dev_set_color;
-	dvi->device.device_data  = NULL;
+	dummy_device_init(&dvi->device);
 
 	DEBUG((DBG_DVI, "%s read successfully\n", filename));
 	return dvi;
@@ -910,25 +919,71 @@ error:
 	return NULL;
 }
 
+/*
+ * Create a context to render pages of the same file in another thread.
+ * The clone shares the page map and the fonts of `dvi', which must not be
+ * reloaded or destroyed while the clone exists, and has its own file
+ * handle, registers, stack, colors and a dummy device. Fonts are only
+ * used with the lock given to mdvi_set_font_lock() held.
+ */
+DviContext *mdvi_clone_context(DviContext *dvi)
+{
+	DviContext *clone;
+	FILE	*p;
+
+	p = fopen(dvi->filename, "rb");
+	if(p == NULL) {
+		mdvi_warning(_("%s: could not reopen file (%s)\n"),
+			     dvi->filename,
+			     strerror(errno));
+		return NULL;
+	}
+
+	clone = xalloc(DviContext);
+	memcpy(clone, dvi, sizeof(DviContext));
+	clone->parent = dvi->parent ? dvi->parent : dvi;
+	clone->in = p;
+	clone->depth = 0;
+	clone->currfont = NULL;
+	clone->fonts = clone->parent->fonts;
+	clone->findref = clone->parent->findref;
+	clone->curr_layer = 0;
+	memzero(&clone->pos, sizeof(DviState));
+	memzero(&clone->buffer, sizeof(DviBuffer));
+	clone->stacktop = 0;
+	clone->stack = xnalloc(DviState, clone->stacksize + 8);
+	clone->curr_fg = dvi->params.fg;
+	clone->curr_bg = dvi->params.bg;
+	clone->color_stack = NULL;
+	clone->color_top = 0;
+	clone->color_size = 0;
+	dummy_device_init(&clone->device);
+
+	return clone;
+}
+
 void	mdvi_destroy_context(DviContext *dvi)
 {
 	if(dvi->device.dev_destroy)
 		dvi->device.dev_destroy(dvi->device.device_data);
-	/* release all fonts */
-	if(dvi->fonts) {
-		font_drop_chain(dvi->fonts);
-		font_free_unused(&dvi->device);
+	/* the file data of a clone belongs to its parent */
+	if(dvi->parent == NULL) {
+		/* release all fonts */
+		if(dvi->fonts) {
+			font_drop_chain(dvi->fonts);
+			font_free_unused(&dvi->device);
+		}
+		if(dvi->fontmap)
+			mdvi_free(dvi->fontmap);
+		if(dvi->filename)
+			mdvi_free(dvi->filename);
+		if(dvi->pagemap)
+			mdvi_free(dvi->pagemap);
+		if(dvi->fileid)
+			mdvi_free(dvi->fileid);
 	}
-	if(dvi->fontmap)
-		mdvi_free(dvi->fontmap);
-	if(dvi->filename)
-		mdvi_free(dvi->filename);
 	if(dvi->stack)
 		mdvi_free(dvi->stack);
-	if(dvi->pagemap)
-		mdvi_free(dvi->pagemap);
-	if(dvi->fileid)
-		mdvi_free(dvi->fileid);
 	if(dvi->in)
 		fclose(dvi->in);
 	if(dvi->buffer.data && !dvi->buffer.frozen)
@@ -1019,8 +1074,9 @@ again:
 		DEBUG((DBG_FILES, "reopen(%s) -> Ok\n", dvi->filename));
 	}
 
-	/* check if we need to reload the file */
-	if(!reloaded && get_mtime(fileno(dvi->in)) > dvi->modtime) {
+	/* check if we need to reload the file, clones can't do it */
+	if(!reloaded && dvi->parent == NULL &&
+	   get_mtime(fileno(dvi->in)) > dvi->modtime) {
 		mdvi_reload(dvi, &dvi->params);
 		/* we have to reopen the file, again */
 		reloaded = 1;
@@ -1247,7 +1303,9 @@ int	set_char(DviContext *dvi, int opcode)
 	int	num;
 	int	h;
 	int	hh;
+	int	locked;
 	DviFontChar *ch;
+	DviFontChar glyph;
 	DviFont	*font;
 
 	if(opcode < 128)
@@ -1259,35 +1317,65 @@ int	set_char(DviContext *dvi, int opcode)
 		return -1;
 	}
 	font = dvi->currfont->ref;
+	/*
+	 * The glyph may be replaced by another context as soon as the font
+	 * lock is released, so we work on a copy of it and keep its image
+	 * alive with a reference while drawing.
+	 */
+	mdvi_lock_fonts();
+	locked = 1;
 	ch = font_get_glyph(dvi, font, num);
 	if(ch == NULL || ch->missing) {
 		/* try to display something anyway */
 		ch = FONTCHAR(font, num);
 		if(!glyph_present(ch)) {
+			mdvi_unlock_fonts();
 			dviwarn(dvi,
 			_("requested character %d does not exist in `%s'\n"),
 				num, font->fontname);
 			return 0;
 		}
-		draw_box(dvi, ch);
-	} else if(dvi->curr_layer <= dvi->params.layer) {
-		if(ISVIRTUAL(font))
-			mdvi_run_macro(dvi, (Uchar *)font->private +
-				ch->offset, ch->width);
-		else if(ch->width && ch->height)
-			dvi->device.draw_glyph(dvi, ch,
-				dvi->pos.hh, dvi->pos.vv);
+		glyph = *ch;
+		mdvi_unlock_fonts();
+		locked = 0;
+		draw_box(dvi, &glyph);
+	} else {
+		glyph = *ch;
+		if(ISVIRTUAL(font)) {
+			/* the macro lives in the font, not in the glyph */
+			mdvi_unlock_fonts();
+			locked = 0;
+		} else if(dvi->device.ref_image) {
+			if(MDVI_GLYPH_NONEMPTY(glyph.grey.data))
+				glyph.grey.data =
+					dvi->device.ref_image(glyph.grey.data);
+			mdvi_unlock_fonts();
+			locked = 0;
+		}
+		if(dvi->curr_layer <= dvi->params.layer) {
+			if(ISVIRTUAL(font))
+				mdvi_run_macro(dvi, (Uchar *)font->private +
+					glyph.offset, glyph.width);
+			else if(glyph.width && glyph.height)
+				dvi->device.draw_glyph(dvi, &glyph,
+					dvi->pos.hh, dvi->pos.vv);
+		}
+		if(!locked && !ISVIRTUAL(font) &&
+		   MDVI_GLYPH_NONEMPTY(glyph.grey.data))
+			dvi->device.free_image(glyph.grey.data);
 	}
+	if(locked)
+		mdvi_unlock_fonts();
 	if(opcode >= DVI_PUT1 && opcode <= DVI_PUT4) {
 		SHOWCMD((dvi, "putchar", opcode - DVI_PUT1 + 1,
 			"char %d (%s)\n",
 			num, dvi->currfont->ref->fontname));
 	} else {
-		h = dvi->pos.h + ch->tfmwidth;
-		hh = dvi->pos.hh + pixel_round(dvi, ch->tfmwidth);
+		h = dvi->pos.h + glyph.tfmwidth;
+		hh = dvi->pos.hh + pixel_round(dvi, glyph.tfmwidth);
 		SHOWCMD((dvi, "setchar", num, "(%d,%d) h:=%d%c%ld=%d, hh:=%d (%s)\n",
 			dvi->pos.hh, dvi->pos.vv,
-			DBGSUM(dvi->pos.h, (long) ch->tfmwidth, h), hh,
+			DBGSUM(dvi->pos.h, (long) glyph.tfmwidth, h), hh,
 			font->fontname));
 		dvi->pos.h  = h;
 		dvi->pos.hh = hh;
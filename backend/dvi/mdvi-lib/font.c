@@ -24,6 +24,9 @@
 
 static ListHead fontlist;
 
+static DviLockFunc font_lock = NULL;
+static DviLockFunc font_unlock = NULL;
+
 extern char *_mdvi_fallback_font;
 
 extern void vf_free_macros(DviFont *);
@@ -32,6 +35,217 @@ extern void vf_free_macros(DviFont *);
 #define TYPENAME(font)	\
 	((font)->finfo ? (font)->finfo->name : "none")
 
+/*
+ * Font characters only hold the shrunk and grey glyphs of one pair of
+ * shrink factors. The glyphs of other shrink factors are moved to this
+ * cache, so that going back to a previous zoom level, or rendering a
+ * thumbnail in between, doesn't sample every glyph again.
+ */
+#define GLYPH_CACHE_BUCKETS	4093
+#define GLYPH_CACHE_MAX_SIZE	(16 * 1024 * 1024)
+
+typedef struct {
+	DviFont	*font;
+	int	code;
+	int	hshrink;
+	int	vshrink;
+} GlyphCacheKey;
+
+typedef struct _GlyphCacheEntry GlyphCacheEntry;
+
+struct _GlyphCacheEntry {
+	GlyphCacheEntry *next;
+	GlyphCacheEntry *prev;
+	GlyphCacheKey key;
+	DviGlyph shrunk;
+	DviGlyph grey;
+	Ulong	fg;
+	Ulong	bg;
+	DviFreeImage free_image;
+	size_t	size;
+};
+
+static DviHashTable glyph_cache = MDVI_EMPTY_HASH_TABLE;
+static ListHead glyph_cache_lru = MDVI_EMPTY_LIST_HEAD; /* oldest first */
+static size_t glyph_cache_size;
+
+static Ulong glyph_cache_hash(DviHashKey key)
+{
+	GlyphCacheKey *k = (GlyphCacheKey *)key;
+	Ulong	h;
+
+	h = (Ulong)((size_t)k->font >> 4);
+	h = h * 31 + (Ulong)k->code;
+	h = h * 31 + (Ulong)k->hshrink;
+	h = h * 31 + (Ulong)k->vshrink;
+
+	return h;
+}
+
+static int glyph_cache_compare(DviHashKey key1, DviHashKey key2)
+{
+	GlyphCacheKey *k1 = (GlyphCacheKey *)key1;
+	GlyphCacheKey *k2 = (GlyphCacheKey *)key2;
+
+	return !(k1->font == k2->font && k1->code == k2->code &&
+		 k1->hshrink == k2->hshrink && k1->vshrink == k2->vshrink);
+}
+
+static size_t glyph_cache_entry_size(GlyphCacheEntry *entry)
+{
+	size_t	size = sizeof(GlyphCacheEntry);
+
+	if(MDVI_GLYPH_NONEMPTY(entry->shrunk.data)) {
+		BITMAP	*bm = (BITMAP *)entry->shrunk.data;
+
+		size += (size_t)bm->stride * bm->height;
+	}
+	/* devices create 32 bits images */
+	if(MDVI_GLYPH_NONEMPTY(entry->grey.data))
+		size += (size_t)entry->grey.w * entry->grey.h * 4;
+
+	return size;
+}
+
+static void glyph_cache_destroy(GlyphCacheEntry *entry, int what)
+{
+	if(what & MDVI_FONTSEL_BITMAP) {
+		if(MDVI_GLYPH_NONEMPTY(entry->shrunk.data))
+			bitmap_destroy((BITMAP *)entry->shrunk.data);
+		entry->shrunk.data = NULL;
+	}
+	if(what & MDVI_FONTSEL_GREY) {
+		if(MDVI_GLYPH_NONEMPTY(entry->grey.data) && entry->free_image)
+			entry->free_image(entry->grey.data);
+		entry->grey.data = NULL;
+	}
+}
+
+static void glyph_cache_remove(GlyphCacheEntry *entry)
+{
+	mdvi_hash_remove_ptr(&glyph_cache, MDVI_KEY(&entry->key));
+	listh_remove(&glyph_cache_lru, LIST(entry));
+	glyph_cache_size -= entry->size;
+}
+
+/* move the shrunk and grey glyphs of a character to the cache */
+static void glyph_cache_store(DviDevice *dev, DviFont *font, int code,
+	DviFontChar *ch)
+{
+	GlyphCacheEntry *entry;
+
+	if(MDVI_GLYPH_UNSET(ch->shrunk.data) && MDVI_GLYPH_UNSET(ch->grey.data))
+		return;
+
+	if(glyph_cache.nbucks == 0) {
+		mdvi_hash_create(&glyph_cache, GLYPH_CACHE_BUCKETS);
+		glyph_cache.hash_func = glyph_cache_hash;
+		glyph_cache.hash_comp = glyph_cache_compare;
+	}
+
+	entry = xalloc(GlyphCacheEntry);
+	entry->key.font = font;
+	entry->key.code = code;
+	entry->key.hshrink = ch->hshrink;
+	entry->key.vshrink = ch->vshrink;
+	entry->shrunk = ch->shrunk;
+	entry->grey = ch->grey;
+	entry->fg = ch->fg;
+	entry->bg = ch->bg;
+	entry->free_image = dev->free_image;
+	entry->size = glyph_cache_entry_size(entry);
+	ch->shrunk.data = NULL;
+	ch->grey.data = NULL;
+
+	/*
+	 * glyphs are taken out of the cache before new ones are created,
+	 * so there can't be another entry with the same key
+	 */
+	mdvi_hash_add(&glyph_cache, MDVI_KEY(&entry->key), entry,
+		MDVI_HASH_UNCHECKED);
+	listh_append(&glyph_cache_lru, LIST(entry));
+	glyph_cache_size += entry->size;
+
+	while(glyph_cache_size > GLYPH_CACHE_MAX_SIZE) {
+		entry = (GlyphCacheEntry *)glyph_cache_lru.head;
+		glyph_cache_remove(entry);
+		glyph_cache_destroy(entry, MDVI_FONTSEL_BITMAP|MDVI_FONTSEL_GREY);
+		mdvi_free(entry);
+	}
+}
+
+/* move the glyphs of the current shrink factors back to a character */
+static void glyph_cache_fetch(DviContext *dvi, DviFont *font, int code,
+	DviFontChar *ch)
+{
+	GlyphCacheKey key;
+	GlyphCacheEntry *entry;
+
+	if(glyph_cache.nkeys == 0)
+		return;
+
+	key.font = font;
+	key.code = code;
+	key.hshrink = dvi->params.hshrink;
+	key.vshrink = dvi->params.vshrink;
+	entry = (GlyphCacheEntry *)mdvi_hash_lookup(&glyph_cache, MDVI_KEY(&key));
+	if(entry == NULL)
+		return;
+
+	glyph_cache_remove(entry);
+	ch->shrunk = entry->shrunk;
+	ch->grey = entry->grey;
+	ch->fg = entry->fg;
+	ch->bg = entry->bg;
+	mdvi_free(entry);
+}
+
+/* destroy the selected glyphs of a font in the cache */
+static void glyph_cache_purge(DviFont *font, int what)
+{
+	GlyphCacheEntry *entry, *next;
+
+	for(entry = (GlyphCacheEntry *)glyph_cache_lru.head; entry; entry = next) {
+		next = entry->next;
+		if(entry->key.font != font)
+			continue;
+		glyph_cache_destroy(entry, what);
+		if(MDVI_GLYPH_UNSET(entry->shrunk.data) &&
+		   MDVI_GLYPH_UNSET(entry->grey.data)) {
+			glyph_cache_remove(entry);
+			mdvi_free(entry);
+		} else {
+			glyph_cache_size -= entry->size;
+			entry->size = glyph_cache_entry_size(entry);
+			glyph_cache_size += entry->size;
+		}
+	}
+}
+
+/*
+ * Fonts, and the glyphs in them, are shared by all the contexts. Clients
+ * rendering with several contexts at the same time must provide a lock,
+ * which is taken while glyphs are loaded and drawn. It must be recursive,
+ * since virtual fonts draw the glyphs of their subfonts.
+ */
+void	mdvi_set_font_lock(DviLockFunc lock, DviLockFunc unlock)
+{
+	font_lock = lock;
+	font_unlock = unlock;
+}
+
+void	mdvi_lock_fonts(void)
+{
+	if(font_lock)
+		font_lock();
+}
+
+void	mdvi_unlock_fonts(void)
+{
+	if(font_unlock)
+		font_unlock();
+}
+
 int	font_reopen(DviFont *font)
 {
 	if(font->in)
@@ -359,6 +573,7 @@ again:
 	if(!ch->loaded && load_one_glyph(dvi, font, code) == -1) {
 		if(font->chars == NULL) {
 			/* we need to try another font class */
+			glyph_cache_purge(font, MDVI_FONTSEL_GLYPH);
 			goto again;
 		}
 		return NULL;
@@ -366,12 +581,22 @@ again:
 	/* yes, we have to do this again */
 	ch = FONTCHAR(font, code);
 
+	/* keep the glyphs of other shrink factors for later */
+	if((!MDVI_GLYPH_UNSET(ch->shrunk.data) || !MDVI_GLYPH_UNSET(ch->grey.data)) &&
+	   (ch->hshrink != dvi->params.hshrink || ch->vshrink != dvi->params.vshrink))
+		glyph_cache_store(&dvi->device, font, code, ch);
+
 	/* Got the glyph. If we also have the right scaled glyph, do no more */
 	if(!ch->width || !ch->height ||
 	   font->finfo->getglyph == NULL ||
 	   (dvi->params.hshrink == 1 && dvi->params.vshrink == 1))
 		return ch;
 
+	if(MDVI_GLYPH_UNSET(ch->shrunk.data) && MDVI_GLYPH_UNSET(ch->grey.data))
+		glyph_cache_fetch(dvi, font, code, ch);
+	ch->hshrink = dvi->params.hshrink;
+	ch->vshrink = dvi->params.vshrink;
+
 	/* If the glyph is empty, we just need to shrink the box */
 	if(ch->missing || MDVI_GLYPH_ISEMPTY(ch->glyph.data)) {
 		if(MDVI_GLYPH_UNSET(ch->shrunk.data))
@@ -441,6 +666,7 @@ void	font_reset_font_glyphs(DviDevice *dev, DviFont *font, int what)
 	if(font->finfo->getglyph == NULL)
 		return;
 	DEBUG((DBG_FONTS, "resetting glyphs in font `%s'\n", font->fontname));
+	glyph_cache_purge(font, what);
 	for(ch = font->chars, i = font->loc; i <= font->hic; ch++, i++) {
 		if(glyph_present(ch))
 			font_reset_one_glyph(dev, ch, what);
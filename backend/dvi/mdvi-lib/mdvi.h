@@ -49,6 +49,7 @@ typedef struct _DviFontSearch DviFontSearch;
 typedef struct _DviFontClass DviFontClass;
 
 typedef void (*DviFreeFunc) __PROTO((void *));
+typedef void (*DviLockFunc) __PROTO((void));
 typedef void (*DviFree2Func) __PROTO((void *, void *));
 
 typedef Ulong	DviColor;
@@ -98,6 +99,7 @@ typedef void *(*DviCreateImage)	__PROTO((void *device_data,
 				         Uint height,
 				         Uint bpp));
 typedef void (*DviFreeImage)	__PROTO((void *image));
+typedef void *(*DviRefImage)	__PROTO((void *image));
 typedef void (*DviPutPixel)	__PROTO((void *image, int x, int y, Ulong color));
 typedef void (*DviImageDone)    __PROTO((void *image));
 typedef void (*DviDevDestroy)   __PROTO((void *data));
@@ -114,6 +116,7 @@ struct _DviDevice {
 	DviColorScale	alloc_colors;
 	DviCreateImage	create_image;
 	DviFreeImage	free_image;
+	DviRefImage	ref_image;
 	DviPutPixel	put_pixel;
         DviImageDone    image_done;
 	DviDevDestroy	dev_destroy;
@@ -201,6 +204,9 @@ struct _DviFontChar {
 	DviGlyph glyph;
 	DviGlyph shrunk;
 	DviGlyph grey;
+	/* shrink factors of `shrunk' and `grey' */
+	Ushort	hshrink;
+	Ushort	vshrink;
 };
 
 struct _DviFontRef {
@@ -398,6 +404,7 @@ struct _DviContext {
 
 	DviFontRef *(*findref) __PROTO((DviContext *, Int32));
 	void	*user_data;	/* client data attached to this context */
+	DviContext *parent;	/* owner of the file data of a clone */
 };
 
 typedef enum {
@@ -495,6 +502,7 @@ extern void	mdvi_sort_pages __PROTO((DviContext *, DviPageSort));
 extern void mdvi_init_kpathsea __PROTO((const char *, const char *, const char *, int, const char *));
 
 extern DviContext* mdvi_init_context __PROTO((DviParams *, DviPageSpec *, const char *));
+extern DviContext* mdvi_clone_context __PROTO((DviContext *));
 extern void 	mdvi_destroy_context __PROTO((DviContext *));
 
 /* helper macros that call mdvi_configure() */
@@ -594,6 +602,11 @@ extern void font_transform_glyph __PROTO((DviOrientation, DviGlyph *));
 /* destroy all fonts that are not being used, returns number of fonts freed */
 extern int font_free_unused __PROTO((DviDevice *));
 
+/* serialize the use of fonts by contexts rendering in several threads */
+extern void mdvi_set_font_lock __PROTO((DviLockFunc, DviLockFunc));
+extern void mdvi_lock_fonts __PROTO((void));
+extern void mdvi_unlock_fonts __PROTO((void));
+
 #define font_free_glyph(dev, font, code) \
 	font_reset_one_glyph((dev), \
 	FONTCHAR((font), (code)), MDVI_FONTSEL_GLYPH)
@@ -298,7 +298,10 @@ void	epsf_special(DviContext *dvi, char *prefix, char *arg)
 
 	mdvi_free (psfile);
 
+	/* kpathsea is also used to look up fonts */
+	mdvi_lock_fonts ();
 	psfile = kpse_find_pict (file);
+	mdvi_unlock_fonts ();
 	if (psfile) { /* kpse */
 		dvi->device.draw_ps (dvi, psfile, x, y, w, h);
 	} else {
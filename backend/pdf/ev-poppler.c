@@ -104,6 +104,8 @@ struct _PdfDocument
 
 	PdfPrintContext *print_ctx;
 
+	/* Annotations are cached while holding a shared document lock */
+	GMutex annots_mutex;
 	GHashTable *annots;
 };
 
@@ -189,10 +191,21 @@ pdf_document_dispose (GObject *object)
 	G_OBJECT_CLASS (pdf_document_parent_class)->dispose (object);
 }
 
+static void
+pdf_document_finalize (GObject *object)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (object);
+
+	g_mutex_clear (&pdf_document->annots_mutex);
+
+	G_OBJECT_CLASS (pdf_document_parent_class)->finalize (object);
+}
+
 static void
 pdf_document_init (PdfDocument *pdf_document)
 {
 	pdf_document->password = NULL;
+	g_mutex_init (&pdf_document->annots_mutex);
 }
 
 static void
@@ -394,10 +407,18 @@ pdf_page_render (PopplerPage     *page,
 	cairo_t *cr;
 	double page_width, page_height;
 	double xscale, yscale;
+	cairo_rectangle_int_t clip;
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-					      width, height);
-	cr = cairo_create (surface);
+	if (ev_render_context_get_clip (rc, &clip)) {
+		surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+						      clip.width, clip.height);
+		cr = cairo_create (surface);
+		cairo_translate (cr, -clip.x, -clip.y);
+	} else {
+		surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+						      width, height);
+		cr = cairo_create (surface);
+	}
 
 	switch (rc->rotation) {
 	        case 90:
@@ -771,6 +792,7 @@ pdf_document_class_init (PdfDocumentClass *klass)
 	EvDocumentClass *ev_document_class = EV_DOCUMENT_CLASS (klass);
 
 	g_object_class->dispose = pdf_document_dispose;
+	g_object_class->finalize = pdf_document_finalize;
 
 	ev_document_class->save = pdf_document_save;
 	ev_document_class->load = pdf_document_load;
@@ -787,14 +809,16 @@ pdf_document_class_init (PdfDocumentClass *klass)
 	ev_document_class->get_backend_info = pdf_document_get_backend_info;
 	ev_document_class->support_synctex = pdf_document_support_synctex;
         ev_document_class->load_fd = pdf_document_load_fd;
+	ev_document_class->concurrent_reads = TRUE;
+	ev_document_class->clipped_render = TRUE;
 }
 
 /* EvDocumentSecurity */
 static gboolean
 pdf_document_has_document_security (EvDocumentSecurity *document_security)
 {
-	/* FIXME: do we really need to have this? */
-	return FALSE;
+	/* The document could only be opened with a password */
+	return PDF_DOCUMENT (document_security)->password != NULL;
 }
 
 static void
@@ -2903,11 +2927,15 @@ pdf_document_annotations_get_annotations (EvDocumentAnnotations *document_annota
 	pdf_document = PDF_DOCUMENT (document_annotations);
 	poppler_page = POPPLER_PAGE (page->backend_page);
 
+	g_mutex_lock (&pdf_document->annots_mutex);
+
 	if (pdf_document->annots) {
 		mapping_list = (EvMappingList *)g_hash_table_lookup (pdf_document->annots,
 								     GINT_TO_POINTER (page->index));
-		if (mapping_list)
+		if (mapping_list) {
+			g_mutex_unlock (&pdf_document->annots_mutex);
 			return ev_mapping_list_ref (mapping_list);
+		}
 	}
 
 	annots = poppler_page_get_annot_mapping (poppler_page);
@@ -2957,8 +2985,10 @@ pdf_document_annotations_get_annotations (EvDocumentAnnotations *document_annota
 
 	poppler_page_free_annot_mapping (annots);
 
-	if (!retval)
+	if (!retval) {
+		g_mutex_unlock (&pdf_document->annots_mutex);
 		return NULL;
+	}
 
 	if (!pdf_document->annots) {
 		pdf_document->annots = g_hash_table_new_full (g_direct_hash,
@@ -2972,6 +3002,8 @@ pdf_document_annotations_get_annotations (EvDocumentAnnotations *document_annota
 			     GINT_TO_POINTER (page->index),
 			     ev_mapping_list_ref (mapping_list));
 
+	g_mutex_unlock (&pdf_document->annots_mutex);
+
 	return mapping_list;
 }
 
@@ -34,6 +34,7 @@
 #include "ev-document-misc.h"
 #include "ev-file-exporter.h"
 #include "ev-file-helpers.h"
+#include "ev-pixels-private.h"
 
 struct _TiffDocumentClass
 {
@@ -220,6 +221,212 @@ tiff_document_get_page_size (EvDocument *document,
 	pop_handlers ();
 }
 
+/* Selects the smallest reduced resolution image of the current page
+ * that is still bigger than @target_width x @target_height, if any */
+static gboolean
+tiff_document_select_reduced_image (TiffDocument *tiff_document,
+				    gint          page,
+				    int           target_width,
+				    int           target_height,
+				    int          *width,
+				    int          *height)
+{
+	TIFF     *tiff = tiff_document->tiff;
+	uint16_t  n_subifds;
+	uint64_t *subifds;
+	uint64_t *offsets;
+	uint64_t  best_offset = 0;
+	int       best_width = *width;
+	int       best_height = *height;
+	guint     i;
+
+	if (!TIFFGetField (tiff, TIFFTAG_SUBIFD, &n_subifds, &subifds) || n_subifds == 0)
+		return FALSE;
+
+	/* The offsets belong to the current directory */
+	offsets = g_memdup2 (subifds, n_subifds * sizeof (uint64_t));
+
+	for (i = 0; i < n_subifds; i++) {
+		uint32_t subfile_type = 0;
+		uint32_t w = 0, h = 0;
+
+		if (!TIFFSetSubDirectory (tiff, offsets[i]))
+			continue;
+
+		TIFFGetField (tiff, TIFFTAG_SUBFILETYPE, &subfile_type);
+		if (!(subfile_type & FILETYPE_REDUCEDIMAGE) || (subfile_type & FILETYPE_MASK))
+			continue;
+
+		if (!TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &w) ||
+		    !TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &h))
+			continue;
+
+		if ((int)w >= target_width && (int)h >= target_height &&
+		    (int)w > 0 && (int)h > 0 && (int)w < best_width) {
+			best_offset = offsets[i];
+			best_width = w;
+			best_height = h;
+		}
+	}
+	g_free (offsets);
+
+	if (best_offset == 0 || !TIFFSetSubDirectory (tiff, best_offset)) {
+		TIFFSetDirectory (tiff, page);
+		return FALSE;
+	}
+
+	*width = best_width;
+	*height = best_height;
+
+	return TRUE;
+}
+
+/* Averages the rows of @src in blocks of @factor x @factor pixels */
+static void
+downsample_rows (const uint32_t *src,
+		 int             width,
+		 int             n_rows,
+		 int             factor,
+		 uint32_t       *dest)
+{
+	int x, y, i;
+
+	for (x = 0; x < width; x += factor) {
+		guint r = 0, g = 0, b = 0, a = 0, n = 0;
+
+		for (y = 0; y < n_rows; y++) {
+			const uint32_t *p = src + y * width + x;
+
+			for (i = 0; i < factor && x + i < width; i++, n++) {
+				r += TIFFGetR (p[i]);
+				g += TIFFGetG (p[i]);
+				b += TIFFGetB (p[i]);
+				a += TIFFGetA (p[i]);
+			}
+		}
+
+		*dest++ = (r / n) | ((g / n) << 8) | ((b / n) << 16) | ((a / n) << 24);
+	}
+}
+
+/* Reads the image of the current directory, whole strips or tiles at a
+ * time, averaging blocks of @factor x @factor pixels. Returns %NULL if
+ * the image can't be read in parts. */
+static uint32_t *
+tiff_document_read_image_reduced (TiffDocument *tiff_document,
+				  int           width,
+				  int           height,
+				  int           factor,
+				  int          *reduced_width,
+				  int          *reduced_height)
+{
+	TIFF          *tiff = tiff_document->tiff;
+	TIFFRGBAImage  img;
+	char           emsg[1024];
+	uint32_t       block_rows = 0;
+	uint32_t      *raster = NULL;
+	uint32_t      *chunk = NULL;
+	int            chunk_rows, row;
+	int            w, h;
+
+	w = (width + factor - 1) / factor;
+	h = (height + factor - 1) / factor;
+
+	if (!TIFFRGBAImageOK (tiff, emsg) || !TIFFRGBAImageBegin (&img, tiff, 0, emsg))
+		return NULL;
+	img.req_orientation = ORIENTATION_TOPLEFT;
+
+	/* Every strip or tile is decoded only once */
+	TIFFGetField (tiff, TIFFIsTiled (tiff) ? TIFFTAG_TILELENGTH : TIFFTAG_ROWSPERSTRIP,
+		      &block_rows);
+	if (block_rows == 0 || block_rows >= (uint32_t)height / factor)
+		chunk_rows = height;
+	else
+		chunk_rows = block_rows * factor;
+
+	raster = g_try_new (uint32_t, (gsize)w * h);
+	chunk = g_try_new (uint32_t, (gsize)width * chunk_rows);
+	if (!raster || !chunk)
+		goto fail;
+
+	for (row = 0; row < height; row += chunk_rows) {
+		int n_rows = MIN (chunk_rows, height - row);
+		int y;
+
+		img.row_offset = row;
+		img.col_offset = 0;
+		if (!TIFFRGBAImageGet (&img, chunk, width, n_rows))
+			goto fail;
+
+		for (y = 0; y < n_rows; y += factor) {
+			downsample_rows (chunk + (gsize)y * width, width,
+					 MIN (factor, n_rows - y), factor,
+					 raster + (gsize)((row + y) / factor) * w);
+		}
+	}
+
+	TIFFRGBAImageEnd (&img);
+	g_free (chunk);
+
+	*reduced_width = w;
+	*reduced_height = h;
+
+	return raster;
+fail:
+	TIFFRGBAImageEnd (&img);
+	g_free (chunk);
+	g_free (raster);
+
+	return NULL;
+}
+
+/* Reads the image of @page in the libtiff ABGR format, at a reduced
+ * resolution when it's at least twice as big as @target_width x
+ * @target_height. @width and @height are updated to the size read. */
+static uint32_t *
+tiff_document_read_image (TiffDocument *tiff_document,
+			  gint          page,
+			  int           orientation,
+			  int           target_width,
+			  int           target_height,
+			  int          *width,
+			  int          *height)
+{
+	TIFF     *tiff = tiff_document->tiff;
+	uint32_t *raster = NULL;
+	uint16_t  file_orientation;
+	gboolean  reduced_image;
+	int       factor;
+
+	reduced_image = tiff_document_select_reduced_image (tiff_document, page,
+							    target_width, target_height,
+							    width, height);
+
+	factor = MIN (*width / MAX (target_width, 1), *height / MAX (target_height, 1));
+	if (factor >= 2 &&
+	    TIFFGetFieldDefaulted (tiff, TIFFTAG_ORIENTATION, &file_orientation) &&
+	    file_orientation == ORIENTATION_TOPLEFT && orientation == ORIENTATION_TOPLEFT)
+		raster = tiff_document_read_image_reduced (tiff_document, *width, *height,
+							   factor, width, height);
+
+	if (!raster) {
+		if (*width >= INT_MAX / 4 || *height >= INT_MAX / (*width * 4))
+			goto out;
+
+		raster = g_try_new (uint32_t, (gsize)*width * *height);
+		if (raster && !TIFFReadRGBAImageOriented (tiff, *width, *height,
+							  raster, orientation, 0))
+			g_clear_pointer (&raster, g_free);
+	}
+
+out:
+	/* Other calls expect the page to be the current directory */
+	if (reduced_image)
+		TIFFSetDirectory (tiff, page);
+
+	return raster;
+}
+
 static cairo_surface_t *
 tiff_document_render (EvDocument      *document,
 		      EvRenderContext *rc)
@@ -228,9 +435,8 @@ tiff_document_render (EvDocument      *document,
 	int width, height;
 	int scaled_width, scaled_height;
 	float x_res, y_res;
-	gint rowstride, bytes;
+	gint rowstride;
 	guchar *pixels = NULL;
-	guchar *p;
 	int orientation;
 	cairo_surface_t *surface;
 	cairo_surface_t *rotated_surface;
@@ -284,23 +490,22 @@ tiff_document_render (EvDocument      *document,
 		/* overflow */
 		return NULL;
 	}
-	bytes = height * rowstride;
 
-	pixels = g_try_malloc (bytes);
-	if (!pixels) {
-		g_warning("Failed to allocate memory for rendering.");
-		return NULL;
-	}
+	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
+					       &scaled_width, &scaled_height);
 
-	if (!TIFFReadRGBAImageOriented (tiff_document->tiff,
-					width, height,
-					(uint32_t *)pixels,
-					orientation, 0)) {
+	push_handlers ();
+	pixels = (guchar *) tiff_document_read_image (tiff_document, rc->page->index, orientation,
+						      scaled_width, scaled_height / (x_res / y_res),
+						      &width, &height);
+	if (!pixels) {
+		pop_handlers ();
 		g_warning ("Failed to read TIFF image.");
-		g_free (pixels);
 		return NULL;
 	}
 
+	rowstride = width * 4;
+
 	surface = cairo_image_surface_create_for_data (pixels,
 						       CAIRO_FORMAT_RGB24,
 						       width, height,
@@ -312,21 +517,8 @@ tiff_document_render (EvDocument      *document,
 	/* Convert the format returned by libtiff to
 	* what cairo expects
 	*/
-	p = pixels;
-	while (p < pixels + bytes) {
-		guint32 *pixel = (guint32*)p;
-		guint8 r = TIFFGetR(*pixel);
-		guint8 g = TIFFGetG(*pixel);
-		guint8 b = TIFFGetB(*pixel);
-		guint8 a = TIFFGetA(*pixel);
+	ev_pixels_swap_red_blue ((guint32 *)pixels, (gsize)width * height);
 
-		*pixel = (a << 24) | (r << 16) | (g << 8) | b;
-
-		p += 4;
-	}
-
-	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
-					       &scaled_width, &scaled_height);
 	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
 								     scaled_width, scaled_height,
 								     rc->rotation);
@@ -349,7 +541,7 @@ tiff_document_get_thumbnail (EvDocument      *document,
 	int width, height;
 	int scaled_width, scaled_height;
 	float x_res, y_res;
-	gint rowstride, bytes;
+	gint rowstride;
 	guchar *pixels = NULL;
 	GdkPixbuf *pixbuf;
 	GdkPixbuf *scaled_pixbuf;
@@ -387,27 +579,26 @@ tiff_document_get_thumbnail (EvDocument      *document,
 	if (height >= INT_MAX / rowstride)
 		/* overflow */
 		return NULL;
-	bytes = height * rowstride;
 
-	pixels = g_try_malloc (bytes);
-	if (!pixels)
-		return NULL;
+	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
+					       &scaled_width, &scaled_height);
 
-	if (!TIFFReadRGBAImageOriented (tiff_document->tiff,
-					width, height,
-					(uint32_t *)pixels,
-					ORIENTATION_TOPLEFT, 0)) {
-		g_free (pixels);
+	push_handlers ();
+	pixels = (guchar *) tiff_document_read_image (tiff_document, rc->page->index,
+						      ORIENTATION_TOPLEFT,
+						      scaled_width, scaled_height / (x_res / y_res),
+						      &width, &height);
+	if (!pixels) {
+		pop_handlers ();
 		return NULL;
 	}
+	rowstride = width * 4;
 
 	pixbuf = gdk_pixbuf_new_from_data (pixels, GDK_COLORSPACE_RGB, TRUE, 8,
 					   width, height, rowstride,
 					   free_buffer, NULL);
 	pop_handlers ();
 
-	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
-					       &scaled_width, &scaled_height);
 	scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
 						 scaled_width, scaled_height,
 						 GDK_INTERP_BILINEAR);
@@ -0,0 +1,147 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "ev-pixels-private.h"
+
+/* A4 page at 300 dpi */
+#define DEFAULT_WIDTH      2480
+#define DEFAULT_HEIGHT     3508
+#define DEFAULT_ITERATIONS 20
+
+static void
+usage (const char *prog)
+{
+	g_print ("- Measures the throughput of the pixel conversions\n");
+	g_print ("Usage: %s [width height [iterations]]\n", prog);
+}
+
+static void
+report (const gchar *name,
+	gint64       elapsed,
+	gsize        n_pixels,
+	gint         iterations)
+{
+	g_print ("%-16s %8.2f ms/page %10.1f Mpixels/s\n",
+		 name,
+		 elapsed / 1000. / iterations,
+		 (gdouble)n_pixels * iterations / MAX (elapsed, 1));
+}
+
+int
+main (int argc, char *argv[])
+{
+	gint     width = DEFAULT_WIDTH;
+	gint     height = DEFAULT_HEIGHT;
+	gint     iterations = DEFAULT_ITERATIONS;
+	gsize    n_pixels;
+	guint32 *pixels;
+	guint8  *bytes;
+	gint64   start;
+	gsize    i;
+	gint     j;
+
+	if (argc != 1 && argc != 3 && argc != 4) {
+		usage (argv[0]);
+		return 1;
+	}
+
+	if (argc > 1) {
+		width = atoi (argv[1]);
+		height = atoi (argv[2]);
+	}
+	if (argc > 3)
+		iterations = atoi (argv[3]);
+
+	if (width <= 0 || height <= 0 || iterations <= 0) {
+		usage (argv[0]);
+		return 1;
+	}
+
+	n_pixels = (gsize)width * height;
+	pixels = g_new (guint32, n_pixels);
+	bytes = g_new (guint8, n_pixels * 4);
+
+	for (i = 0; i < n_pixels * 4; i++)
+		bytes[i] = g_random_int ();
+
+	g_print ("%d x %d pixels, %d iterations\n", width, height, iterations);
+
+	/* Rows are converted one at a time, like the callers do */
+	start = g_get_monotonic_time ();
+	for (j = 0; j < iterations; j++) {
+		gint y;
+
+		for (y = 0; y < height; y++)
+			ev_pixels_premultiply (bytes + (gsize)y * width * 4,
+					       pixels + (gsize)y * width, width);
+	}
+	report ("premultiply", g_get_monotonic_time () - start, n_pixels, iterations);
+
+	start = g_get_monotonic_time ();
+	for (j = 0; j < iterations; j++) {
+		gint y;
+
+		for (y = 0; y < height; y++)
+			ev_pixels_unpremultiply (pixels + (gsize)y * width,
+						 bytes + (gsize)y * width * 4, width);
+	}
+	report ("unpremultiply", g_get_monotonic_time () - start, n_pixels, iterations);
+
+	start = g_get_monotonic_time ();
+	for (j = 0; j < iterations; j++)
+		ev_pixels_swap_red_blue (pixels, n_pixels);
+	report ("swap red blue", g_get_monotonic_time () - start, n_pixels, iterations);
+
+	start = g_get_monotonic_time ();
+	for (j = 0; j < iterations; j++) {
+		gint y;
+
+		for (y = 0; y < height; y++)
+			ev_pixels_invert (pixels + (gsize)y * width, width);
+	}
+	report ("invert", g_get_monotonic_time () - start, n_pixels, iterations);
+
+	start = g_get_monotonic_time ();
+	for (j = 0; j < iterations; j++) {
+		gint y;
+
+		for (y = 0; y < height; y++)
+			ev_pixels_from_rgb (bytes + (gsize)y * width * 3,
+					    pixels + (gsize)y * width, width);
+	}
+	report ("from rgb", g_get_monotonic_time () - start, n_pixels, iterations);
+
+	start = g_get_monotonic_time ();
+	for (j = 0; j < iterations; j++) {
+		gint y;
+
+		for (y = 0; y < height; y++)
+			ev_pixels_to_rgb (pixels + (gsize)y * width,
+					  bytes + (gsize)y * width * 3, width);
+	}
+	report ("to rgb", g_get_monotonic_time () - start, n_pixels, iterations);
+
+	g_free (bytes);
+	g_free (pixels);
+
+	return 0;
+}
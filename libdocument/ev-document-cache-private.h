@@ -0,0 +1,78 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#if !defined (EVINCE_COMPILATION)
+#error "Only <evince-document.h> can be included directly."
+#endif
+
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+
+#include "ev-macros.h"
+#include "ev-document.h"
+
+G_BEGIN_DECLS
+
+/* Bump the version whenever the format changes, files written with
+ * a different version are ignored.
+ *
+ * (version, key, n_pages, page sizes, (max_width, max_height, min_width,
+ *  min_height), max_label, page labels, has_outline, outline)
+ *
+ * There is a single page size when all pages have the same size, and
+ * no page labels when the document doesn't have custom labels.
+ */
+#define EV_DOCUMENT_CACHE_SUFFIX         ".cache"
+#define EV_DOCUMENT_CACHE_VERSION        1
+#define EV_DOCUMENT_CACHE_OUTLINE_ITEM   "(ubsms(yyidddddyms))"
+#define EV_DOCUMENT_CACHE_FORMAT         "(usia(dd)(dddd)iamsba" EV_DOCUMENT_CACHE_OUTLINE_ITEM ")"
+
+EV_PRIVATE
+gchar        *ev_document_cache_get_key            (GFile        *file,
+						    const gchar  *backend);
+EV_PRIVATE
+GVariant     *ev_document_cache_load               (const gchar  *key,
+						    const gchar  *suffix,
+						    const gchar  *format,
+						    guint32       version);
+EV_PRIVATE
+void          ev_document_cache_save               (const gchar  *key,
+						    const gchar  *suffix,
+						    GVariant     *cache);
+EV_PRIVATE
+cairo_surface_t *ev_document_cache_load_surface    (const gchar     *key,
+						    const gchar     *suffix);
+EV_PRIVATE
+void          ev_document_cache_save_surface       (const gchar     *key,
+						    const gchar     *suffix,
+						    cairo_surface_t *surface);
+EV_PRIVATE
+GVariant   *ev_document_cache_outline_new        (GtkTreeModel *model);
+EV_PRIVATE
+GtkTreeModel *ev_document_cache_outline_get_model  (GVariant     *outline);
+
+/* EvDocument */
+EV_PRIVATE
+GtkTreeModel *ev_document_get_cached_outline       (EvDocument   *document);
+EV_PRIVATE
+void          ev_document_set_cached_outline       (EvDocument   *document,
+						    GtkTreeModel *model);
+
+G_END_DECLS
@@ -0,0 +1,694 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "ev-document-cache-private.h"
+#include "ev-document-links.h"
+#include "ev-file-helpers.h"
+
+/* Only the beginning and the end of the file are hashed, together with
+ * its identity, so that computing the key doesn't read the whole file */
+#define CONTENT_HASH_SIZE (64 * 1024)
+
+/* Files not used for this long are removed, and then the least recently
+ * used ones until the cache fits in the maximum size */
+#define CACHE_MAX_AGE  (30 * 24 * 60 * 60)
+#define CACHE_MAX_SIZE (256 * 1024 * 1024)
+
+#define NO_ACTION 0xff
+
+enum {
+	DEST_CHANGE_LEFT = 1 << 0,
+	DEST_CHANGE_TOP  = 1 << 1,
+	DEST_CHANGE_ZOOM = 1 << 2
+};
+
+static gchar *
+ev_document_cache_get_dirname (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "evince",
+				 "documents", NULL);
+}
+
+static gchar *
+ev_document_cache_get_filename (const gchar *key,
+				const gchar *suffix)
+{
+	gchar *basename;
+	gchar *dirname;
+	gchar *filename;
+
+	basename = g_strconcat (key, suffix, NULL);
+	dirname = ev_document_cache_get_dirname ();
+	filename = g_build_filename (dirname, basename, NULL);
+	g_free (dirname);
+	g_free (basename);
+
+	return filename;
+}
+
+/* Marks a cache file as used, the sweep removes the least recently
+ * used files first */
+static void
+ev_document_cache_touch (const gchar *filename)
+{
+	g_utime (filename, NULL);
+}
+
+typedef struct {
+	gchar  *filename;
+	gint64  mtime;
+	goffset size;
+} CacheFile;
+
+static gint
+cache_file_compare_mtime (gconstpointer a,
+			  gconstpointer b)
+{
+	const CacheFile *file_a = a;
+	const CacheFile *file_b = b;
+
+	/* Most recently used first */
+	return (file_a->mtime < file_b->mtime) - (file_a->mtime > file_b->mtime);
+}
+
+static void
+cache_file_clear (CacheFile *file)
+{
+	g_free (file->filename);
+}
+
+/* Removes the files that have not been used for CACHE_MAX_AGE, and the
+ * least recently used ones beyond CACHE_MAX_SIZE. This covers all the
+ * files with a key: caches, text indexes and thumbnails.
+ */
+static void
+ev_document_cache_sweep (void)
+{
+	GDir        *dir;
+	GArray      *files;
+	gchar       *dirname;
+	const gchar *name;
+	gint64       now;
+	goffset      total_size = 0;
+	guint        i;
+
+	dirname = ev_document_cache_get_dirname ();
+	dir = g_dir_open (dirname, 0, NULL);
+	if (!dir) {
+		g_free (dirname);
+		return;
+	}
+
+	now = g_get_real_time () / G_USEC_PER_SEC;
+	files = g_array_new (FALSE, FALSE, sizeof (CacheFile));
+	g_array_set_clear_func (files, (GDestroyNotify)cache_file_clear);
+
+	while ((name = g_dir_read_name (dir))) {
+		CacheFile file;
+		GStatBuf  buf;
+
+		file.filename = g_build_filename (dirname, name, NULL);
+		if (g_stat (file.filename, &buf) == -1 || !S_ISREG (buf.st_mode)) {
+			g_free (file.filename);
+			continue;
+		}
+
+		if (now - buf.st_mtime > CACHE_MAX_AGE) {
+			g_unlink (file.filename);
+			g_free (file.filename);
+			continue;
+		}
+
+		file.mtime = buf.st_mtime;
+		file.size = buf.st_size;
+		total_size += file.size;
+		g_array_append_val (files, file);
+	}
+	g_dir_close (dir);
+
+	if (total_size > CACHE_MAX_SIZE) {
+		g_array_sort (files, cache_file_compare_mtime);
+		for (i = files->len; i > 0 && total_size > CACHE_MAX_SIZE; i--) {
+			CacheFile *file = &g_array_index (files, CacheFile, i - 1);
+
+			if (g_unlink (file->filename) == 0)
+				total_size -= file->size;
+		}
+	}
+
+	g_array_unref (files);
+	g_free (dirname);
+}
+
+static gboolean
+ev_document_cache_hash_content (GChecksum    *checksum,
+				GInputStream *stream,
+				guint64       size)
+{
+	guchar *buffer;
+	gsize   n_read;
+	gboolean retval = FALSE;
+
+	buffer = g_malloc (CONTENT_HASH_SIZE);
+
+	if (!g_input_stream_read_all (stream, buffer, CONTENT_HASH_SIZE,
+				      &n_read, NULL, NULL))
+		goto out;
+	g_checksum_update (checksum, buffer, n_read);
+
+	if (size > 2 * CONTENT_HASH_SIZE) {
+		if (!g_seekable_seek (G_SEEKABLE (stream), -CONTENT_HASH_SIZE,
+				      G_SEEK_END, NULL, NULL))
+			goto out;
+		if (!g_input_stream_read_all (stream, buffer, CONTENT_HASH_SIZE,
+					      &n_read, NULL, NULL))
+			goto out;
+		g_checksum_update (checksum, buffer, n_read);
+	} else if (size > CONTENT_HASH_SIZE) {
+		if (!g_input_stream_read_all (stream, buffer, CONTENT_HASH_SIZE,
+					      &n_read, NULL, NULL))
+			goto out;
+		g_checksum_update (checksum, buffer, n_read);
+	}
+
+	retval = TRUE;
+ out:
+	g_free (buffer);
+
+	return retval;
+}
+
+/*
+ * ev_document_cache_get_key:
+ * @file: the document file
+ * @backend: the type name of the document backend
+ *
+ * Returns: the key of the cache file of @file, built from the file
+ *   identity (device, inode, modification time and size), a hash of
+ *   its contents and @backend, or %NULL if @file can't be cached.
+ */
+gchar *
+ev_document_cache_get_key (GFile       *file,
+			   const gchar *backend)
+{
+	GFileInfo        *info;
+	GFileInputStream *stream;
+	GChecksum        *checksum;
+	gchar            *identity;
+	gchar            *key = NULL;
+	guint64           size;
+
+	/* Temporary copies, like decompressed documents, get a
+	 * different identity every time they are opened */
+	if (!g_file_is_native (file) || ev_file_is_temp (file))
+		return NULL;
+
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_UNIX_DEVICE ","
+				  G_FILE_ATTRIBUTE_UNIX_INODE ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (!info)
+		return NULL;
+
+	if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE) ||
+	    !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)) {
+		g_object_unref (info);
+		return NULL;
+	}
+
+	size = g_file_info_get_size (info);
+	identity = g_strdup_printf ("%s:%u:%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT ":%u:%" G_GUINT64_FORMAT ":",
+				    backend,
+				    g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE),
+				    g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE),
+				    g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+				    g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC),
+				    size);
+	g_object_unref (info);
+
+	stream = g_file_read (file, NULL, NULL);
+	if (!stream) {
+		g_free (identity);
+		return NULL;
+	}
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA256);
+	g_checksum_update (checksum, (const guchar *)identity, -1);
+	if (ev_document_cache_hash_content (checksum, G_INPUT_STREAM (stream), size))
+		key = g_strdup (g_checksum_get_string (checksum));
+
+	g_checksum_free (checksum);
+	g_object_unref (stream);
+	g_free (identity);
+
+	return key;
+}
+
+/*
+ * ev_document_cache_load:
+ * @key: a key returned by ev_document_cache_get_key()
+ * @suffix: the suffix of the file, like %EV_DOCUMENT_CACHE_SUFFIX
+ * @format: the format of the file, it must start with the version and
+ *   the key, like %EV_DOCUMENT_CACHE_FORMAT
+ * @expected_version: the expected version
+ *
+ * Returns: (transfer full): the contents of the cache file for @key,
+ *   or %NULL if there isn't a valid cache file. The file is mapped in
+ *   memory while the returned #GVariant, or any of its children, is alive.
+ */
+GVariant *
+ev_document_cache_load (const gchar *key,
+			const gchar *suffix,
+			const gchar *format,
+			guint32      expected_version)
+{
+	GMappedFile *mapped_file;
+	GBytes      *bytes;
+	GVariant    *cache;
+	gchar       *filename;
+	guint32      version;
+	const gchar *cache_key;
+
+	filename = ev_document_cache_get_filename (key, suffix);
+	mapped_file = g_mapped_file_new (filename, FALSE, NULL);
+	if (!mapped_file) {
+		g_free (filename);
+		return NULL;
+	}
+
+	bytes = g_mapped_file_get_bytes (mapped_file);
+	g_mapped_file_unref (mapped_file);
+
+	/* Data coming from the file is not trusted, GVariant
+	 * handles invalid serialized data gracefully */
+	cache = g_variant_new_from_bytes (G_VARIANT_TYPE (format), bytes, FALSE);
+	g_bytes_unref (bytes);
+	g_variant_ref_sink (cache);
+
+	g_variant_get_child (cache, 0, "u", &version);
+	g_variant_get_child (cache, 1, "&s", &cache_key);
+	if (version != expected_version || g_strcmp0 (cache_key, key) != 0) {
+		g_variant_unref (cache);
+		g_free (filename);
+		return NULL;
+	}
+
+	ev_document_cache_touch (filename);
+	g_free (filename);
+
+	return cache;
+}
+
+static void
+ev_document_cache_save_data (const gchar   *key,
+			     const gchar   *suffix,
+			     gconstpointer  data,
+			     gsize          size)
+{
+	static gsize swept = 0;
+	gchar  *filename;
+	gchar  *dirname;
+	GError *error = NULL;
+
+	/* The cache is swept once per process, the first time it grows */
+	if (g_once_init_enter (&swept)) {
+		ev_document_cache_sweep ();
+		g_once_init_leave (&swept, 1);
+	}
+
+	filename = ev_document_cache_get_filename (key, suffix);
+	dirname = g_path_get_dirname (filename);
+
+	if (g_mkdir_with_parents (dirname, 0700) == -1 ||
+	    !g_file_set_contents_full (filename, data, size,
+				       G_FILE_SET_CONTENTS_CONSISTENT,
+				       0600, &error)) {
+		g_debug ("Failed to save document cache %s: %s", filename,
+			 error ? error->message : g_strerror (errno));
+		g_clear_error (&error);
+	}
+
+	g_free (dirname);
+	g_free (filename);
+}
+
+/*
+ * ev_document_cache_save:
+ * @key: a key returned by ev_document_cache_get_key()
+ * @suffix: the suffix of the file
+ * @cache: the contents of the cache file
+ *
+ * Atomically replaces the cache file for @key and @suffix. Errors are
+ * ignored, the cache is only an optimization.
+ */
+void
+ev_document_cache_save (const gchar *key,
+			const gchar *suffix,
+			GVariant    *cache)
+{
+	ev_document_cache_save_data (key, suffix,
+				     g_variant_get_data (cache),
+				     g_variant_get_size (cache));
+}
+
+/*
+ * ev_document_cache_load_surface:
+ * @key: a key returned by ev_document_cache_get_key()
+ * @suffix: the suffix of the file
+ *
+ * Returns: (transfer full) (nullable): the image saved with
+ *   ev_document_cache_save_surface(), or %NULL if there isn't a valid one
+ */
+cairo_surface_t *
+ev_document_cache_load_surface (const gchar *key,
+				const gchar *suffix)
+{
+	cairo_surface_t *surface;
+	gchar           *filename;
+
+	filename = ev_document_cache_get_filename (key, suffix);
+	surface = cairo_image_surface_create_from_png (filename);
+
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
+		g_free (filename);
+		return NULL;
+	}
+
+	ev_document_cache_touch (filename);
+	g_free (filename);
+
+	return surface;
+}
+
+static cairo_status_t
+write_png_data (void                *closure,
+		const unsigned char *data,
+		unsigned int         length)
+{
+	g_byte_array_append ((GByteArray *)closure, data, length);
+
+	return CAIRO_STATUS_SUCCESS;
+}
+
+/*
+ * ev_document_cache_save_surface:
+ * @key: a key returned by ev_document_cache_get_key()
+ * @suffix: the suffix of the file
+ * @surface: an image surface
+ *
+ * Atomically replaces the cache file for @key and @suffix with @surface
+ * encoded as PNG.
+ */
+void
+ev_document_cache_save_surface (const gchar     *key,
+				const gchar     *suffix,
+				cairo_surface_t *surface)
+{
+	GByteArray *png;
+
+	png = g_byte_array_new ();
+	if (cairo_surface_write_to_png_stream (surface, write_png_data, png) == CAIRO_STATUS_SUCCESS)
+		ev_document_cache_save_data (key, suffix, png->data, png->len);
+	g_byte_array_unref (png);
+}
+
+static GVariant *
+outline_action_to_variant (EvLinkAction *action)
+{
+	EvLinkDest  *dest;
+	guint8       action_type = NO_ACTION;
+	guint8       dest_type = EV_LINK_DEST_TYPE_UNKNOWN;
+	guint8       change = 0;
+	gint         page = -1;
+	gdouble      left = 0, top = 0, bottom = 0, right = 0, zoom = 0;
+	gboolean     change_left, change_top, change_zoom;
+	const gchar *string = NULL;
+
+	if (!action)
+		goto out;
+
+	action_type = ev_link_action_get_action_type (action);
+	switch (action_type) {
+	case EV_LINK_ACTION_TYPE_GOTO_DEST:
+		dest = ev_link_action_get_dest (action);
+		if (!dest)
+			return NULL;
+
+		dest_type = ev_link_dest_get_dest_type (dest);
+		if (dest_type == EV_LINK_DEST_TYPE_UNKNOWN)
+			return NULL;
+
+		page = ev_link_dest_get_page (dest);
+		left = ev_link_dest_get_left (dest, &change_left);
+		top = ev_link_dest_get_top (dest, &change_top);
+		bottom = ev_link_dest_get_bottom (dest);
+		right = ev_link_dest_get_right (dest);
+		zoom = ev_link_dest_get_zoom (dest, &change_zoom);
+		change = (change_left ? DEST_CHANGE_LEFT : 0) |
+			 (change_top ? DEST_CHANGE_TOP : 0) |
+			 (change_zoom ? DEST_CHANGE_ZOOM : 0);
+
+		if (dest_type == EV_LINK_DEST_TYPE_NAMED)
+			string = ev_link_dest_get_named_dest (dest);
+		else if (dest_type == EV_LINK_DEST_TYPE_PAGE_LABEL)
+			string = ev_link_dest_get_page_label (dest);
+		break;
+	case EV_LINK_ACTION_TYPE_EXTERNAL_URI:
+		string = ev_link_action_get_uri (action);
+		break;
+	case EV_LINK_ACTION_TYPE_NAMED:
+		string = ev_link_action_get_name (action);
+		break;
+	default:
+		/* Remote, launch, layers and reset form actions
+		 * are not cached */
+		return NULL;
+	}
+ out:
+	return g_variant_new ("(yyidddddyms)", action_type, dest_type, page,
+			      left, top, bottom, right, zoom, change, string);
+}
+
+static gboolean
+outline_add_items (GVariantBuilder *builder,
+		   GtkTreeModel    *model,
+		   GtkTreeIter     *parent,
+		   guint            depth)
+{
+	GtkTreeIter iter;
+
+	if (!gtk_tree_model_iter_children (model, &iter, parent))
+		return TRUE;
+
+	do {
+		gchar    *markup = NULL;
+		EvLink   *link = NULL;
+		gboolean  expand = FALSE;
+		GVariant *action = NULL;
+
+		gtk_tree_model_get (model, &iter,
+				    EV_DOCUMENT_LINKS_COLUMN_MARKUP, &markup,
+				    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
+				    EV_DOCUMENT_LINKS_COLUMN_EXPAND, &expand,
+				    -1);
+
+		action = outline_action_to_variant (link ? ev_link_get_action (link) : NULL);
+		if (action) {
+			g_variant_builder_add (builder, "(ubsms@(yyidddddyms))",
+					       depth, expand, markup ? markup : "",
+					       link ? ev_link_get_title (link) : NULL,
+					       action);
+		}
+
+		g_free (markup);
+		g_clear_object (&link);
+
+		if (!action)
+			return FALSE;
+		if (!outline_add_items (builder, model, &iter, depth + 1))
+			return FALSE;
+	} while (gtk_tree_model_iter_next (model, &iter));
+
+	return TRUE;
+}
+
+/*
+ * ev_document_cache_outline_new:
+ * @model: a links model, see ev_document_links_get_links_model()
+ *
+ * Returns: (transfer full): the outline in @model as an array of
+ *   %EV_DOCUMENT_CACHE_OUTLINE_ITEM, in depth-first order, or %NULL
+ *   if any of its links can't be cached.
+ */
+GVariant *
+ev_document_cache_outline_new (GtkTreeModel *model)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" EV_DOCUMENT_CACHE_OUTLINE_ITEM));
+	if (!outline_add_items (&builder, model, NULL, 0)) {
+		g_variant_builder_clear (&builder);
+		return NULL;
+	}
+
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static EvLinkDest *
+outline_dest_new (EvLinkDestType dest_type,
+		  gint           page,
+		  gdouble        left,
+		  gdouble        top,
+		  gdouble        bottom,
+		  gdouble        right,
+		  gdouble        zoom,
+		  guint8         change,
+		  const gchar   *string)
+{
+	switch (dest_type) {
+	case EV_LINK_DEST_TYPE_PAGE:
+		return ev_link_dest_new_page (page);
+	case EV_LINK_DEST_TYPE_XYZ:
+		return ev_link_dest_new_xyz (page, left, top, MAX (zoom, 0),
+					     change & DEST_CHANGE_LEFT,
+					     change & DEST_CHANGE_TOP,
+					     change & DEST_CHANGE_ZOOM);
+	case EV_LINK_DEST_TYPE_FIT:
+		return ev_link_dest_new_fit (page);
+	case EV_LINK_DEST_TYPE_FITH:
+		return ev_link_dest_new_fith (page, top, change & DEST_CHANGE_TOP);
+	case EV_LINK_DEST_TYPE_FITV:
+		return ev_link_dest_new_fitv (page, left, change & DEST_CHANGE_LEFT);
+	case EV_LINK_DEST_TYPE_FITR:
+		return ev_link_dest_new_fitr (page, left, bottom, right, top);
+	case EV_LINK_DEST_TYPE_NAMED:
+		return string ? ev_link_dest_new_named (string) : NULL;
+	case EV_LINK_DEST_TYPE_PAGE_LABEL:
+		return string ? ev_link_dest_new_page_label (string) : NULL;
+	default:
+		return NULL;
+	}
+}
+
+static EvLinkAction *
+outline_action_from_variant (GVariant *value)
+{
+	EvLinkAction *action;
+	EvLinkDest   *dest;
+	guint8        action_type, dest_type, change;
+	gint          page;
+	gdouble       left, top, bottom, right, zoom;
+	const gchar  *string;
+
+	g_variant_get (value, "(yyidddddym&s)", &action_type, &dest_type, &page,
+		       &left, &top, &bottom, &right, &zoom, &change, &string);
+
+	switch (action_type) {
+	case EV_LINK_ACTION_TYPE_GOTO_DEST:
+		dest = outline_dest_new (dest_type, page, left, top, bottom,
+					 right, zoom, change, string);
+		if (!dest)
+			return NULL;
+
+		action = ev_link_action_new_dest (dest);
+		g_object_unref (dest);
+
+		return action;
+	case EV_LINK_ACTION_TYPE_EXTERNAL_URI:
+		return string ? ev_link_action_new_external_uri (string) : NULL;
+	case EV_LINK_ACTION_TYPE_NAMED:
+		return string ? ev_link_action_new_named (string) : NULL;
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * ev_document_cache_outline_get_model:
+ * @outline: an outline returned by ev_document_cache_outline_new()
+ *
+ * Returns: (transfer full): a links model with the items of @outline,
+ *   or %NULL if @outline is not valid
+ */
+GtkTreeModel *
+ev_document_cache_outline_get_model (GVariant *outline)
+{
+	GtkTreeStore *model;
+	GArray       *parents;
+	GVariantIter  iter;
+	guint32       depth;
+	gboolean      expand;
+	const gchar  *markup;
+	const gchar  *title;
+	GVariant     *value;
+
+	model = gtk_tree_store_new (EV_DOCUMENT_LINKS_COLUMN_NUM_COLUMNS,
+				    G_TYPE_STRING,
+				    G_TYPE_OBJECT,
+				    G_TYPE_BOOLEAN,
+				    G_TYPE_STRING);
+	parents = g_array_new (FALSE, FALSE, sizeof (GtkTreeIter));
+
+	g_variant_iter_init (&iter, outline);
+	while (g_variant_iter_next (&iter, "(ub&sm&s@(yyidddddyms))",
+				    &depth, &expand, &markup, &title, &value)) {
+		GtkTreeIter   tree_iter;
+		EvLinkAction *action;
+		EvLink       *link = NULL;
+
+		if (depth > parents->len) {
+			g_variant_unref (value);
+			g_clear_object (&model);
+			break;
+		}
+
+		g_array_set_size (parents, depth);
+		gtk_tree_store_append (model, &tree_iter,
+				       depth > 0 ? &g_array_index (parents, GtkTreeIter, depth - 1) : NULL);
+
+		action = outline_action_from_variant (value);
+		if (title)
+			link = ev_link_new (title, action);
+
+		gtk_tree_store_set (model, &tree_iter,
+				    EV_DOCUMENT_LINKS_COLUMN_MARKUP, markup,
+				    EV_DOCUMENT_LINKS_COLUMN_LINK, link,
+				    EV_DOCUMENT_LINKS_COLUMN_EXPAND, expand,
+				    -1);
+		g_array_append_val (parents, tree_iter);
+
+		g_clear_object (&link);
+		g_clear_object (&action);
+		g_variant_unref (value);
+	}
+
+	g_array_free (parents, TRUE);
+
+	return model ? GTK_TREE_MODEL (model) : NULL;
+}
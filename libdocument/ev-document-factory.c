@@ -375,7 +375,7 @@ ev_document_factory_get_document_full (const char           *uri,
 	}
 
 	result = ev_document_load_full (document, uri_unc ? uri_unc : uri,
-					EV_DOCUMENT_LOAD_FLAG_NONE, &err);
+					flags, &err);
 	if (result == FALSE) {
 		if (err == NULL) {
 			/* FIXME: this really should not happen; the backend should
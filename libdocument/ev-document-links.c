@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include "ev-document-links.h"
+#include "ev-document-cache-private.h"
 
 G_DEFINE_INTERFACE (EvDocumentLinks, ev_document_links, 0)
 
@@ -47,15 +48,25 @@ ev_document_links_has_document_links (EvDocumentLinks *document_links)
  * ev_document_links_get_links_model:
  * @document_links: an #EvDocumentLinks
  *
+ * The model is built from the on-disk document cache when it contains
+ * the outline of the document, see ev_document_load_full().
+ *
  * Returns: (transfer full): a #GtkTreeModel
  */
 GtkTreeModel *
 ev_document_links_get_links_model (EvDocumentLinks *document_links)
 {
 	EvDocumentLinksInterface *iface = EV_DOCUMENT_LINKS_GET_IFACE (document_links);
+	EvDocument *document = EV_DOCUMENT (document_links);
 	GtkTreeModel *retval;
 
+	retval = ev_document_get_cached_outline (document);
+	if (retval)
+		return retval;
+
 	retval = iface->get_links_model (document_links);
+	if (retval)
+		ev_document_set_cached_outline (document, retval);
 
 	return retval;
 }
@@ -83,9 +94,9 @@ ev_document_links_find_link_dest (EvDocumentLinks *document_links,
 	EvDocumentLinksInterface *iface = EV_DOCUMENT_LINKS_GET_IFACE (document_links);
 	EvLinkDest *retval;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (EV_DOCUMENT (document_links));
 	retval = iface->find_link_dest (document_links, link_name);
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (EV_DOCUMENT (document_links));
 
 	return retval;
 }
@@ -97,9 +108,9 @@ ev_document_links_find_link_page (EvDocumentLinks *document_links,
 	EvDocumentLinksInterface *iface = EV_DOCUMENT_LINKS_GET_IFACE (document_links);
 	gint retval;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (EV_DOCUMENT (document_links));
 	retval = iface->find_link_page (document_links, link_name);
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (EV_DOCUMENT (document_links));
 
 	return retval;
 }
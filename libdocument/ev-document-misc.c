@@ -26,6 +26,7 @@
 #include <gtk/gtk.h>
 
 #include "ev-document-misc.h"
+#include "ev-pixels-private.h"
 
 static cairo_surface_t *
 ev_document_misc_render_thumbnail_frame (GtkWidget       *widget,
@@ -141,18 +142,43 @@ cairo_surface_t *
 ev_document_misc_surface_from_pixbuf (GdkPixbuf *pixbuf)
 {
 	cairo_surface_t *surface;
-	cairo_t         *cr;
+	const guint8    *src;
+	guint8          *dest;
+	gint             width, height;
+	gint             src_stride, dest_stride;
+	gboolean         has_alpha;
+	gint             y;
 
 	g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
 
-	surface = cairo_image_surface_create (gdk_pixbuf_get_has_alpha (pixbuf) ?
+	width = gdk_pixbuf_get_width (pixbuf);
+	height = gdk_pixbuf_get_height (pixbuf);
+	has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+
+	surface = cairo_image_surface_create (has_alpha ?
 					      CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
-					      gdk_pixbuf_get_width (pixbuf),
-					      gdk_pixbuf_get_height (pixbuf));
-	cr = cairo_create (surface);
-	gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
-	cairo_paint (cr);
-	cairo_destroy (cr);
+					      width, height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+		return surface;
+
+	/* Only 8 bits RGB and RGBA pixbufs exist */
+	src = gdk_pixbuf_read_pixels (pixbuf);
+	src_stride = gdk_pixbuf_get_rowstride (pixbuf);
+	dest = cairo_image_surface_get_data (surface);
+	dest_stride = cairo_image_surface_get_stride (surface);
+
+	cairo_surface_flush (surface);
+	for (y = 0; y < height; y++) {
+		if (has_alpha)
+			ev_pixels_premultiply (src + y * src_stride,
+					       (guint32 *)(dest + y * dest_stride),
+					       width);
+		else
+			ev_pixels_from_rgb (src + y * src_stride,
+					    (guint32 *)(dest + y * dest_stride),
+					    width);
+	}
+	cairo_surface_mark_dirty (surface);
 
 	return surface;
 }
@@ -166,12 +192,50 @@ ev_document_misc_surface_from_pixbuf (GdkPixbuf *pixbuf)
 GdkPixbuf *
 ev_document_misc_pixbuf_from_surface (cairo_surface_t *surface)
 {
+	GdkPixbuf      *pixbuf;
+	cairo_format_t  format;
+	const guint8   *src;
+	guint8         *dest;
+	gint            width, height;
+	gint            src_stride, dest_stride;
+	gint            y;
+
 	g_return_val_if_fail (surface, NULL);
 
-        return gdk_pixbuf_get_from_surface (surface,
-                                            0, 0,
-                                            cairo_image_surface_get_width (surface),
-                                            cairo_image_surface_get_height (surface));
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+	format = cairo_image_surface_get_format (surface);
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+	    (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24) ||
+	    width <= 0 || height <= 0) {
+		return gdk_pixbuf_get_from_surface (surface, 0, 0, width, height);
+	}
+
+	pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
+				 format == CAIRO_FORMAT_ARGB32,
+				 8, width, height);
+	if (!pixbuf)
+		return NULL;
+
+	cairo_surface_flush (surface);
+	src = cairo_image_surface_get_data (surface);
+	src_stride = cairo_image_surface_get_stride (surface);
+	dest = gdk_pixbuf_get_pixels (pixbuf);
+	dest_stride = gdk_pixbuf_get_rowstride (pixbuf);
+
+	for (y = 0; y < height; y++) {
+		if (format == CAIRO_FORMAT_ARGB32)
+			ev_pixels_unpremultiply ((const guint32 *)(src + y * src_stride),
+						 dest + y * dest_stride,
+						 width);
+		else
+			ev_pixels_to_rgb ((const guint32 *)(src + y * src_stride),
+					  dest + y * dest_stride,
+					  width);
+	}
+
+	return pixbuf;
 }
 
 cairo_surface_t *
@@ -238,6 +302,27 @@ void
 ev_document_misc_invert_surface (cairo_surface_t *surface) {
 	cairo_t *cr;
 
+	if (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE &&
+	    (cairo_image_surface_get_format (surface) == CAIRO_FORMAT_ARGB32 ||
+	     cairo_image_surface_get_format (surface) == CAIRO_FORMAT_RGB24)) {
+		guint8 *data;
+		gint    width, height, stride;
+		gint    y;
+
+		cairo_surface_flush (surface);
+		data = cairo_image_surface_get_data (surface);
+		width = cairo_image_surface_get_width (surface);
+		height = cairo_image_surface_get_height (surface);
+		stride = cairo_image_surface_get_stride (surface);
+
+		/* Same result as the DIFFERENCE with white below */
+		for (y = 0; y < height; y++)
+			ev_pixels_invert ((guint32 *)(data + y * stride), width);
+		cairo_surface_mark_dirty (surface);
+
+		return;
+	}
+
 	cr = cairo_create (surface);
 
 	/* white + DIFFERENCE -> invert */
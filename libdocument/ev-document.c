@@ -28,7 +28,11 @@
 #include <errno.h>
 
 #include "ev-document.h"
+#include "ev-document-cache-private.h"
 #include "ev-document-misc.h"
+#include "ev-document-security.h"
+#include "ev-document-text.h"
+#include "ev-text-index-private.h"
 #include "synctex_parser.h"
 
 enum {
@@ -42,12 +46,19 @@ typedef struct _EvPageSize
 	gdouble height;
 } EvPageSize;
 
+typedef struct _EvPendingThumbnail
+{
+	gchar           *suffix;
+	cairo_surface_t *surface;
+} EvPendingThumbnail;
+
 struct _EvDocumentPrivate
 {
 	gchar          *uri;
 	guint64         file_size;
 
 	gboolean        cache_loaded;
+	gboolean        cache_complete;
 	gint            n_pages;
 	gboolean        modified;
 
@@ -60,12 +71,33 @@ struct _EvDocumentPrivate
 	gdouble         min_width;
 	gdouble         min_height;
 	gint            max_label;
+	gboolean        custom_page_labels;
+
+	/* Protects the page sizes and labels, which are written by
+	 * ev_document_fill_cache() while other threads read them */
+	GMutex          cache_lock;
 
 	gchar         **page_labels;
 	EvPageSize     *page_sizes;
+	gchar         **page_fingerprints;
+
+	/* Pages already measured while the cache is being filled lazily */
+	guint8         *page_measured;
+	gint            n_measured;
+
+	/* Key of the on-disk cache file, NULL if not cacheable */
+	gchar          *cache_key;
+	/* Only thumbnails are cached, see EV_DOCUMENT_LOAD_FLAG_THUMBNAIL_CACHE */
+	gboolean        cache_thumbnails_only;
+	/* Thumbnails rendered with the document locked, saved once it's unlocked */
+	GSList         *pending_thumbnails;
+	GVariant       *cached_outline;
+	EvTextIndex    *text_index;
 	EvDocumentInfo *info;
 
 	synctex_scanner_p synctex_scanner;
+
+	GRWLock         lock;
 };
 
 static guint64         _ev_document_get_size_gfile  (GFile      *file);
@@ -80,8 +112,14 @@ static gchar          *_ev_document_get_page_label  (EvDocument *document,
 static EvDocumentInfo *_ev_document_get_info        (EvDocument *document);
 static gboolean        _ev_document_support_synctex (EvDocument *document);
 
+/* Largest thumbnail, in pixels, stored in the on-disk cache */
+#define MAX_CACHED_THUMBNAIL_SIZE 512
+
 static GMutex ev_doc_mutex;
 static GMutex ev_fc_mutex;
+static GMutex ev_cache_mutex;
+
+static void ev_document_save_pending_thumbnails (EvDocument *document);
 
 typedef struct _EvDocumentPrivate EvDocumentPrivate;
 
@@ -118,11 +156,20 @@ ev_document_finalize (GObject *object)
 	EvDocument *document = EV_DOCUMENT (object);
 	EvDocumentPrivate *priv = GET_PRIVATE (document);
 
+	ev_document_save_pending_thumbnails (document);
+
 	g_clear_pointer (&priv->uri, g_free);
 	g_clear_pointer (&priv->page_sizes, g_free);
 	g_clear_pointer (&priv->page_labels, g_strfreev);
+	g_clear_pointer (&priv->page_fingerprints, g_strfreev);
+	g_clear_pointer (&priv->page_measured, g_free);
+	g_clear_pointer (&priv->cache_key, g_free);
+	g_clear_pointer (&priv->cached_outline, g_variant_unref);
+	g_clear_pointer (&priv->text_index, ev_text_index_free);
 	g_clear_pointer (&priv->info, ev_document_info_free);
 	g_clear_pointer (&priv->synctex_scanner, synctex_scanner_free);
+	g_mutex_clear (&priv->cache_lock);
+	g_rw_lock_clear (&priv->lock);
 
 	G_OBJECT_CLASS (ev_document_parent_class)->finalize (object);
 }
@@ -170,6 +217,9 @@ ev_document_init (EvDocument *document)
 
 	/* Assume all pages are the same size until proven otherwise */
 	priv->uniform = TRUE;
+
+	g_mutex_init (&priv->cache_lock);
+	g_rw_lock_init (&priv->lock);
 }
 
 static void
@@ -237,6 +287,15 @@ ev_document_set_modified (EvDocument *document,
 	}
 }
 
+/**
+ * ev_document_doc_mutex_lock:
+ *
+ * Acquires the global document mutex. It's only kept for compatibility,
+ * new code should use the per-document ev_document_reader_lock() and
+ * ev_document_writer_lock() instead. Note that it doesn't exclude
+ * readers and writers of documents whose backend supports concurrent
+ * reads.
+ */
 void
 ev_document_doc_mutex_lock (void)
 {
@@ -273,93 +332,621 @@ ev_document_fc_mutex_trylock (void)
 	return g_mutex_trylock (&ev_fc_mutex);
 }
 
+/* Backends that don't support concurrent reads keep
+ * using the global document mutex for both readers
+ * and writers, like ev_document_doc_mutex_lock() does.
+ */
+static gboolean
+ev_document_uses_doc_mutex (EvDocument *document)
+{
+	return !EV_DOCUMENT_GET_CLASS (document)->concurrent_reads;
+}
+
+/**
+ * ev_document_supports_concurrent_reads:
+ * @document: an #EvDocument
+ *
+ * Returns: %TRUE if several threads holding a shared lock on @document
+ *   can use it at the same time, see ev_document_reader_lock()
+ *
+ * Since: 49.0
+ */
+gboolean
+ev_document_supports_concurrent_reads (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	return !ev_document_uses_doc_mutex (document);
+}
+
+/**
+ * ev_document_reader_lock:
+ * @document: an #EvDocument
+ *
+ * Acquires a shared lock on @document. Use it around operations that
+ * don't modify the document, like rendering, or getting the text, links
+ * or images of a page. Several threads can hold a shared lock on the same
+ * document at the same time, and documents never block each other.
+ *
+ * Backends that don't set #EvDocumentClass.concurrent_reads keep using
+ * the global document mutex, see ev_document_doc_mutex_lock().
+ *
+ * Since: 49.0
+ */
+void
+ev_document_reader_lock (EvDocument *document)
+{
+	EvDocumentPrivate *priv;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+	priv = GET_PRIVATE (document);
+
+	if (ev_document_uses_doc_mutex (document))
+		g_mutex_lock (&ev_doc_mutex);
+	else
+		g_rw_lock_reader_lock (&priv->lock);
+}
+
+/**
+ * ev_document_reader_unlock:
+ * @document: an #EvDocument
+ *
+ * Releases a lock acquired with ev_document_reader_lock().
+ *
+ * Since: 49.0
+ */
+void
+ev_document_reader_unlock (EvDocument *document)
+{
+	EvDocumentPrivate *priv;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+	priv = GET_PRIVATE (document);
+
+	if (ev_document_uses_doc_mutex (document))
+		g_mutex_unlock (&ev_doc_mutex);
+	else
+		g_rw_lock_reader_unlock (&priv->lock);
+
+	/* Thumbnails are encoded and written out of the lock */
+	ev_document_save_pending_thumbnails (document);
+}
+
+/**
+ * ev_document_reader_trylock:
+ * @document: an #EvDocument
+ *
+ * Tries to acquire a shared lock on @document, see ev_document_reader_lock().
+ *
+ * Returns: %TRUE if the lock was acquired
+ *
+ * Since: 49.0
+ */
+gboolean
+ev_document_reader_trylock (EvDocument *document)
+{
+	EvDocumentPrivate *priv;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+	priv = GET_PRIVATE (document);
+
+	if (ev_document_uses_doc_mutex (document))
+		return g_mutex_trylock (&ev_doc_mutex);
+
+	return g_rw_lock_reader_trylock (&priv->lock);
+}
+
+/**
+ * ev_document_writer_lock:
+ * @document: an #EvDocument
+ *
+ * Acquires an exclusive lock on @document. Use it around operations that
+ * modify the document, like adding, removing or changing annotations,
+ * filling forms, or saving.
+ *
+ * Since: 49.0
+ */
+void
+ev_document_writer_lock (EvDocument *document)
+{
+	EvDocumentPrivate *priv;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+	priv = GET_PRIVATE (document);
+
+	if (ev_document_uses_doc_mutex (document))
+		g_mutex_lock (&ev_doc_mutex);
+	else
+		g_rw_lock_writer_lock (&priv->lock);
+}
+
+/**
+ * ev_document_writer_unlock:
+ * @document: an #EvDocument
+ *
+ * Releases a lock acquired with ev_document_writer_lock().
+ *
+ * Since: 49.0
+ */
+void
+ev_document_writer_unlock (EvDocument *document)
+{
+	EvDocumentPrivate *priv;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+	priv = GET_PRIVATE (document);
+
+	if (ev_document_uses_doc_mutex (document))
+		g_mutex_unlock (&ev_doc_mutex);
+	else
+		g_rw_lock_writer_unlock (&priv->lock);
+}
+
+/* Measures a page and stores its size and label in the cache. Returns
+ * whether the size differs from the one the page had in the cache.
+ */
+static gboolean
+ev_document_cache_page (EvDocument *document,
+			gint        i)
+{
+        EvDocumentPrivate *priv = GET_PRIVATE (document);
+        EvPage     *page = ev_document_get_page (document, i);
+        gdouble     page_width = 0;
+        gdouble     page_height = 0;
+        gdouble     old_width, old_height;
+        EvPageSize *page_size;
+        gchar      *page_label;
+
+        _ev_document_get_page_size (document, page, &page_width, &page_height);
+        page_label = _ev_document_get_page_label (document, page);
+        g_object_unref (page);
+
+        g_mutex_lock (&priv->cache_lock);
+
+        old_width = priv->uniform ? priv->uniform_width : priv->page_sizes[i].width;
+        old_height = priv->uniform ? priv->uniform_height : priv->page_sizes[i].height;
+
+        if (i == 0 && priv->uniform) {
+                priv->uniform_width = page_width;
+                priv->uniform_height = page_height;
+                priv->max_width = priv->uniform_width;
+                priv->max_height = priv->uniform_height;
+                priv->min_width = priv->uniform_width;
+                priv->min_height = priv->uniform_height;
+        } else if (priv->uniform &&
+                    (priv->uniform_width != page_width ||
+                    priv->uniform_height != page_height)) {
+                /* It's a different page size.  Backfill the array. */
+                int j;
+
+                /* Check for potential integer overflow in allocation - Issue #2094 */
+                if ((gsize)priv->n_pages > G_MAXSIZE / sizeof(EvPageSize))
+                        g_error ("Exiting program due to abnormal page count detected: %d", priv->n_pages);
+
+                priv->page_sizes = g_new0 (EvPageSize, priv->n_pages);
+
+                /* Pages not measured yet are assumed to have the
+                 * size of the first one */
+                for (j = 0; j < priv->n_pages; j++) {
+                        page_size = &(priv->page_sizes[j]);
+                        page_size->width = priv->uniform_width;
+                        page_size->height = priv->uniform_height;
+                }
+                priv->uniform = FALSE;
+        }
+        if (!priv->uniform) {
+                page_size = &(priv->page_sizes[i]);
+
+                page_size->width = page_width;
+                page_size->height = page_height;
+
+                if (page_width > priv->max_width)
+                        priv->max_width = page_width;
+                if (page_width < priv->min_width)
+                        priv->min_width = page_width;
+
+                if (page_height > priv->max_height)
+                        priv->max_height = page_height;
+                if (page_height < priv->min_height)
+                        priv->min_height = page_height;
+        }
+
+        if (page_label) {
+                if (!priv->page_labels)
+                        priv->page_labels = g_new0 (gchar *, priv->n_pages + 1);
+
+                if (!priv->custom_page_labels) {
+                        gchar *real_page_label;
+
+                        real_page_label = g_strdup_printf ("%d", i + 1);
+                        priv->custom_page_labels = g_strcmp0 (real_page_label, page_label) != 0;
+                        g_free (real_page_label);
+                }
+
+                g_free (priv->page_labels[i]);
+                priv->page_labels[i] = page_label;
+                priv->max_label = MAX (priv->max_label,
+                                        g_utf8_strlen (page_label, 256));
+        }
+
+        g_mutex_unlock (&priv->cache_lock);
+
+        return i > 0 && (old_width != page_width || old_height != page_height);
+}
+
+/* Must be called with ev_cache_mutex held */
+static void
+ev_document_save_cache_file (EvDocument *document)
+{
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	GVariantBuilder    builder;
+	GVariant          *cache;
+	EvPageSize         uniform_size;
+	gint               i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE (EV_DOCUMENT_CACHE_FORMAT));
+	g_variant_builder_add (&builder, "u", EV_DOCUMENT_CACHE_VERSION);
+	g_variant_builder_add (&builder, "s", priv->cache_key);
+	g_variant_builder_add (&builder, "i", priv->n_pages);
+
+	uniform_size.width = priv->uniform_width;
+	uniform_size.height = priv->uniform_height;
+	g_variant_builder_add_value (&builder,
+				     g_variant_new_fixed_array (G_VARIANT_TYPE ("(dd)"),
+								priv->uniform ? &uniform_size : priv->page_sizes,
+								priv->uniform ? 1 : priv->n_pages,
+								sizeof (EvPageSize)));
+	g_variant_builder_add (&builder, "(dddd)",
+			       priv->max_width, priv->max_height,
+			       priv->min_width, priv->min_height);
+	g_variant_builder_add (&builder, "i", priv->max_label);
+
+	g_variant_builder_open (&builder, G_VARIANT_TYPE ("ams"));
+	for (i = 0; priv->page_labels && i < priv->n_pages; i++)
+		g_variant_builder_add (&builder, "ms", priv->page_labels[i]);
+	g_variant_builder_close (&builder);
+
+	g_variant_builder_add (&builder, "b", priv->cached_outline != NULL);
+	if (priv->cached_outline)
+		g_variant_builder_add_value (&builder, priv->cached_outline);
+	else
+		g_variant_builder_add_value (&builder,
+					     g_variant_new_array (G_VARIANT_TYPE (EV_DOCUMENT_CACHE_OUTLINE_ITEM),
+								  NULL, 0));
+
+	cache = g_variant_ref_sink (g_variant_builder_end (&builder));
+	ev_document_cache_save (priv->cache_key, EV_DOCUMENT_CACHE_SUFFIX, cache);
+	g_variant_unref (cache);
+}
+
+/* Fills the cache from the on-disk cache file, if there's a valid one */
+static gboolean
+ev_document_load_cache_file (EvDocument *document)
+{
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	GVariant          *cache;
+	GVariant          *sizes;
+	GVariant          *labels;
+	const EvPageSize  *page_sizes;
+	gsize              n_sizes;
+	gsize              n_labels;
+	gint               n_pages;
+	gboolean           has_outline;
+
+	cache = ev_document_cache_load (priv->cache_key,
+					EV_DOCUMENT_CACHE_SUFFIX,
+					EV_DOCUMENT_CACHE_FORMAT,
+					EV_DOCUMENT_CACHE_VERSION);
+	if (!cache)
+		return FALSE;
+
+	g_variant_get_child (cache, 2, "i", &n_pages);
+	sizes = g_variant_get_child_value (cache, 3);
+	labels = g_variant_get_child_value (cache, 6);
+	page_sizes = g_variant_get_fixed_array (sizes, &n_sizes, sizeof (EvPageSize));
+	n_labels = g_variant_n_children (labels);
+
+	if (n_pages != priv->n_pages || !page_sizes ||
+	    (n_sizes != 1 && n_sizes != (gsize)n_pages) ||
+	    (n_labels != 0 && n_labels != (gsize)n_pages)) {
+		g_variant_unref (labels);
+		g_variant_unref (sizes);
+		g_variant_unref (cache);
+
+		return FALSE;
+	}
+
+	g_mutex_lock (&priv->cache_lock);
+	priv->uniform = n_sizes == 1;
+	if (priv->uniform) {
+		priv->uniform_width = page_sizes[0].width;
+		priv->uniform_height = page_sizes[0].height;
+	} else {
+		priv->page_sizes = g_memdup2 (page_sizes, n_sizes * sizeof (EvPageSize));
+	}
+	g_variant_get_child (cache, 4, "(dddd)",
+			     &priv->max_width, &priv->max_height,
+			     &priv->min_width, &priv->min_height);
+	g_variant_get_child (cache, 5, "i", &priv->max_label);
+
+	if (n_labels > 0) {
+		GVariantIter iter;
+		gchar       *label;
+		gint         i = 0;
+
+		priv->page_labels = g_new0 (gchar *, priv->n_pages + 1);
+		g_variant_iter_init (&iter, labels);
+		while (g_variant_iter_next (&iter, "ms", &label))
+			priv->page_labels[i++] = label;
+		priv->custom_page_labels = TRUE;
+	}
+
+	g_variant_get_child (cache, 7, "b", &has_outline);
+	if (has_outline)
+		priv->cached_outline = g_variant_get_child_value (cache, 8);
+
+	priv->cache_loaded = TRUE;
+	priv->cache_complete = TRUE;
+	g_mutex_unlock (&priv->cache_lock);
+
+	g_variant_unref (labels);
+	g_variant_unref (sizes);
+	g_variant_unref (cache);
+
+	return TRUE;
+}
+
 static void
-ev_document_setup_cache (EvDocument *document)
+ev_document_complete_cache (EvDocument *document)
+{
+        EvDocumentPrivate *priv = GET_PRIVATE (document);
+
+	g_mutex_lock (&priv->cache_lock);
+	if (!priv->custom_page_labels)
+		g_clear_pointer (&priv->page_labels, g_strfreev);
+	priv->cache_complete = TRUE;
+	g_mutex_unlock (&priv->cache_lock);
+	g_clear_pointer (&priv->page_measured, g_free);
+
+	if (priv->cache_key && !priv->cache_thumbnails_only) {
+		g_mutex_lock (&ev_cache_mutex);
+		ev_document_save_cache_file (document);
+		g_mutex_unlock (&ev_cache_mutex);
+	}
+}
+
+/* Nothing of documents that needed a password to be opened is written
+ * to the on-disk cache, their contents would be stored unencrypted */
+static gboolean
+ev_document_is_protected (EvDocument *document)
+{
+	return EV_IS_DOCUMENT_SECURITY (document) &&
+		ev_document_security_has_document_security (EV_DOCUMENT_SECURITY (document));
+}
+
+static void
+ev_document_setup_cache_key (EvDocument          *document,
+			     GFile               *file,
+			     EvDocumentLoadFlags  flags)
+{
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+
+	if (flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE) {
+		if (!(flags & EV_DOCUMENT_LOAD_FLAG_THUMBNAIL_CACHE))
+			return;
+		priv->cache_thumbnails_only = TRUE;
+	}
+
+	if (priv->n_pages > 0 && !ev_document_is_protected (document))
+		priv->cache_key = ev_document_cache_get_key (file, G_OBJECT_TYPE_NAME (document));
+}
+
+static void
+ev_document_setup_cache (EvDocument *document,
+			 gboolean    lazy)
 {
         EvDocumentPrivate *priv = GET_PRIVATE (document);
-        gboolean custom_page_labels = FALSE;
         gint i;
 
         /* Cache some info about the document to avoid
          * going to the backends since it requires locks
          */
+	if (priv->cache_key && !priv->cache_thumbnails_only &&
+	    ev_document_load_cache_file (document))
+		return;
+
+	g_mutex_lock (&priv->cache_lock);
 	priv->cache_loaded = TRUE;
+	g_mutex_unlock (&priv->cache_lock);
 
-        for (i = 0; i < priv->n_pages; i++) {
-                EvPage     *page = ev_document_get_page (document, i);
-                gdouble     page_width = 0;
-                gdouble     page_height = 0;
-                EvPageSize *page_size;
-                gchar      *page_label;
-
-                _ev_document_get_page_size (document, page, &page_width, &page_height);
-
-                if (i == 0) {
-                        priv->uniform_width = page_width;
-                        priv->uniform_height = page_height;
-                        priv->max_width = priv->uniform_width;
-                        priv->max_height = priv->uniform_height;
-                        priv->min_width = priv->uniform_width;
-                        priv->min_height = priv->uniform_height;
-                } else if (priv->uniform &&
-                            (priv->uniform_width != page_width ||
-                            priv->uniform_height != page_height)) {
-                        /* It's a different page size.  Backfill the array. */
-                        int j;
-
-                        /* Check for potential integer overflow in allocation - Issue #2094 */
-                        if ((gsize)priv->n_pages > G_MAXSIZE / sizeof(EvPageSize))
-                                g_error ("Exiting program due to abnormal page count detected: %d", priv->n_pages);
-
-                        priv->page_sizes = g_new0 (EvPageSize, priv->n_pages);
-
-                        for (j = 0; j < i; j++) {
-                                page_size = &(priv->page_sizes[j]);
-                                page_size->width = priv->uniform_width;
-                                page_size->height = priv->uniform_height;
-                        }
-                        priv->uniform = FALSE;
-                }
-                if (!priv->uniform) {
-                        page_size = &(priv->page_sizes[i]);
+	/* Only the first page is measured now, the others are
+	 * measured later with ev_document_fill_cache() */
+	if (lazy && priv->n_pages > 1) {
+		priv->page_measured = g_new0 (guint8, priv->n_pages);
+		ev_document_cache_page (document, 0);
+		priv->page_measured[0] = TRUE;
+		priv->n_measured = 1;
 
-                        page_size->width = page_width;
-                        page_size->height = page_height;
+		return;
+	}
 
-                        if (page_width > priv->max_width)
-                                priv->max_width = page_width;
-                        if (page_width < priv->min_width)
-                                priv->min_width = page_width;
+        for (i = 0; i < priv->n_pages; i++)
+                ev_document_cache_page (document, i);
 
-                        if (page_height > priv->max_height)
-                                priv->max_height = page_height;
-                        if (page_height < priv->min_height)
-                                priv->min_height = page_height;
-                }
+	ev_document_complete_cache (document);
+}
 
-                page_label = _ev_document_get_page_label (document, page);
-                if (page_label) {
-                        if (!priv->page_labels)
-                                priv->page_labels = g_new0 (gchar *, priv->n_pages + 1);
+/**
+ * ev_document_is_cache_complete:
+ * @document: an #EvDocument
+ *
+ * Returns: %FALSE if @document was loaded with
+ *   %EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE and some pages have not been
+ *   measured yet. Their sizes are estimated from the first page until
+ *   ev_document_fill_cache() measures them.
+ *
+ * Since: 49.0
+ */
+gboolean
+ev_document_is_cache_complete (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), TRUE);
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	gboolean           complete;
 
-                        if (!custom_page_labels) {
-                                gchar *real_page_label;
+	g_mutex_lock (&priv->cache_lock);
+	complete = !priv->cache_loaded || priv->cache_complete;
+	g_mutex_unlock (&priv->cache_lock);
 
-                                real_page_label = g_strdup_printf ("%d", i + 1);
-                                custom_page_labels = g_strcmp0 (real_page_label, page_label) != 0;
-                                g_free (real_page_label);
-                        }
+	return complete;
+}
 
-                        priv->page_labels[i] = page_label;
-                        priv->max_label = MAX (priv->max_label,
-                                                g_utf8_strlen (page_label, 256));
-                }
+/**
+ * ev_document_fill_cache:
+ * @document: an #EvDocument
+ * @page: the page to start from
+ * @n_pages: the maximum number of pages to measure
+ *
+ * Measures up to @n_pages pages that have not been measured yet, starting
+ * at @page and wrapping around the end of the document. This must be
+ * called with the reader lock of @document held, and from one thread at
+ * a time. Other threads can query page sizes and labels meanwhile.
+ *
+ * Returns: %TRUE if the size of any of the measured pages differs from
+ *   its estimated size
+ *
+ * Since: 49.0
+ */
+gboolean
+ev_document_fill_cache (EvDocument *document,
+			gint        page,
+			gint        n_pages)
+{
+	EvDocumentPrivate *priv;
+	gboolean           changed = FALSE;
+	gint               i;
 
-                g_object_unref (page);
-        }
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+	priv = GET_PRIVATE (document);
 
-	if (!custom_page_labels)
-		g_clear_pointer (&priv->page_labels, g_strfreev);
+	if (ev_document_is_cache_complete (document))
+		return FALSE;
+
+	page = CLAMP (page, 0, priv->n_pages - 1);
+	for (i = 0; i < priv->n_pages && n_pages > 0; i++) {
+		gint index = (page + i) % priv->n_pages;
+
+		if (priv->page_measured[index])
+			continue;
+
+		if (ev_document_cache_page (document, index))
+			changed = TRUE;
+		priv->page_measured[index] = TRUE;
+		priv->n_measured++;
+		n_pages--;
+	}
+
+	if (priv->n_measured == priv->n_pages)
+		ev_document_complete_cache (document);
+
+	return changed;
+}
+
+/* Returns a new links model built from the outline in the on-disk
+ * cache, or NULL if the outline is not cached.
+ */
+GtkTreeModel *
+ev_document_get_cached_outline (EvDocument *document)
+{
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	GtkTreeModel      *model = NULL;
+
+	g_mutex_lock (&ev_cache_mutex);
+	if (priv->cached_outline)
+		model = ev_document_cache_outline_get_model (priv->cached_outline);
+	g_mutex_unlock (&ev_cache_mutex);
+
+	return model;
+}
+
+/* Returns the text index of the document, loading it from the on-disk
+ * cache the first time, or NULL if the document can't be indexed.
+ */
+EvTextIndex *
+ev_document_get_text_index (EvDocument *document)
+{
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	EvTextIndex       *index;
+
+	if (!priv->cache_key || priv->cache_thumbnails_only ||
+	    !EV_IS_DOCUMENT_TEXT (document) || ev_document_is_protected (document))
+		return NULL;
+
+	g_mutex_lock (&ev_cache_mutex);
+	if (!priv->text_index)
+		priv->text_index = ev_text_index_new (priv->cache_key, priv->n_pages);
+	index = priv->text_index;
+	g_mutex_unlock (&ev_cache_mutex);
+
+	return index;
+}
+
+/* Stores the outline in @model in the on-disk cache */
+void
+ev_document_set_cached_outline (EvDocument   *document,
+				GtkTreeModel *model)
+{
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	GVariant          *outline;
+
+	if (!priv->cache_key || priv->cache_thumbnails_only)
+		return;
+
+	outline = ev_document_cache_outline_new (model);
+	if (!outline)
+		return;
+
+	g_mutex_lock (&ev_cache_mutex);
+	if (!priv->cached_outline) {
+		priv->cached_outline = outline;
+		outline = NULL;
+
+		/* Otherwise it's saved when the cache is completed */
+		if (priv->cache_complete)
+			ev_document_save_cache_file (document);
+	}
+	g_mutex_unlock (&ev_cache_mutex);
+
+	g_clear_pointer (&outline, g_variant_unref);
+}
+
+/* Fingerprints are computed on load because the file may have been
+ * replaced by a new version by the time they are compared. They are
+ * only needed by documents that are reloaded, so they are computed
+ * when asked for with %EV_DOCUMENT_LOAD_FLAG_FINGERPRINTS.
+ */
+static void
+ev_document_setup_fingerprints (EvDocument          *document,
+				EvDocumentLoadFlags  flags)
+{
+	EvDocumentClass   *klass = EV_DOCUMENT_GET_CLASS (document);
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	gint               i;
+
+	if (!(flags & EV_DOCUMENT_LOAD_FLAG_FINGERPRINTS) ||
+	    (flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
+		return;
+
+	if (!klass->get_page_fingerprint || priv->n_pages <= 0)
+		return;
+
+	priv->page_fingerprints = g_new0 (gchar *, priv->n_pages + 1);
+	for (i = 0; i < priv->n_pages; i++) {
+		EvPage *page = ev_document_get_page (document, i);
+
+		priv->page_fingerprints[i] = klass->get_page_fingerprint (document, page);
+		g_object_unref (page);
+	}
 }
 
 static void
@@ -396,6 +983,16 @@ ev_document_initialize_synctex (EvDocument  *document,
  * used to load the document and the URI, e.g. #GIOError, #GFileError, and
  * #GConvertError.
  *
+ * Unless %EV_DOCUMENT_LOAD_FLAG_NO_CACHE is given, the page sizes, page
+ * labels, outline and thumbnails of local files are saved to an on-disk
+ * cache, and read from it instead of the backend when the same file is
+ * loaded again. With %EV_DOCUMENT_LOAD_FLAG_THUMBNAIL_CACHE too, only the
+ * thumbnails are. Documents opened with a password are never cached.
+ *
+ * With %EV_DOCUMENT_LOAD_FLAG_FINGERPRINTS, usually given when a document
+ * is reloaded, the fingerprints of the pages are computed too, see
+ * ev_document_get_page_fingerprint().
+ *
  * Returns: %TRUE on success, or %FALSE on failure.
  */
 gboolean
@@ -408,6 +1005,7 @@ ev_document_load_full (EvDocument           *document,
 	gboolean retval;
 	GError *err = NULL;
 	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	GFile *file;
 
 	retval = klass->load (document, uri, &err);
 	if (!retval) {
@@ -426,8 +1024,12 @@ ev_document_load_full (EvDocument           *document,
 	} else {
 		priv->info = _ev_document_get_info (document);
 		priv->n_pages = _ev_document_get_n_pages (document);
+		ev_document_setup_fingerprints (document, flags);
+		file = g_file_new_for_uri (uri);
+		ev_document_setup_cache_key (document, file, flags);
+		g_object_unref (file);
 		if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
-			ev_document_setup_cache (document);
+			ev_document_setup_cache (document, flags & EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE);
 		priv->uri = g_strdup (uri);
 		priv->file_size = _ev_document_get_size (uri);
 		ev_document_initialize_synctex (document, uri);
@@ -505,9 +1107,10 @@ ev_document_load_stream (EvDocument         *document,
 
 	priv->info = _ev_document_get_info (document);
 	priv->n_pages = _ev_document_get_n_pages (document);
+	ev_document_setup_fingerprints (document, flags);
 
         if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
-                ev_document_setup_cache (document);
+                ev_document_setup_cache (document, flags & EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE);
 
         return TRUE;
 }
@@ -554,9 +1157,11 @@ ev_document_load_gfile (EvDocument         *document,
 
 	priv->info = _ev_document_get_info (document);
 	priv->n_pages = _ev_document_get_n_pages (document);
+	ev_document_setup_fingerprints (document, flags);
 
+        ev_document_setup_cache_key (document, file, flags);
         if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
-                ev_document_setup_cache (document);
+                ev_document_setup_cache (document, flags & EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE);
 
 	priv->uri = g_file_get_uri (file);
 	priv->file_size = _ev_document_get_size_gfile (file);
@@ -645,9 +1250,10 @@ ev_document_load_fd (EvDocument         *document,
 
         priv->info = _ev_document_get_info (document);
         priv->n_pages = _ev_document_get_n_pages (document);
+        ev_document_setup_fingerprints (document, flags);
 
         if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
-                ev_document_setup_cache (document);
+                ev_document_setup_cache (document, flags & EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE);
 
         return TRUE;
 }
@@ -883,6 +1489,7 @@ ev_document_get_page_size (EvDocument *document,
 	priv = GET_PRIVATE (document);
 	g_return_if_fail (page_index >= 0 || page_index < priv->n_pages);
 
+	g_mutex_lock (&priv->cache_lock);
 	if (priv->cache_loaded) {
 		if (width)
 			*width = priv->uniform ?
@@ -892,14 +1499,17 @@ ev_document_get_page_size (EvDocument *document,
 			*height = priv->uniform ?
 				priv->uniform_height :
 				priv->page_sizes[page_index].height;
+		g_mutex_unlock (&priv->cache_lock);
 	} else {
 		EvPage *page;
 
-		g_mutex_lock (&ev_doc_mutex);
+		g_mutex_unlock (&priv->cache_lock);
+
+		ev_document_reader_lock (document);
 		page = ev_document_get_page (document, page_index);
 		_ev_document_get_page_size (document, page, width, height);
 		g_object_unref (page);
-		g_mutex_unlock (&ev_doc_mutex);
+		ev_document_reader_unlock (document);
 	}
 }
 
@@ -918,26 +1528,32 @@ ev_document_get_page_label (EvDocument *document,
 			    gint        page_index)
 {
 	EvDocumentPrivate *priv;
+	gchar *page_label;
+
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
 	priv = GET_PRIVATE (document);
 	g_return_val_if_fail (page_index >= 0 || page_index < priv->n_pages, NULL);
 
+	g_mutex_lock (&priv->cache_lock);
 	if (!priv->cache_loaded) {
 		EvPage *page;
-		gchar *page_label;
 
-		g_mutex_lock (&ev_doc_mutex);
+		g_mutex_unlock (&priv->cache_lock);
+		ev_document_reader_lock (document);
 		page = ev_document_get_page (document, page_index);
 		page_label = _ev_document_get_page_label (document, page);
 		g_object_unref (page);
-		g_mutex_unlock (&ev_doc_mutex);
+		ev_document_reader_unlock (document);
 
 		return page_label ? page_label : g_strdup_printf ("%d", page_index + 1);
 	}
 
-	return (priv->page_labels && priv->page_labels[page_index]) ?
+	page_label = (priv->page_labels && priv->page_labels[page_index]) ?
 		g_strdup (priv->page_labels[page_index]) :
 		g_strdup_printf ("%d", page_index + 1);
+	g_mutex_unlock (&priv->cache_lock);
+
+	return page_label;
 }
 
 static EvDocumentInfo *
@@ -979,13 +1595,195 @@ ev_document_get_backend_info (EvDocument *document, EvDocumentBackendInfo *info)
 	return klass->get_backend_info (document, info);
 }
 
+static cairo_surface_t *
+ev_document_crop_surface (cairo_surface_t             *surface,
+			  const cairo_rectangle_int_t *clip)
+{
+	cairo_surface_t *cropped;
+	cairo_t         *cr;
+
+	cropped = cairo_surface_create_similar_image (surface, CAIRO_FORMAT_ARGB32,
+						      clip->width, clip->height);
+	cr = cairo_create (cropped);
+	cairo_set_source_surface (cr, surface, -clip->x, -clip->y);
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+
+	return cropped;
+}
+
+/**
+ * ev_document_render:
+ * @document: an #EvDocument
+ * @rc: an #EvRenderContext
+ *
+ * Renders the page of @rc. If @rc has a clip area, only that area is
+ * returned. Backends that don't support clipped rendering render the
+ * whole page, and it's cropped afterwards.
+ *
+ * Returns: (transfer full): a #cairo_surface_t
+ */
 cairo_surface_t *
 ev_document_render (EvDocument      *document,
 		    EvRenderContext *rc)
 {
-	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	EvDocumentClass      *klass = EV_DOCUMENT_GET_CLASS (document);
+	cairo_surface_t      *surface;
+	cairo_surface_t      *cropped;
+	cairo_rectangle_int_t clip;
+
+	surface = klass->render (document, rc);
+	if (!surface || klass->clipped_render || !ev_render_context_get_clip (rc, &clip))
+		return surface;
+
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+		return surface;
+
+	cropped = ev_document_crop_surface (surface, &clip);
+	cairo_surface_destroy (surface);
+
+	return cropped;
+}
+
+/**
+ * ev_document_supports_clipped_render:
+ * @document: an #EvDocument
+ *
+ * Returns: %TRUE if the backend of @document renders only the clip area
+ *   of the render context, instead of rendering the whole page and
+ *   cropping it, see ev_render_context_set_clip()
+ *
+ * Since: 49.0
+ */
+gboolean
+ev_document_supports_clipped_render (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 
-	return klass->render (document, rc);
+	return EV_DOCUMENT_GET_CLASS (document)->clipped_render;
+}
+
+/* Returns the suffix of the thumbnail for @rc in the on-disk cache, or
+ * NULL if it can't be cached. Called with the document lock held.
+ */
+static gchar *
+ev_document_get_thumbnail_cache_suffix (EvDocument      *document,
+					EvRenderContext *rc,
+					gint            *width,
+					gint            *height)
+{
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	gdouble            page_width, page_height;
+
+	/* Unsaved changes aren't in the file the key was computed for */
+	if (!priv->cache_key || priv->modified || rc->has_clip ||
+	    ev_document_is_protected (document))
+		return NULL;
+
+	_ev_document_get_page_size (document, rc->page, &page_width, &page_height);
+	ev_render_context_compute_transformed_size (rc, page_width, page_height,
+						    width, height);
+
+	/* Bigger images are page previews rather than thumbnails */
+	if (*width > MAX_CACHED_THUMBNAIL_SIZE || *height > MAX_CACHED_THUMBNAIL_SIZE)
+		return NULL;
+
+	return g_strdup_printf (".thumbnail-%d-%d-%dx%d.png", rc->page->index,
+				rc->rotation, *width, *height);
+}
+
+static cairo_surface_t *
+ev_document_load_cached_thumbnail (EvDocument      *document,
+				   EvRenderContext *rc,
+				   gchar          **suffix,
+				   gint            *width,
+				   gint            *height)
+{
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	cairo_surface_t   *surface;
+
+	*suffix = ev_document_get_thumbnail_cache_suffix (document, rc, width, height);
+	if (!*suffix)
+		return NULL;
+
+	surface = ev_document_cache_load_surface (priv->cache_key, *suffix);
+	if (surface &&
+	    (cairo_image_surface_get_width (surface) != *width ||
+	     cairo_image_surface_get_height (surface) != *height))
+		g_clear_pointer (&surface, cairo_surface_destroy);
+
+	return surface;
+}
+
+static cairo_surface_t *
+copy_image_surface (cairo_surface_t *surface)
+{
+	cairo_surface_t *copy;
+	cairo_t         *cr;
+
+	copy = cairo_image_surface_create (cairo_image_surface_get_format (surface),
+					   cairo_image_surface_get_width (surface),
+					   cairo_image_surface_get_height (surface));
+	cr = cairo_create (copy);
+	cairo_set_source_surface (cr, surface, 0, 0);
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+
+	return copy;
+}
+
+/* Thumbnails are rendered with the document locked, so they are only
+ * queued here, and encoded and written by
+ * ev_document_save_pending_thumbnails() once the lock is released.
+ */
+static void
+ev_document_save_cached_thumbnail (EvDocument      *document,
+				   const gchar     *suffix,
+				   gint             width,
+				   gint             height,
+				   cairo_surface_t *surface)
+{
+	EvDocumentPrivate  *priv = GET_PRIVATE (document);
+	EvPendingThumbnail *pending;
+
+	if (!suffix || !surface ||
+	    cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+	    cairo_image_surface_get_width (surface) != width ||
+	    cairo_image_surface_get_height (surface) != height)
+		return;
+
+	pending = g_new (EvPendingThumbnail, 1);
+	pending->suffix = g_strdup (suffix);
+	pending->surface = copy_image_surface (surface);
+
+	g_mutex_lock (&priv->cache_lock);
+	priv->pending_thumbnails = g_slist_prepend (priv->pending_thumbnails, pending);
+	g_mutex_unlock (&priv->cache_lock);
+}
+
+static void
+ev_document_save_pending_thumbnails (EvDocument *document)
+{
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	GSList            *pending;
+	GSList            *l;
+
+	g_mutex_lock (&priv->cache_lock);
+	pending = g_steal_pointer (&priv->pending_thumbnails);
+	g_mutex_unlock (&priv->cache_lock);
+
+	for (l = pending; l; l = l->next) {
+		EvPendingThumbnail *thumbnail = l->data;
+
+		ev_document_cache_save_surface (priv->cache_key, thumbnail->suffix,
+						thumbnail->surface);
+		cairo_surface_destroy (thumbnail->surface);
+		g_free (thumbnail->suffix);
+		g_free (thumbnail);
+	}
+	g_slist_free (pending);
 }
 
 static GdkPixbuf *
@@ -1016,11 +1814,33 @@ ev_document_get_thumbnail (EvDocument      *document,
 			   EvRenderContext *rc)
 {
 	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	cairo_surface_t *surface;
+	GdkPixbuf       *pixbuf;
+	gchar           *suffix;
+	gint             width, height;
+
+	surface = ev_document_load_cached_thumbnail (document, rc, &suffix, &width, &height);
+	if (surface) {
+		pixbuf = ev_document_misc_pixbuf_from_surface (surface);
+		cairo_surface_destroy (surface);
+		g_free (suffix);
+
+		return pixbuf;
+	}
 
 	if (klass->get_thumbnail)
-		return klass->get_thumbnail (document, rc);
+		pixbuf = klass->get_thumbnail (document, rc);
+	else
+		pixbuf = _ev_document_get_thumbnail (document, rc);
+
+	if (suffix && pixbuf) {
+		surface = ev_document_misc_surface_from_pixbuf (pixbuf);
+		ev_document_save_cached_thumbnail (document, suffix, width, height, surface);
+		g_clear_pointer (&surface, cairo_surface_destroy);
+	}
+	g_free (suffix);
 
-	return _ev_document_get_thumbnail (document, rc);
+	return pixbuf;
 }
 
 /**
@@ -1037,11 +1857,26 @@ ev_document_get_thumbnail_surface (EvDocument      *document,
 				   EvRenderContext *rc)
 {
 	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	cairo_surface_t *surface;
+	gchar           *suffix;
+	gint             width, height;
+
+	surface = ev_document_load_cached_thumbnail (document, rc, &suffix, &width, &height);
+	if (surface) {
+		g_free (suffix);
+
+		return surface;
+	}
 
 	if (klass->get_thumbnail_surface)
-		return klass->get_thumbnail_surface (document, rc);
+		surface = klass->get_thumbnail_surface (document, rc);
+	else
+		surface = ev_document_render (document, rc);
 
-	return ev_document_render (document, rc);
+	ev_document_save_cached_thumbnail (document, suffix, width, height, surface);
+	g_free (suffix);
+
+	return surface;
 }
 
 
@@ -1069,14 +1904,19 @@ ev_document_is_page_size_uniform (EvDocument *document)
 {
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), TRUE);
 	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	gboolean           uniform;
 
 	if (!priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		ev_document_writer_lock (document);
+		ev_document_setup_cache (document, FALSE);
+		ev_document_writer_unlock (document);
 	}
 
-	return priv->uniform;
+	g_mutex_lock (&priv->cache_lock);
+	uniform = priv->uniform;
+	g_mutex_unlock (&priv->cache_lock);
+
+	return uniform;
 }
 
 void
@@ -1088,15 +1928,17 @@ ev_document_get_max_page_size (EvDocument *document,
 	EvDocumentPrivate *priv = GET_PRIVATE (document);
 
 	if (!priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		ev_document_writer_lock (document);
+		ev_document_setup_cache (document, FALSE);
+		ev_document_writer_unlock (document);
 	}
 
+	g_mutex_lock (&priv->cache_lock);
 	if (width)
 		*width = priv->max_width;
 	if (height)
 		*height = priv->max_height;
+	g_mutex_unlock (&priv->cache_lock);
 }
 
 void
@@ -1108,15 +1950,17 @@ ev_document_get_min_page_size (EvDocument *document,
 	EvDocumentPrivate *priv = GET_PRIVATE (document);
 
 	if (!priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		ev_document_writer_lock (document);
+		ev_document_setup_cache (document, FALSE);
+		ev_document_writer_unlock (document);
 	}
 
+	g_mutex_lock (&priv->cache_lock);
 	if (width)
 		*width = priv->min_width;
 	if (height)
 		*height = priv->min_height;
+	g_mutex_unlock (&priv->cache_lock);
 }
 
 gboolean
@@ -1124,14 +1968,19 @@ ev_document_check_dimensions (EvDocument *document)
 {
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	gboolean           valid;
 
 	if (!priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		ev_document_writer_lock (document);
+		ev_document_setup_cache (document, FALSE);
+		ev_document_writer_unlock (document);
 	}
 
-	return (priv->max_width > 0 && priv->max_height > 0);
+	g_mutex_lock (&priv->cache_lock);
+	valid = priv->max_width > 0 && priv->max_height > 0;
+	g_mutex_unlock (&priv->cache_lock);
+
+	return valid;
 }
 
 guint64
@@ -1148,14 +1997,87 @@ ev_document_get_max_label_len (EvDocument *document)
 {
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), -1);
 	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	gint               max_label;
 
 	if (!priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		ev_document_writer_lock (document);
+		ev_document_setup_cache (document, FALSE);
+		ev_document_writer_unlock (document);
 	}
 
-	return priv->max_label;
+	g_mutex_lock (&priv->cache_lock);
+	max_label = priv->max_label;
+	g_mutex_unlock (&priv->cache_lock);
+
+	return max_label;
+}
+
+/**
+ * ev_document_get_page_fingerprint:
+ * @document: an #EvDocument
+ * @page_index: index of page
+ *
+ * Returns: (transfer none) (nullable): a string identifying the contents
+ *   of the page when @document was loaded, or %NULL if the backend
+ *   doesn't provide fingerprints or @document wasn't loaded with
+ *   %EV_DOCUMENT_LOAD_FLAG_FINGERPRINTS
+ *
+ * Since: 49.0
+ */
+const gchar *
+ev_document_get_page_fingerprint (EvDocument *document,
+				  gint        page_index)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+	EvDocumentPrivate *priv = GET_PRIVATE (document);
+
+	if (!priv->page_fingerprints || page_index < 0 || page_index >= priv->n_pages)
+		return NULL;
+
+	return priv->page_fingerprints[page_index];
+}
+
+/**
+ * ev_document_page_is_unchanged:
+ * @document: an #EvDocument
+ * @previous: a former version of @document
+ * @page_index: index of page
+ *
+ * Checks whether the page at @page_index looks the same in @document and
+ * in @previous, usually the same file loaded before it was modified, so
+ * that anything rendered for it from @previous can be kept.
+ *
+ * Returns: %TRUE if the page has the same fingerprint and size in both
+ *   documents
+ *
+ * Since: 49.0
+ */
+gboolean
+ev_document_page_is_unchanged (EvDocument *document,
+			       EvDocument *previous,
+			       gint        page_index)
+{
+	const gchar *fingerprint;
+	gdouble      width, height;
+	gdouble      previous_width, previous_height;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+	g_return_val_if_fail (EV_IS_DOCUMENT (previous), FALSE);
+
+	if (G_OBJECT_TYPE (document) != G_OBJECT_TYPE (previous) ||
+	    !ev_document_get_uri (document) ||
+	    g_strcmp0 (ev_document_get_uri (document), ev_document_get_uri (previous)) != 0)
+		return FALSE;
+
+	fingerprint = ev_document_get_page_fingerprint (document, page_index);
+	if (!fingerprint ||
+	    g_strcmp0 (fingerprint, ev_document_get_page_fingerprint (previous, page_index)) != 0)
+		return FALSE;
+
+	ev_document_get_page_size (document, page_index, &width, &height);
+	ev_document_get_page_size (previous, page_index, &previous_width, &previous_height);
+
+	return width == previous_width && height == previous_height;
 }
 
 gboolean
@@ -1163,14 +2085,19 @@ ev_document_has_text_page_labels (EvDocument *document)
 {
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 	EvDocumentPrivate *priv = GET_PRIVATE (document);
+	gboolean           custom_page_labels;
 
 	if (!priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		ev_document_writer_lock (document);
+		ev_document_setup_cache (document, FALSE);
+		ev_document_writer_unlock (document);
 	}
 
-	return priv->page_labels != NULL;
+	g_mutex_lock (&priv->cache_lock);
+	custom_page_labels = priv->custom_page_labels;
+	g_mutex_unlock (&priv->cache_lock);
+
+	return custom_page_labels;
 }
 
 gboolean
@@ -1188,15 +2115,18 @@ ev_document_find_page_by_label (EvDocument  *document,
 	g_return_val_if_fail (page_index != NULL, FALSE);
 
 	if (!priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		ev_document_writer_lock (document);
+		ev_document_setup_cache (document, FALSE);
+		ev_document_writer_unlock (document);
 	}
 
+	g_mutex_lock (&priv->cache_lock);
+
         /* First, look for a literal label match */
 	for (i = 0; priv->page_labels && i < priv->n_pages; i ++) {
 		if (priv->page_labels[i] != NULL &&
 		    ! strcmp (page_label, priv->page_labels[i])) {
+			g_mutex_unlock (&priv->cache_lock);
 			*page_index = i;
 			return TRUE;
 		}
@@ -1206,11 +2136,14 @@ ev_document_find_page_by_label (EvDocument  *document,
 	for (i = 0; priv->page_labels && i < priv->n_pages; i++) {
 		if (priv->page_labels[i] != NULL &&
 		    ! strcasecmp (page_label, priv->page_labels[i])) {
+			g_mutex_unlock (&priv->cache_lock);
 			*page_index = i;
 			return TRUE;
 		}
 	}
 
+	g_mutex_unlock (&priv->cache_lock);
+
 	/* Next, parse the label, and see if the number fits */
 	value = strtol (page_label, &endptr, 10);
 	if (endptr[0] == '\0') {
@@ -47,7 +47,10 @@ G_DECLARE_DERIVABLE_TYPE (EvDocument, ev_document, EV, DOCUMENT, GObject)
 
 typedef enum /*< flags >*/ {
         EV_DOCUMENT_LOAD_FLAG_NONE = 0,
-        EV_DOCUMENT_LOAD_FLAG_NO_CACHE
+        EV_DOCUMENT_LOAD_FLAG_NO_CACHE,
+        EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE = 1 << 1,
+        EV_DOCUMENT_LOAD_FLAG_THUMBNAIL_CACHE = 1 << 2,
+        EV_DOCUMENT_LOAD_FLAG_FINGERPRINTS = 1 << 3
 } EvDocumentLoadFlags;
 
 typedef enum
@@ -121,6 +124,20 @@ struct _EvDocumentClass
 						     EvDocumentLoadFlags  flags,
 						     GCancellable        *cancellable,
 						     GError             **error);
+        /* A string identifying the contents of a page, so that the pages
+         * that didn't change can be told apart when the document is reloaded
+         */
+        gchar           * (* get_page_fingerprint)  (EvDocument          *document,
+						     EvPage              *page);
+
+        /* Whether the backend can be used by several readers at the same
+         * time. Backends setting it use the per-document lock instead of
+         * the global document mutex.
+         */
+        gboolean          concurrent_reads;
+
+        /* Whether render honors the clip area of the render context */
+        gboolean          clipped_render;
 };
 
 EV_PUBLIC
@@ -134,6 +151,20 @@ void             ev_document_doc_mutex_unlock     (void);
 EV_PUBLIC
 gboolean         ev_document_doc_mutex_trylock    (void);
 
+/* Per-document lock */
+EV_PUBLIC
+gboolean         ev_document_supports_concurrent_reads (EvDocument *document);
+EV_PUBLIC
+void             ev_document_reader_lock          (EvDocument      *document);
+EV_PUBLIC
+void             ev_document_reader_unlock        (EvDocument      *document);
+EV_PUBLIC
+gboolean         ev_document_reader_trylock       (EvDocument      *document);
+EV_PUBLIC
+void             ev_document_writer_lock          (EvDocument      *document);
+EV_PUBLIC
+void             ev_document_writer_unlock        (EvDocument      *document);
+
 /* FontConfig mutex */
 EV_PUBLIC
 void             ev_document_fc_mutex_lock        (void);
@@ -200,6 +231,8 @@ EV_PUBLIC
 cairo_surface_t *ev_document_render               (EvDocument      *document,
 						   EvRenderContext *rc);
 EV_PUBLIC
+gboolean         ev_document_supports_clipped_render (EvDocument   *document);
+EV_PUBLIC
 GdkPixbuf       *ev_document_get_thumbnail        (EvDocument      *document,
 						   EvRenderContext *rc);
 EV_PUBLIC
@@ -224,8 +257,21 @@ void             ev_document_get_min_page_size    (EvDocument      *document,
 EV_PUBLIC
 gboolean         ev_document_check_dimensions     (EvDocument      *document);
 EV_PUBLIC
+gboolean         ev_document_is_cache_complete    (EvDocument      *document);
+EV_PUBLIC
+gboolean         ev_document_fill_cache           (EvDocument      *document,
+						   gint             page,
+						   gint             n_pages);
+EV_PUBLIC
 gint             ev_document_get_max_label_len    (EvDocument      *document);
 EV_PUBLIC
+const gchar     *ev_document_get_page_fingerprint (EvDocument      *document,
+						   gint             page_index);
+EV_PUBLIC
+gboolean         ev_document_page_is_unchanged    (EvDocument      *document,
+						   EvDocument      *previous,
+						   gint             page_index);
+EV_PUBLIC
 gboolean         ev_document_has_text_page_labels (EvDocument      *document);
 EV_PUBLIC
 gboolean         ev_document_find_page_by_label   (EvDocument      *document,
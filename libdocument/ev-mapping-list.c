@@ -18,19 +18,43 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <math.h>
+
 #include "ev-mapping-list.h"
 
+/* Lists shorter than this are searched linearly */
+#define MAPPING_INDEX_MIN_LENGTH 32
+#define MAPPING_INDEX_MAX_CELLS  4096
+
 /**
  * SECTION: ev-mapping-list
  * @short_description: a refcounted list of #EvMappings.
  *
  * Since: 3.8
  */
+
+/* Uniform grid over the bounding box of the mappings, every mapping is
+ * in all the cells its area overlaps. The mappings of cell i are
+ * cell_mappings[cell_offsets[i]] to cell_mappings[cell_offsets[i + 1] - 1],
+ * in list order.
+ */
+typedef struct {
+	EvRectangle bounds;
+	guint       n_columns;
+	guint       n_rows;
+	gdouble     cell_width;
+	gdouble     cell_height;
+	guint      *cell_offsets;
+	EvMapping **cell_mappings;
+	GList      *last;
+} EvMappingIndex;
+
 struct _EvMappingList {
-	guint          page;
-	GList         *list;
-	GDestroyNotify data_destroy_func;
-	volatile gint  ref_count;
+	guint           page;
+	GList          *list;
+	GDestroyNotify  data_destroy_func;
+	volatile gint   ref_count;
+	EvMappingIndex *index;
 };
 
 G_DEFINE_BOXED_TYPE (EvMappingList, ev_mapping_list, ev_mapping_list_ref, ev_mapping_list_unref)
@@ -123,12 +147,163 @@ cmp_mapping_area_size (EvMapping *a,
 	return (wa * ha < wb * hb) ? -1 : 1;
 }
 
+static void
+mapping_index_free (EvMappingIndex *index)
+{
+	g_free (index->cell_offsets);
+	g_free (index->cell_mappings);
+	g_free (index);
+}
+
+static guint
+mapping_index_get_cell (gdouble value,
+			gdouble origin,
+			gdouble cell_size,
+			guint   n_cells)
+{
+	gdouble cell;
+
+	if (cell_size <= 0)
+		return 0;
+
+	cell = floor ((value - origin) / cell_size);
+
+	return (guint)CLAMP (cell, 0, n_cells - 1);
+}
+
+static EvMappingIndex *
+mapping_index_new (GList *list)
+{
+	EvMappingIndex *index;
+	GList          *l;
+	guint           n_mappings = 0;
+	guint           n_cells, i;
+	guint          *fill = NULL;
+
+	index = g_new0 (EvMappingIndex, 1);
+	index->bounds.x1 = index->bounds.y1 = G_MAXDOUBLE;
+	index->bounds.x2 = index->bounds.y2 = -G_MAXDOUBLE;
+
+	for (l = list; l; l = l->next) {
+		EvMapping *mapping = l->data;
+
+		index->bounds.x1 = MIN (index->bounds.x1, mapping->area.x1);
+		index->bounds.y1 = MIN (index->bounds.y1, mapping->area.y1);
+		index->bounds.x2 = MAX (index->bounds.x2, mapping->area.x2);
+		index->bounds.y2 = MAX (index->bounds.y2, mapping->area.y2);
+		index->last = l;
+		n_mappings++;
+	}
+
+	/* About one mapping per cell */
+	index->n_columns = CLAMP ((guint)ceil (sqrt (n_mappings)), 1, (guint)sqrt (MAPPING_INDEX_MAX_CELLS));
+	index->n_rows = index->n_columns;
+	index->cell_width = (index->bounds.x2 - index->bounds.x1) / index->n_columns;
+	index->cell_height = (index->bounds.y2 - index->bounds.y1) / index->n_rows;
+	n_cells = index->n_columns * index->n_rows;
+
+	/* Count the mappings of every cell, then fill them */
+	index->cell_offsets = g_new0 (guint, n_cells + 1);
+	for (i = 0; i < 2; i++) {
+		for (l = list; l; l = l->next) {
+			EvMapping *mapping = l->data;
+			guint      column1, column2, row1, row2;
+			guint      column, row;
+
+			column1 = mapping_index_get_cell (mapping->area.x1, index->bounds.x1,
+							  index->cell_width, index->n_columns);
+			column2 = mapping_index_get_cell (mapping->area.x2, index->bounds.x1,
+							  index->cell_width, index->n_columns);
+			row1 = mapping_index_get_cell (mapping->area.y1, index->bounds.y1,
+						       index->cell_height, index->n_rows);
+			row2 = mapping_index_get_cell (mapping->area.y2, index->bounds.y1,
+						       index->cell_height, index->n_rows);
+
+			for (row = row1; row <= row2; row++) {
+				for (column = column1; column <= column2; column++) {
+					guint cell = row * index->n_columns + column;
+
+					if (i == 0)
+						index->cell_offsets[cell + 1]++;
+					else
+						index->cell_mappings[fill[cell]++] = mapping;
+				}
+			}
+		}
+
+		if (i == 0) {
+			guint cell;
+
+			for (cell = 0; cell < n_cells; cell++)
+				index->cell_offsets[cell + 1] += index->cell_offsets[cell];
+			index->cell_mappings = g_new (EvMapping *, index->cell_offsets[n_cells]);
+			fill = g_memdup2 (index->cell_offsets, n_cells * sizeof (guint));
+		}
+	}
+	g_free (fill);
+
+	return index;
+}
+
+/* The index is built the first time the list is queried, and dropped
+ * when mappings are removed or appended to the list.
+ */
+static EvMappingIndex *
+ev_mapping_list_get_index (EvMappingList *mapping_list)
+{
+	EvMappingIndex *index = mapping_list->index;
+
+	if (index && index->last->next != NULL)
+		g_clear_pointer (&mapping_list->index, mapping_index_free);
+
+	if (!mapping_list->index) {
+		if (g_list_length (mapping_list->list) < MAPPING_INDEX_MIN_LENGTH)
+			return NULL;
+		mapping_list->index = mapping_index_new (mapping_list->list);
+	}
+
+	return mapping_list->index;
+}
+
+static EvMapping *
+mapping_index_get (EvMappingIndex *index,
+		   gdouble         x,
+		   gdouble         y)
+{
+	EvMapping *found = NULL;
+	guint      cell, i;
+
+	if (x < index->bounds.x1 || x > index->bounds.x2 ||
+	    y < index->bounds.y1 || y > index->bounds.y2)
+		return NULL;
+
+	cell = mapping_index_get_cell (y, index->bounds.y1, index->cell_height, index->n_rows) * index->n_columns +
+		mapping_index_get_cell (x, index->bounds.x1, index->cell_width, index->n_columns);
+
+	for (i = index->cell_offsets[cell]; i < index->cell_offsets[cell + 1]; i++) {
+		EvMapping *mapping = index->cell_mappings[i];
+
+		if ((x >= mapping->area.x1) &&
+		    (y >= mapping->area.y1) &&
+		    (x <= mapping->area.x2) &&
+		    (y <= mapping->area.y2)) {
+			if (found == NULL || cmp_mapping_area_size (mapping, found) < 0)
+				found = mapping;
+		}
+	}
+
+	return found;
+}
+
 /**
  * ev_mapping_list_get:
  * @mapping_list: an #EvMappingList
  * @x: X coordinate
  * @y: Y coordinate
  *
+ * Long lists are indexed the first time they are queried, the areas of
+ * the mappings are not expected to change after that.
+ *
  * Returns: (transfer none): the #EvMapping in the list at coordinates (x, y)
  *
  * Since: 3.12
@@ -138,11 +313,16 @@ ev_mapping_list_get (EvMappingList *mapping_list,
 		     gdouble        x,
 		     gdouble        y)
 {
+	EvMappingIndex *index;
 	GList *list;
 	EvMapping *found = NULL;
 
 	g_return_val_if_fail (mapping_list != NULL, NULL);
 
+	index = ev_mapping_list_get_index (mapping_list);
+	if (index)
+		return mapping_index_get (index, x, y);
+
 	for (list = mapping_list->list; list; list = list->next) {
 		EvMapping *mapping = list->data;
 
@@ -207,6 +387,7 @@ void
 ev_mapping_list_remove (EvMappingList *mapping_list,
 			EvMapping     *mapping)
 {
+	g_clear_pointer (&mapping_list->index, mapping_index_free);
 	mapping_list->list = g_list_remove (mapping_list->list, mapping);
         mapping_list->data_destroy_func (mapping->data);
         g_free (mapping);
@@ -248,6 +429,7 @@ ev_mapping_list_new (guint          page,
 	mapping_list->list = list;
 	mapping_list->data_destroy_func = data_destroy_func;
 	mapping_list->ref_count = 1;
+	mapping_list->index = NULL;
 
 	return mapping_list;
 }
@@ -282,6 +464,7 @@ ev_mapping_list_unref (EvMappingList *mapping_list)
 				(GFunc)mapping_list_free_foreach,
 				mapping_list->data_destroy_func);
 		g_list_free (mapping_list->list);
+		g_clear_pointer (&mapping_list->index, mapping_index_free);
 		g_slice_free (EvMappingList, mapping_list);
 	}
 }
@@ -0,0 +1,65 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#if !defined (EVINCE_COMPILATION)
+#error "Only <evince-document.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+#include "ev-macros.h"
+
+G_BEGIN_DECLS
+
+/* Pixel format conversions of a row of pixels. Pixels in guint32 are
+ * in the cairo format, with alpha in the most significant byte, and
+ * bytes are in the GdkPixbuf order, RGB or RGBA.
+ */
+
+/* Swaps the red and blue channels, like the libtiff ABGR to ARGB */
+EV_PRIVATE
+void ev_pixels_swap_red_blue  (guint32       *pixels,
+			       gsize          n_pixels);
+/* Inverts the colors, the result is opaque */
+EV_PRIVATE
+void ev_pixels_invert         (guint32       *pixels,
+			       gsize          n_pixels);
+/* RGBA to premultiplied ARGB */
+EV_PRIVATE
+void ev_pixels_premultiply    (const guint8  *src,
+			       guint32       *dest,
+			       gsize          n_pixels);
+/* Premultiplied ARGB to RGBA */
+EV_PRIVATE
+void ev_pixels_unpremultiply  (const guint32 *src,
+			       guint8        *dest,
+			       gsize          n_pixels);
+/* RGB to opaque ARGB */
+EV_PRIVATE
+void ev_pixels_from_rgb       (const guint8  *src,
+			       guint32       *dest,
+			       gsize          n_pixels);
+/* ARGB to RGB, alpha is ignored */
+EV_PRIVATE
+void ev_pixels_to_rgb         (const guint32 *src,
+			       guint8        *dest,
+			       gsize          n_pixels);
+
+G_END_DECLS
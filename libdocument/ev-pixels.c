@@ -0,0 +1,388 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "ev-pixels-private.h"
+
+/* SSE2 and NEON are part of the base instruction set of x86-64 and
+ * aarch64, so there's no need to check for them at runtime. AVX2 is
+ * checked at runtime, and when available it converts blocks of 8 pixels
+ * before the SSE2 code. The vector paths assume the little endian layout
+ * of cairo pixels in memory, B G R A, the scalar code is used for the
+ * remaining pixels.
+ */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#if defined (__SSE2__)
+#define HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined (__x86_64__) && (defined (__GNUC__) || defined (__clang__))
+#define HAVE_AVX2 1
+#include <immintrin.h>
+#define AVX2_FUNCTION __attribute__ ((target ("avx2")))
+#endif
+#elif defined (__ARM_NEON)
+#define HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+/* Same rounding as cairo and GdkPixbuf, c * a / 255 */
+static inline guint8
+mul_un8 (guint c,
+	 guint a)
+{
+	guint t = c * a + 128;
+
+	return (t + (t >> 8)) >> 8;
+}
+
+static inline guint32
+load_u32 (const void *p)
+{
+	guint32 v;
+
+	memcpy (&v, p, sizeof (v));
+
+	return v;
+}
+
+static inline guint32
+swap_red_blue (guint32 p)
+{
+	return (p & 0xff00ff00) | ((p & 0xff) << 16) | ((p >> 16) & 0xff);
+}
+
+#if defined (HAVE_AVX2)
+static gboolean
+have_avx2 (void)
+{
+	static gsize avx2 = 0;
+
+	if (g_once_init_enter (&avx2)) {
+		__builtin_cpu_init ();
+		g_once_init_leave (&avx2, __builtin_cpu_supports ("avx2") ? 2 : 1);
+	}
+
+	return avx2 == 2;
+}
+
+/* The AVX2 kernels return the number of pixels converted */
+
+AVX2_FUNCTION static inline __m256i
+swap_red_blue_avx2 (__m256i p)
+{
+	const __m256i shuffle = _mm256_setr_epi8 (2, 1, 0, 3, 6, 5, 4, 7,
+						  10, 9, 8, 11, 14, 13, 12, 15,
+						  2, 1, 0, 3, 6, 5, 4, 7,
+						  10, 9, 8, 11, 14, 13, 12, 15);
+
+	return _mm256_shuffle_epi8 (p, shuffle);
+}
+
+AVX2_FUNCTION static gsize
+ev_pixels_swap_red_blue_avx2 (guint32 *pixels,
+			      gsize    n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i + 8 <= n_pixels; i += 8) {
+		__m256i p = _mm256_loadu_si256 ((const __m256i *)(pixels + i));
+
+		_mm256_storeu_si256 ((__m256i *)(pixels + i), swap_red_blue_avx2 (p));
+	}
+
+	return i;
+}
+
+AVX2_FUNCTION static gsize
+ev_pixels_invert_avx2 (guint32 *pixels,
+		       gsize    n_pixels)
+{
+	const __m256i ones = _mm256_set1_epi32 (-1);
+	const __m256i alpha = _mm256_set1_epi32 (0xff000000);
+	gsize         i;
+
+	for (i = 0; i + 8 <= n_pixels; i += 8) {
+		__m256i p = _mm256_loadu_si256 ((const __m256i *)(pixels + i));
+
+		p = _mm256_or_si256 (_mm256_xor_si256 (p, ones), alpha);
+		_mm256_storeu_si256 ((__m256i *)(pixels + i), p);
+	}
+
+	return i;
+}
+
+/* Same as premultiply_epi16() for 4 pixels */
+AVX2_FUNCTION static inline __m256i
+premultiply_avx2 (__m256i p)
+{
+	const __m256i alpha_lanes = _mm256_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0,
+						      -1, 0, 0, 0, -1, 0, 0, 0);
+	const __m256i alpha_255 = _mm256_set_epi16 (255, 0, 0, 0, 255, 0, 0, 0,
+						    255, 0, 0, 0, 255, 0, 0, 0);
+	const __m256i round = _mm256_set1_epi16 (128);
+	__m256i       a;
+
+	a = _mm256_shufflelo_epi16 (p, _MM_SHUFFLE (3, 3, 3, 3));
+	a = _mm256_shufflehi_epi16 (a, _MM_SHUFFLE (3, 3, 3, 3));
+	a = _mm256_or_si256 (_mm256_andnot_si256 (alpha_lanes, a), alpha_255);
+
+	p = _mm256_add_epi16 (_mm256_mullo_epi16 (p, a), round);
+
+	return _mm256_srli_epi16 (_mm256_add_epi16 (p, _mm256_srli_epi16 (p, 8)), 8);
+}
+
+AVX2_FUNCTION static gsize
+ev_pixels_premultiply_avx2 (const guint8 *src,
+			    guint32      *dest,
+			    gsize         n_pixels)
+{
+	const __m256i zero = _mm256_setzero_si256 ();
+	gsize         i;
+
+	for (i = 0; i + 8 <= n_pixels; i += 8) {
+		__m256i p = _mm256_loadu_si256 ((const __m256i *)(src + i * 4));
+
+		/* R G B A to B G R A, unpacking and packing stay in the
+		 * 128 bits lanes so the pixel order is kept */
+		p = swap_red_blue_avx2 (p);
+		p = _mm256_packus_epi16 (premultiply_avx2 (_mm256_unpacklo_epi8 (p, zero)),
+					 premultiply_avx2 (_mm256_unpackhi_epi8 (p, zero)));
+		_mm256_storeu_si256 ((__m256i *)(dest + i), p);
+	}
+
+	return i;
+}
+#endif
+
+void
+ev_pixels_swap_red_blue (guint32 *pixels,
+			 gsize    n_pixels)
+{
+	gsize i = 0;
+
+#if defined (HAVE_AVX2)
+	if (have_avx2 ())
+		i = ev_pixels_swap_red_blue_avx2 (pixels, n_pixels);
+#endif
+#if defined (HAVE_SSE2)
+	const __m128i ga_mask = _mm_set1_epi32 (0xff00ff00);
+	const __m128i b_mask = _mm_set1_epi32 (0x000000ff);
+
+	for (; i + 4 <= n_pixels; i += 4) {
+		__m128i p = _mm_loadu_si128 ((const __m128i *)(pixels + i));
+		__m128i r;
+
+		r = _mm_and_si128 (p, ga_mask);
+		r = _mm_or_si128 (r, _mm_slli_epi32 (_mm_and_si128 (p, b_mask), 16));
+		r = _mm_or_si128 (r, _mm_and_si128 (_mm_srli_epi32 (p, 16), b_mask));
+		_mm_storeu_si128 ((__m128i *)(pixels + i), r);
+	}
+#elif defined (HAVE_NEON)
+	for (; i + 16 <= n_pixels; i += 16) {
+		uint8x16x4_t p = vld4q_u8 ((const uint8_t *)(pixels + i));
+		uint8x16_t   t = p.val[0];
+
+		p.val[0] = p.val[2];
+		p.val[2] = t;
+		vst4q_u8 ((uint8_t *)(pixels + i), p);
+	}
+#endif
+	for (; i < n_pixels; i++)
+		pixels[i] = swap_red_blue (pixels[i]);
+}
+
+void
+ev_pixels_invert (guint32 *pixels,
+		  gsize    n_pixels)
+{
+	gsize i = 0;
+
+#if defined (HAVE_AVX2)
+	if (have_avx2 ())
+		i = ev_pixels_invert_avx2 (pixels, n_pixels);
+#endif
+#if defined (HAVE_SSE2)
+	const __m128i ones = _mm_set1_epi32 (-1);
+	const __m128i alpha = _mm_set1_epi32 (0xff000000);
+
+	for (; i + 4 <= n_pixels; i += 4) {
+		__m128i p = _mm_loadu_si128 ((const __m128i *)(pixels + i));
+
+		p = _mm_or_si128 (_mm_xor_si128 (p, ones), alpha);
+		_mm_storeu_si128 ((__m128i *)(pixels + i), p);
+	}
+#elif defined (HAVE_NEON)
+	const uint32x4_t alpha = vdupq_n_u32 (0xff000000);
+
+	for (; i + 4 <= n_pixels; i += 4) {
+		uint32x4_t p = vld1q_u32 (pixels + i);
+
+		vst1q_u32 (pixels + i, vorrq_u32 (vmvnq_u32 (p), alpha));
+	}
+#endif
+	for (; i < n_pixels; i++)
+		pixels[i] = ~pixels[i] | 0xff000000;
+}
+
+#if defined (HAVE_SSE2)
+/* Premultiplies 2 pixels unpacked to 16 bits, B G R A */
+static inline __m128i
+premultiply_epi16 (__m128i p)
+{
+	const __m128i alpha_lanes = _mm_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0);
+	const __m128i alpha_255 = _mm_set_epi16 (255, 0, 0, 0, 255, 0, 0, 0);
+	const __m128i round = _mm_set1_epi16 (128);
+	__m128i       a;
+
+	a = _mm_shufflelo_epi16 (p, _MM_SHUFFLE (3, 3, 3, 3));
+	a = _mm_shufflehi_epi16 (a, _MM_SHUFFLE (3, 3, 3, 3));
+	/* Keep alpha itself, a * 255 / 255 */
+	a = _mm_or_si128 (_mm_andnot_si128 (alpha_lanes, a), alpha_255);
+
+	p = _mm_add_epi16 (_mm_mullo_epi16 (p, a), round);
+
+	return _mm_srli_epi16 (_mm_add_epi16 (p, _mm_srli_epi16 (p, 8)), 8);
+}
+#endif
+
+void
+ev_pixels_premultiply (const guint8 *src,
+		       guint32      *dest,
+		       gsize         n_pixels)
+{
+	gsize i = 0;
+
+#if defined (HAVE_AVX2)
+	if (have_avx2 ())
+		i = ev_pixels_premultiply_avx2 (src, dest, n_pixels);
+#endif
+#if defined (HAVE_SSE2)
+	const __m128i ga_mask = _mm_set1_epi32 (0xff00ff00);
+	const __m128i b_mask = _mm_set1_epi32 (0x000000ff);
+	const __m128i zero = _mm_setzero_si128 ();
+
+	for (; i + 4 <= n_pixels; i += 4) {
+		__m128i p = _mm_loadu_si128 ((const __m128i *)(src + i * 4));
+		__m128i r;
+
+		/* R G B A to B G R A */
+		r = _mm_and_si128 (p, ga_mask);
+		r = _mm_or_si128 (r, _mm_slli_epi32 (_mm_and_si128 (p, b_mask), 16));
+		r = _mm_or_si128 (r, _mm_and_si128 (_mm_srli_epi32 (p, 16), b_mask));
+
+		r = _mm_packus_epi16 (premultiply_epi16 (_mm_unpacklo_epi8 (r, zero)),
+				      premultiply_epi16 (_mm_unpackhi_epi8 (r, zero)));
+		_mm_storeu_si128 ((__m128i *)(dest + i), r);
+	}
+#endif
+	for (; i < n_pixels; i++) {
+		const guint8 *p = src + i * 4;
+		guint         a = p[3];
+
+		dest[i] = (a << 24) |
+			(mul_un8 (p[0], a) << 16) |
+			(mul_un8 (p[1], a) << 8) |
+			mul_un8 (p[2], a);
+	}
+}
+
+/* Unpremultiplied values of every color for every alpha, c * 255 / a,
+ * so that unpremultiplying doesn't need any division */
+static const guint8 *
+get_unpremultiply_table (void)
+{
+	static gsize table = 0;
+
+	if (g_once_init_enter (&table)) {
+		guint8 *t = g_malloc (256 * 256);
+		guint   a, c;
+
+		for (c = 0; c < 256; c++)
+			t[c] = 0;
+		for (a = 1; a < 256; a++) {
+			for (c = 0; c < 256; c++)
+				t[a * 256 + c] = MIN ((c * 255 + a / 2) / a, 255);
+		}
+
+		g_once_init_leave (&table, (gsize)t);
+	}
+
+	return (const guint8 *)table;
+}
+
+void
+ev_pixels_unpremultiply (const guint32 *src,
+			 guint8        *dest,
+			 gsize          n_pixels)
+{
+	const guint8 *table = get_unpremultiply_table ();
+	gsize         i;
+
+	for (i = 0; i < n_pixels; i++) {
+		guint32       p = src[i];
+		guint8       *d = dest + i * 4;
+		guint         a = p >> 24;
+		const guint8 *t = table + a * 256;
+
+		d[0] = t[(p >> 16) & 0xff];
+		d[1] = t[(p >> 8) & 0xff];
+		d[2] = t[p & 0xff];
+		d[3] = a;
+	}
+}
+
+void
+ev_pixels_from_rgb (const guint8 *src,
+		    guint32      *dest,
+		    gsize         n_pixels)
+{
+	gsize i = 0;
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	/* Read whole words while there's a byte to spare after the pixel */
+	for (; i + 1 < n_pixels; i++)
+		dest[i] = swap_red_blue (load_u32 (src + i * 3)) | 0xff000000;
+#endif
+
+	for (; i < n_pixels; i++) {
+		const guint8 *p = src + i * 3;
+
+		dest[i] = 0xff000000 | (p[0] << 16) | (p[1] << 8) | p[2];
+	}
+}
+
+void
+ev_pixels_to_rgb (const guint32 *src,
+		  guint8        *dest,
+		  gsize          n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i < n_pixels; i++) {
+		guint32 p = src[i];
+		guint8 *d = dest + i * 3;
+
+		d[0] = (p >> 16) & 0xff;
+		d[1] = (p >> 8) & 0xff;
+		d[2] = p & 0xff;
+	}
+}
@@ -110,6 +110,49 @@ ev_render_context_set_target_size (EvRenderContext *rc,
 	rc->target_height = target_height;
 }
 
+/**
+ * ev_render_context_set_clip:
+ * @rc: an #EvRenderContext
+ * @clip: (nullable): the area to render, or %NULL to render the whole page
+ *
+ * Restricts rendering to @clip, given in pixels of the page once scaled
+ * and rotated. The rendered surface then has the size of @clip, and its
+ * origin is the top left corner of @clip.
+ *
+ * Since: 49.0
+ */
+void
+ev_render_context_set_clip (EvRenderContext             *rc,
+			    const cairo_rectangle_int_t *clip)
+{
+	g_return_if_fail (rc != NULL);
+
+	rc->has_clip = clip != NULL;
+	if (clip)
+		rc->clip = *clip;
+}
+
+/**
+ * ev_render_context_get_clip:
+ * @rc: an #EvRenderContext
+ * @clip: (out) (optional): return location for the clip area
+ *
+ * Returns: %TRUE if rendering is restricted to a clip area
+ *
+ * Since: 49.0
+ */
+gboolean
+ev_render_context_get_clip (EvRenderContext       *rc,
+			    cairo_rectangle_int_t *clip)
+{
+	g_return_val_if_fail (rc != NULL, FALSE);
+
+	if (rc->has_clip && clip)
+		*clip = rc->clip;
+
+	return rc->has_clip;
+}
+
 void
 ev_render_context_compute_scaled_size (EvRenderContext *rc,
 				       double		width_points,
@@ -24,6 +24,7 @@
 #endif
 
 #include <glib-object.h>
+#include <cairo.h>
 
 #include "ev-macros.h"
 #include "ev-page.h"
@@ -44,6 +45,10 @@ struct _EvRenderContext
 	gdouble scale;
 	gint	target_width;
 	gint	target_height;
+
+	/* Area of the transformed page to render, in pixels */
+	gboolean              has_clip;
+	cairo_rectangle_int_t clip;
 };
 
 
@@ -65,6 +70,12 @@ void             ev_render_context_set_target_size (EvRenderContext *rc,
                                                     int              target_width,
                                                     int              target_height);
 EV_PUBLIC
+void             ev_render_context_set_clip        (EvRenderContext             *rc,
+                                                    const cairo_rectangle_int_t *clip);
+EV_PUBLIC
+gboolean         ev_render_context_get_clip        (EvRenderContext             *rc,
+                                                    cairo_rectangle_int_t       *clip);
+EV_PUBLIC
 void             ev_render_context_compute_scaled_size      (EvRenderContext *rc,
                                                              double           width_points,
                                                              double           height_points,
@@ -0,0 +1,76 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#if !defined (EVINCE_COMPILATION)
+#error "Only <evince-document.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+#include "ev-macros.h"
+#include "ev-document.h"
+#include "ev-document-find.h"
+
+G_BEGIN_DECLS
+
+/* Index of the text of every page of a document, used to skip the pages
+ * that can't match a search, together with the hits of the last searches
+ * so that repeating them doesn't need the backend. Pages are added while
+ * they are searched, and the index is saved next to the document cache
+ * once all of them have been added. All the functions are thread safe.
+ */
+typedef struct _EvTextIndex EvTextIndex;
+
+EV_PRIVATE
+EvTextIndex *ev_text_index_new            (const gchar *key,
+					   gint         n_pages);
+EV_PRIVATE
+void         ev_text_index_free           (EvTextIndex *index);
+EV_PRIVATE
+gboolean     ev_text_index_has_page       (EvTextIndex *index,
+					   gint         page);
+EV_PRIVATE
+void         ev_text_index_add_page       (EvTextIndex *index,
+					   gint         page,
+					   const gchar *text);
+EV_PRIVATE
+GArray      *ev_text_index_query_new      (const gchar *text);
+EV_PRIVATE
+gboolean     ev_text_index_page_may_match (EvTextIndex *index,
+					   gint         page,
+					   GArray      *query);
+EV_PRIVATE
+gboolean     ev_text_index_get_hits       (EvTextIndex   *index,
+					   const gchar   *text,
+					   EvFindOptions  options,
+					   gint           page,
+					   GList        **matches);
+EV_PRIVATE
+void         ev_text_index_add_hits       (EvTextIndex   *index,
+					   const gchar   *text,
+					   EvFindOptions  options,
+					   gint           page,
+					   GList         *matches);
+
+/* EvDocument */
+EV_PRIVATE
+EvTextIndex *ev_document_get_text_index   (EvDocument  *document);
+
+G_END_DECLS
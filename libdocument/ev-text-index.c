@@ -0,0 +1,678 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "ev-document-cache-private.h"
+#include "ev-text-index-private.h"
+
+/* (version, key, filters, [(text, options, [(page, [(x1, y1, x2, y2, flags)])])]) */
+#define TEXT_INDEX_SUFFIX  ".index"
+#define TEXT_INDEX_VERSION 2
+#define TEXT_INDEX_HITS    "a(ua(ddddy))"
+#define TEXT_INDEX_FORMAT  "(usaaya(su" TEXT_INDEX_HITS "))"
+
+/* Number of searches whose hits are kept */
+#define MAX_QUERIES 16
+
+enum {
+	HIT_NEXT_LINE    = 1 << 0,
+	HIT_AFTER_HYPHEN = 1 << 1
+};
+
+typedef struct {
+	gdouble x1, y1, x2, y2;
+	guint8  flags;
+} TextIndexHit;
+
+/* Hits of a search on every page, a page without hits has no array */
+typedef struct {
+	gchar         *text;
+	EvFindOptions  options;
+	guint64        last_used;
+	gint           n_pages;
+	gint           n_searched;
+	guint8        *searched;
+	GArray       **pages;
+} TextIndexQuery;
+
+/* Size in bytes of the filter of a page, about 4 bits per trigram */
+#define MIN_FILTER_SIZE 32
+#define MAX_FILTER_SIZE 8192
+
+/* Every page is indexed with a bloom filter of the trigrams of its text.
+ * The text is normalized so that the filter never rejects a page the
+ * backend would find a match in, whatever the find options: it's
+ * decomposed, lowercased and only letters and digits are kept, since
+ * matches can span lines and hyphenated words.
+ */
+struct _EvTextIndex {
+	GMutex         mutex;
+	gchar         *key;
+	gint           n_pages;
+	gint           n_indexed;
+	guint8        *indexed;
+
+	/* A page without a filter may match anything */
+	const guint8 **filters;
+	gsize         *sizes;
+
+	/* Filters of an index loaded from disk point into these */
+	GPtrArray     *file_filters;
+
+	/* Hits of the last searches, so that repeating one doesn't
+	 * need the backend at all */
+	GPtrArray     *queries;
+	guint64        n_uses;
+};
+
+static TextIndexQuery *
+text_index_query_new (const gchar   *text,
+		      EvFindOptions  options,
+		      gint           n_pages)
+{
+	TextIndexQuery *query;
+
+	query = g_new0 (TextIndexQuery, 1);
+	query->text = g_strdup (text);
+	query->options = options;
+	query->n_pages = n_pages;
+	query->searched = g_new0 (guint8, n_pages);
+	query->pages = g_new0 (GArray *, n_pages);
+
+	return query;
+}
+
+static void
+text_index_query_free (TextIndexQuery *query)
+{
+	gint i;
+
+	for (i = 0; i < query->n_pages; i++)
+		g_clear_pointer (&query->pages[i], g_array_unref);
+	g_free (query->pages);
+	g_free (query->searched);
+	g_free (query->text);
+	g_free (query);
+}
+
+static gunichar *
+ev_text_index_normalize (const gchar *text,
+			 glong       *n_chars)
+{
+	gchar       *normalized;
+	gunichar    *chars;
+	const gchar *p;
+	glong        n = 0;
+
+	if (!text)
+		return NULL;
+
+	normalized = g_utf8_normalize (text, -1, G_NORMALIZE_ALL);
+	if (!normalized)
+		return NULL;
+
+	chars = g_new (gunichar, g_utf8_strlen (normalized, -1) + 1);
+	for (p = normalized; *p; p = g_utf8_next_char (p)) {
+		gunichar c = g_utf8_get_char (p);
+
+		if (g_unichar_ismark (c) || !g_unichar_isalnum (c))
+			continue;
+		chars[n++] = g_unichar_tolower (c);
+	}
+	g_free (normalized);
+
+	*n_chars = n;
+
+	return chars;
+}
+
+static guint32
+trigram_hash (const gunichar *chars)
+{
+	guint32 h;
+
+	h = (chars[0] * 0x01000193) ^ chars[1];
+	h = (h * 0x01000193) ^ chars[2];
+
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return h;
+}
+
+static inline void
+filter_add (guint8  *filter,
+	    guint32  mask,
+	    guint32  hash)
+{
+	guint32 bit1 = hash & mask;
+	guint32 bit2 = ((hash >> 16) | (hash << 16)) & mask;
+
+	filter[bit1 >> 3] |= 1 << (bit1 & 7);
+	filter[bit2 >> 3] |= 1 << (bit2 & 7);
+}
+
+static inline gboolean
+filter_contains (const guint8 *filter,
+		 guint32       mask,
+		 guint32       hash)
+{
+	guint32 bit1 = hash & mask;
+	guint32 bit2 = ((hash >> 16) | (hash << 16)) & mask;
+
+	return (filter[bit1 >> 3] & (1 << (bit1 & 7))) &&
+		(filter[bit2 >> 3] & (1 << (bit2 & 7)));
+}
+
+static TextIndexQuery *
+ev_text_index_lookup_query (EvTextIndex   *index,
+			    const gchar   *text,
+			    EvFindOptions  options)
+{
+	guint i;
+
+	for (i = 0; i < index->queries->len; i++) {
+		TextIndexQuery *query = g_ptr_array_index (index->queries, i);
+
+		if (query->options == options && strcmp (query->text, text) == 0)
+			return query;
+	}
+
+	return NULL;
+}
+
+static void
+ev_text_index_load_query (EvTextIndex *index,
+			  GVariant    *value)
+{
+	TextIndexQuery *query;
+	GVariant       *pages;
+	GVariant       *page_hits;
+	GVariantIter    iter;
+	const gchar    *text;
+	guint32         options;
+	guint32         page;
+
+	g_variant_get (value, "(&su@" TEXT_INDEX_HITS ")", &text, &options, &pages);
+	if (index->queries->len == MAX_QUERIES ||
+	    ev_text_index_lookup_query (index, text, options)) {
+		g_variant_unref (pages);
+		return;
+	}
+
+	query = text_index_query_new (text, options, index->n_pages);
+	g_variant_iter_init (&iter, pages);
+	while (g_variant_iter_next (&iter, "(u@a(ddddy))", &page, &page_hits)) {
+		if (page < (guint32)index->n_pages && !query->pages[page]) {
+			GVariantIter hits_iter;
+			TextIndexHit hit;
+
+			query->pages[page] = g_array_new (FALSE, FALSE, sizeof (TextIndexHit));
+			g_variant_iter_init (&hits_iter, page_hits);
+			while (g_variant_iter_next (&hits_iter, "(ddddy)",
+						    &hit.x1, &hit.y1, &hit.x2, &hit.y2,
+						    &hit.flags))
+				g_array_append_val (query->pages[page], hit);
+		}
+		g_variant_unref (page_hits);
+	}
+	g_variant_unref (pages);
+
+	/* Only searches done on every page are saved */
+	memset (query->searched, TRUE, index->n_pages);
+	query->n_searched = index->n_pages;
+	g_ptr_array_add (index->queries, query);
+}
+
+static gboolean
+ev_text_index_load (EvTextIndex *index)
+{
+	GVariant    *file;
+	GVariant    *filters;
+	GVariant    *queries;
+	GVariant    *query;
+	GVariantIter iter;
+	gint         i;
+
+	file = ev_document_cache_load (index->key, TEXT_INDEX_SUFFIX,
+				       TEXT_INDEX_FORMAT, TEXT_INDEX_VERSION);
+	if (!file)
+		return FALSE;
+
+	filters = g_variant_get_child_value (file, 2);
+	queries = g_variant_get_child_value (file, 3);
+	g_variant_unref (file);
+
+	if (g_variant_n_children (filters) != (gsize)index->n_pages) {
+		g_variant_unref (queries);
+		g_variant_unref (filters);
+		return FALSE;
+	}
+
+	index->file_filters = g_ptr_array_new_full (index->n_pages,
+						    (GDestroyNotify)g_variant_unref);
+	for (i = 0; i < index->n_pages; i++) {
+		GVariant     *filter = g_variant_get_child_value (filters, i);
+		const guint8 *bits;
+		gsize         size;
+
+		bits = g_variant_get_fixed_array (filter, &size, sizeof (guint8));
+		if (size & (size - 1))
+			size = 0;
+
+		index->filters[i] = size > 0 ? bits : NULL;
+		index->sizes[i] = size;
+		index->indexed[i] = TRUE;
+		g_ptr_array_add (index->file_filters, filter);
+	}
+	index->n_indexed = index->n_pages;
+
+	g_variant_iter_init (&iter, queries);
+	while ((query = g_variant_iter_next_value (&iter))) {
+		ev_text_index_load_query (index, query);
+		g_variant_unref (query);
+	}
+
+	g_variant_unref (queries);
+	g_variant_unref (filters);
+
+	return TRUE;
+}
+
+/* Must be called with the index mutex held */
+static void
+ev_text_index_save (EvTextIndex *index)
+{
+	GVariantBuilder builder;
+	GVariant       *file;
+	gint            i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE (TEXT_INDEX_FORMAT));
+	g_variant_builder_add (&builder, "u", TEXT_INDEX_VERSION);
+	g_variant_builder_add (&builder, "s", index->key);
+
+	g_variant_builder_open (&builder, G_VARIANT_TYPE ("aay"));
+	for (i = 0; i < index->n_pages; i++) {
+		g_variant_builder_add_value (&builder,
+					     g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+									index->filters[i],
+									index->sizes[i],
+									sizeof (guint8)));
+	}
+	g_variant_builder_close (&builder);
+
+	g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(su" TEXT_INDEX_HITS ")"));
+	for (i = 0; i < (gint)index->queries->len; i++) {
+		TextIndexQuery *query = g_ptr_array_index (index->queries, i);
+		gint            page;
+
+		if (query->n_searched < index->n_pages)
+			continue;
+
+		g_variant_builder_open (&builder, G_VARIANT_TYPE ("(su" TEXT_INDEX_HITS ")"));
+		g_variant_builder_add (&builder, "s", query->text);
+		g_variant_builder_add (&builder, "u", query->options);
+		g_variant_builder_open (&builder, G_VARIANT_TYPE (TEXT_INDEX_HITS));
+		for (page = 0; page < index->n_pages; page++) {
+			GArray *hits = query->pages[page];
+			guint   j;
+
+			if (!hits || hits->len == 0)
+				continue;
+
+			g_variant_builder_open (&builder, G_VARIANT_TYPE ("(ua(ddddy))"));
+			g_variant_builder_add (&builder, "u", page);
+			g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(ddddy)"));
+			for (j = 0; j < hits->len; j++) {
+				TextIndexHit *hit = &g_array_index (hits, TextIndexHit, j);
+
+				g_variant_builder_add (&builder, "(ddddy)",
+						       hit->x1, hit->y1, hit->x2, hit->y2,
+						       hit->flags);
+			}
+			g_variant_builder_close (&builder);
+			g_variant_builder_close (&builder);
+		}
+		g_variant_builder_close (&builder);
+		g_variant_builder_close (&builder);
+	}
+	g_variant_builder_close (&builder);
+
+	file = g_variant_ref_sink (g_variant_builder_end (&builder));
+	ev_document_cache_save (index->key, TEXT_INDEX_SUFFIX, file);
+	g_variant_unref (file);
+}
+
+/*
+ * ev_text_index_new:
+ * @key: the key of the document in the on-disk cache
+ * @n_pages: the number of pages of the document
+ *
+ * Returns: a new #EvTextIndex, with all the pages already indexed if
+ *   there's a valid index for @key on disk
+ */
+EvTextIndex *
+ev_text_index_new (const gchar *key,
+		   gint         n_pages)
+{
+	EvTextIndex *index;
+
+	index = g_new0 (EvTextIndex, 1);
+	g_mutex_init (&index->mutex);
+	index->key = g_strdup (key);
+	index->n_pages = n_pages;
+	index->indexed = g_new0 (guint8, n_pages);
+	index->filters = g_new0 (const guint8 *, n_pages);
+	index->sizes = g_new0 (gsize, n_pages);
+	index->queries = g_ptr_array_new_with_free_func ((GDestroyNotify)text_index_query_free);
+
+	ev_text_index_load (index);
+
+	return index;
+}
+
+void
+ev_text_index_free (EvTextIndex *index)
+{
+	if (!index)
+		return;
+
+	if (index->file_filters) {
+		g_ptr_array_free (index->file_filters, TRUE);
+	} else {
+		gint i;
+
+		for (i = 0; i < index->n_pages; i++)
+			g_free ((guint8 *)index->filters[i]);
+	}
+
+	g_ptr_array_free (index->queries, TRUE);
+	g_free (index->filters);
+	g_free (index->sizes);
+	g_free (index->indexed);
+	g_free (index->key);
+	g_mutex_clear (&index->mutex);
+	g_free (index);
+}
+
+gboolean
+ev_text_index_has_page (EvTextIndex *index,
+			gint         page)
+{
+	gboolean retval;
+
+	g_return_val_if_fail (page >= 0 && page < index->n_pages, FALSE);
+
+	g_mutex_lock (&index->mutex);
+	retval = index->indexed[page];
+	g_mutex_unlock (&index->mutex);
+
+	return retval;
+}
+
+/*
+ * ev_text_index_add_page:
+ * @index: an #EvTextIndex
+ * @page: the page index
+ * @text: (nullable): the text of @page, see ev_document_text_get_text()
+ *
+ * Adds @page to @index. A page without text, or with invalid text, may
+ * match anything. The index is saved once all the pages are added.
+ */
+void
+ev_text_index_add_page (EvTextIndex *index,
+			gint         page,
+			const gchar *text)
+{
+	gunichar *chars;
+	glong     n_chars = 0;
+	guint8   *filter = NULL;
+	gsize     size = 0;
+
+	g_return_if_fail (page >= 0 && page < index->n_pages);
+
+	chars = ev_text_index_normalize (text, &n_chars);
+	if (chars) {
+		glong   i;
+		guint32 mask;
+
+		size = MIN_FILTER_SIZE;
+		while (size < MAX_FILTER_SIZE && size * 2 < (gsize)n_chars)
+			size *= 2;
+		mask = size * 8 - 1;
+
+		filter = g_malloc0 (size);
+		for (i = 0; i + 2 < n_chars; i++)
+			filter_add (filter, mask, trigram_hash (chars + i));
+
+		g_free (chars);
+	}
+
+	g_mutex_lock (&index->mutex);
+	if (!index->indexed[page]) {
+		index->filters[page] = filter;
+		index->sizes[page] = size;
+		index->indexed[page] = TRUE;
+		filter = NULL;
+
+		if (++index->n_indexed == index->n_pages)
+			ev_text_index_save (index);
+	}
+	g_mutex_unlock (&index->mutex);
+
+	g_free (filter);
+}
+
+/*
+ * ev_text_index_query_new:
+ * @text: the text to search for
+ *
+ * Returns: (nullable): the trigrams of @text to be used with
+ *   ev_text_index_page_may_match(), or %NULL if @text is too short
+ *   to filter pages
+ */
+GArray *
+ev_text_index_query_new (const gchar *text)
+{
+	gunichar *chars;
+	glong     n_chars = 0;
+	glong     i;
+	GArray   *query;
+
+	chars = ev_text_index_normalize (text, &n_chars);
+	if (!chars || n_chars < 3) {
+		g_free (chars);
+		return NULL;
+	}
+
+	query = g_array_sized_new (FALSE, FALSE, sizeof (guint32), n_chars - 2);
+	for (i = 0; i + 2 < n_chars; i++) {
+		guint32 hash = trigram_hash (chars + i);
+
+		g_array_append_val (query, hash);
+	}
+	g_free (chars);
+
+	return query;
+}
+
+/*
+ * ev_text_index_page_may_match:
+ * @index: an #EvTextIndex
+ * @page: the page index
+ * @query: (nullable): a query returned by ev_text_index_query_new()
+ *
+ * Returns: %FALSE if @page is indexed and can't contain the text of
+ *   @query
+ */
+gboolean
+ev_text_index_page_may_match (EvTextIndex *index,
+			      gint         page,
+			      GArray      *query)
+{
+	gboolean retval = TRUE;
+	guint    i;
+
+	g_return_val_if_fail (page >= 0 && page < index->n_pages, TRUE);
+
+	if (!query)
+		return TRUE;
+
+	g_mutex_lock (&index->mutex);
+	if (index->indexed[page] && index->sizes[page] > 0) {
+		const guint8 *filter = index->filters[page];
+		guint32       mask = index->sizes[page] * 8 - 1;
+
+		for (i = 0; i < query->len && retval; i++)
+			retval = filter_contains (filter, mask,
+						  g_array_index (query, guint32, i));
+	}
+	g_mutex_unlock (&index->mutex);
+
+	return retval;
+}
+
+/*
+ * ev_text_index_get_hits:
+ * @index: an #EvTextIndex
+ * @text: the text to search for
+ * @options: the find options
+ * @page: the page index
+ * @matches: (out) (transfer full) (element-type EvFindRectangle): return
+ *   location for the matches of @text in @page
+ *
+ * Returns: %TRUE if a previous search of @text with @options already
+ *   searched @page, and @matches is filled in with what it found
+ */
+gboolean
+ev_text_index_get_hits (EvTextIndex   *index,
+			const gchar   *text,
+			EvFindOptions  options,
+			gint           page,
+			GList        **matches)
+{
+	TextIndexQuery *query;
+	gboolean        retval = FALSE;
+
+	g_return_val_if_fail (page >= 0 && page < index->n_pages, FALSE);
+
+	*matches = NULL;
+
+	g_mutex_lock (&index->mutex);
+	query = ev_text_index_lookup_query (index, text, options);
+	if (query && query->searched[page]) {
+		GArray *hits = query->pages[page];
+		guint   i;
+
+		for (i = hits ? hits->len : 0; i > 0; i--) {
+			TextIndexHit    *hit = &g_array_index (hits, TextIndexHit, i - 1);
+			EvFindRectangle *match = ev_find_rectangle_new ();
+
+			match->x1 = hit->x1;
+			match->y1 = hit->y1;
+			match->x2 = hit->x2;
+			match->y2 = hit->y2;
+			match->next_line = (hit->flags & HIT_NEXT_LINE) != 0;
+			match->after_hyphen = (hit->flags & HIT_AFTER_HYPHEN) != 0;
+			*matches = g_list_prepend (*matches, match);
+		}
+
+		query->last_used = ++index->n_uses;
+		retval = TRUE;
+	}
+	g_mutex_unlock (&index->mutex);
+
+	return retval;
+}
+
+/*
+ * ev_text_index_add_hits:
+ * @index: an #EvTextIndex
+ * @text: the text searched for
+ * @options: the find options
+ * @page: the page index
+ * @matches: (element-type EvFindRectangle): the matches of @text in @page
+ *
+ * Stores the matches of a search in @page, so that the same search can
+ * be answered with ev_text_index_get_hits(). Only the last searches are
+ * kept, and they are saved with the index once every page is searched.
+ */
+void
+ev_text_index_add_hits (EvTextIndex   *index,
+			const gchar   *text,
+			EvFindOptions  options,
+			gint           page,
+			GList         *matches)
+{
+	TextIndexQuery *query;
+	GList          *l;
+
+	g_return_if_fail (page >= 0 && page < index->n_pages);
+
+	g_mutex_lock (&index->mutex);
+	query = ev_text_index_lookup_query (index, text, options);
+	if (!query) {
+		if (index->queries->len == MAX_QUERIES) {
+			guint i, oldest = 0;
+
+			for (i = 1; i < index->queries->len; i++) {
+				TextIndexQuery *q = g_ptr_array_index (index->queries, i);
+				TextIndexQuery *o = g_ptr_array_index (index->queries, oldest);
+
+				if (q->last_used < o->last_used)
+					oldest = i;
+			}
+			g_ptr_array_remove_index_fast (index->queries, oldest);
+		}
+
+		query = text_index_query_new (text, options, index->n_pages);
+		g_ptr_array_add (index->queries, query);
+	}
+	query->last_used = ++index->n_uses;
+
+	if (!query->searched[page]) {
+		if (matches) {
+			query->pages[page] = g_array_new (FALSE, FALSE, sizeof (TextIndexHit));
+			for (l = matches; l; l = g_list_next (l)) {
+				EvFindRectangle *match = (EvFindRectangle *)l->data;
+				TextIndexHit     hit;
+
+				hit.x1 = match->x1;
+				hit.y1 = match->y1;
+				hit.x2 = match->x2;
+				hit.y2 = match->y2;
+				hit.flags = (match->next_line ? HIT_NEXT_LINE : 0) |
+					(match->after_hyphen ? HIT_AFTER_HYPHEN : 0);
+				g_array_append_val (query->pages[page], hit);
+			}
+		}
+		query->searched[page] = TRUE;
+
+		/* The filters are only complete once all the pages are indexed */
+		if (++query->n_searched == index->n_pages &&
+		    index->n_indexed == index->n_pages)
+			ev_text_index_save (index);
+	}
+	g_mutex_unlock (&index->mutex);
+}
@@ -25,12 +25,23 @@ typedef struct _EvSchedulerJob {
 	EvJob         *job;
 	EvJobPriority  priority;
 	GSList        *job_link;
+	/* Document marked as busy when the job was taken from the queue,
+	 * jobs like EvJobLoad set their document while they run */
+	EvDocument    *busy_document;
 } EvSchedulerJob;
 
 G_LOCK_DEFINE_STATIC(job_list);
 static GSList *job_list = NULL;
 
+/* Last job started by any worker, kept for
+ * ev_job_scheduler_get_running_thread_job() callers
+ * outside the worker threads.
+ */
 static EvJob *running_job = NULL;
+static GPrivate worker_running_job;
+
+/* Number of worker threads, 0 means one per processor */
+static guint max_threads = 0;
 
 static gpointer ev_job_thread_proxy               (gpointer        data);
 static void     ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
@@ -44,6 +55,12 @@ static GQueue queue_none = G_QUEUE_INIT;
 static GCond job_queue_cond;
 static GMutex job_queue_mutex;
 
+/* Documents currently used by a worker thread, and jobs being run.
+ * Both are protected by job_queue_mutex.
+ */
+static GHashTable *busy_documents = NULL;
+static GPtrArray *running_jobs = NULL;
+
 static GQueue *job_queue[EV_JOB_N_PRIORITIES] = {
 	&queue_urgent,
 	&queue_high,
@@ -65,27 +82,105 @@ ev_job_queue_push (EvSchedulerJob *job,
 	g_mutex_unlock (&job_queue_mutex);
 }
 
+static gboolean
+ev_job_queue_job_is_ready_unlocked (EvSchedulerJob *job)
+{
+	EvDocument *document = job->job->document;
+
+	/* Jobs for the same document are run by one worker at a time,
+	 * so that they keep the order in which they were queued.
+	 */
+	return !document || !g_hash_table_contains (busy_documents, document);
+}
+
 static EvSchedulerJob *
 ev_job_queue_get_next_unlocked (void)
 {
 	gint i;
 	EvSchedulerJob *job = NULL;
 
-	for (i = EV_JOB_PRIORITY_URGENT; i < EV_JOB_N_PRIORITIES; i++) {
-		job = (EvSchedulerJob *) g_queue_pop_head (job_queue[i]);
-		if (job)
-			break;
+	for (i = EV_JOB_PRIORITY_URGENT; i < EV_JOB_N_PRIORITIES && !job; i++) {
+		GList *l;
+
+		for (l = job_queue[i]->head; l; l = l->next) {
+			if (ev_job_queue_job_is_ready_unlocked (l->data)) {
+				job = (EvSchedulerJob *) l->data;
+				g_queue_delete_link (job_queue[i], l);
+				break;
+			}
+		}
 	}
 
-	ev_debug_message (DEBUG_JOBS, "%s", job ? EV_GET_TYPE_NAME (job->job) : "No jobs in queue");
+	ev_debug_message (DEBUG_JOBS, "%s", job ? EV_GET_TYPE_NAME (job->job) : "No jobs ready in queue");
+
+	if (job) {
+		job->busy_document = job->job->document;
+		if (job->busy_document)
+			g_hash_table_add (busy_documents, job->busy_document);
+		g_ptr_array_add (running_jobs, job->job);
+	}
 
 	return job;
 }
 
+static void
+ev_job_queue_release (EvSchedulerJob *job)
+{
+	g_mutex_lock (&job_queue_mutex);
+
+	if (job->busy_document) {
+		g_hash_table_remove (busy_documents, job->busy_document);
+		job->busy_document = NULL;
+	}
+	g_ptr_array_remove_fast (running_jobs, job->job);
+
+	/* Jobs waiting for this document can be run now */
+	g_cond_broadcast (&job_queue_cond);
+
+	g_mutex_unlock (&job_queue_mutex);
+}
+
+/**
+ * ev_job_scheduler_get_max_threads:
+ *
+ * Returns: the number of worker threads used to run thread jobs, see
+ *   ev_job_scheduler_set_max_threads()
+ *
+ * Since: 49.0
+ */
+guint
+ev_job_scheduler_get_max_threads (void)
+{
+	const gchar *env;
+	guint64      n_threads;
+
+	if (max_threads > 0)
+		return max_threads;
+
+	env = g_getenv ("EV_JOB_SCHEDULER_THREADS");
+	if (env && g_ascii_string_to_unsigned (env, 10, 1, G_MAXUINT16, &n_threads, NULL))
+		return (guint) n_threads;
+
+	return MAX (g_get_num_processors (), 1);
+}
+
 static gpointer
 ev_job_scheduler_init (gpointer data)
 {
-	g_thread_new ("EvJobScheduler", ev_job_thread_proxy, NULL);
+	guint n_threads, i;
+
+	busy_documents = g_hash_table_new (g_direct_hash, g_direct_equal);
+	running_jobs = g_ptr_array_new ();
+
+	n_threads = ev_job_scheduler_get_max_threads ();
+	ev_debug_message (DEBUG_JOBS, "Starting %u worker threads", n_threads);
+
+	for (i = 0; i < n_threads; i++) {
+		GThread *thread;
+
+		thread = g_thread_new ("EvJobScheduler", ev_job_thread_proxy, NULL);
+		g_thread_unref (thread);
+	}
 
 	return NULL;
 }
@@ -180,12 +275,14 @@ ev_job_thread (EvJob *job)
 		if (g_cancellable_is_cancelled (job->cancellable))
 			result = FALSE;
 		else {
+                        g_private_set (&worker_running_job, job);
                         g_atomic_pointer_set (&running_job, job);
 			result = ev_job_run (job);
                 }
 	} while (result);
 
-        g_atomic_pointer_set (&running_job, NULL);
+        g_private_set (&worker_running_job, NULL);
+        g_atomic_pointer_compare_and_exchange (&running_job, job, NULL);
 }
 
 static gboolean
@@ -215,6 +312,7 @@ ev_job_thread_proxy (gpointer data)
 		g_mutex_unlock (&job_queue_mutex);
 
 		ev_job_thread (job->job);
+		ev_job_queue_release (job);
 		ev_scheduler_job_destroy (job);
 	}
 
@@ -310,14 +408,75 @@ ev_job_scheduler_update_job (EvJob         *job,
 /**
  * ev_job_scheduler_get_running_thread_job:
  *
- * Returns: (transfer none): an #EvJob
+ * When called from a worker thread, returns the job run by that
+ * thread. Otherwise returns the job most recently started by any
+ * of the worker threads, if it's still running. Use
+ * ev_job_scheduler_is_job_running() to check whether a given job
+ * is being run.
+ *
+ * Returns: (transfer none) (nullable): an #EvJob
  */
 EvJob *
 ev_job_scheduler_get_running_thread_job (void)
 {
+	EvJob *job;
+
+	job = g_private_get (&worker_running_job);
+	if (job)
+		return job;
+
         return g_atomic_pointer_get (&running_job);
 }
 
+/**
+ * ev_job_scheduler_is_job_running:
+ * @job: an #EvJob
+ *
+ * Returns: %TRUE if @job is currently being run by a worker thread
+ *
+ * Since: 49.0
+ */
+gboolean
+ev_job_scheduler_is_job_running (EvJob *job)
+{
+	gboolean retval = FALSE;
+
+	g_return_val_if_fail (EV_IS_JOB (job), FALSE);
+
+	g_mutex_lock (&job_queue_mutex);
+	if (running_jobs)
+		retval = g_ptr_array_find (running_jobs, job, NULL);
+	g_mutex_unlock (&job_queue_mutex);
+
+	return retval;
+}
+
+/**
+ * ev_job_scheduler_set_max_threads:
+ * @n_threads: the number of worker threads, or 0 for the default
+ *
+ * Sets the number of worker threads used to run thread jobs. Jobs for
+ * different documents are run in parallel, while jobs for the same
+ * document are always run one at a time, in priority order. By default
+ * there is one worker thread per processor, which can be overridden with
+ * the EV_JOB_SCHEDULER_THREADS environment variable.
+ *
+ * This must be called before the first job is pushed, it has no effect
+ * once the scheduler has been started.
+ *
+ * Since: 49.0
+ */
+void
+ev_job_scheduler_set_max_threads (guint n_threads)
+{
+	if (busy_documents) {
+		g_warning ("Job scheduler already started, ignoring max threads");
+		return;
+	}
+
+	max_threads = n_threads;
+}
+
 /**
  * ev_job_scheduler_wait:
  *
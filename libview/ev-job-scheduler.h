@@ -47,6 +47,12 @@ void   ev_job_scheduler_update_job             (EvJob        *job,
                                                 EvJobPriority priority);
 EV_PUBLIC
 EvJob *ev_job_scheduler_get_running_thread_job (void);
+EV_PUBLIC
+gboolean ev_job_scheduler_is_job_running       (EvJob        *job);
+EV_PUBLIC
+void   ev_job_scheduler_set_max_threads        (guint         n_threads);
+EV_PUBLIC
+guint  ev_job_scheduler_get_max_threads        (void);
 
 EV_PUBLIC
 void   ev_job_scheduler_wait                   (void);
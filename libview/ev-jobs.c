@@ -22,6 +22,7 @@
 
 #include "cairo.h"
 #include "ev-jobs.h"
+#include "ev-job-scheduler.h"
 #include "ev-document-links.h"
 #include "ev-document-images.h"
 #include "ev-document-forms.h"
@@ -38,6 +39,7 @@
 #include "ev-document-attachments.h"
 #include "ev-document-media.h"
 #include "ev-document-text.h"
+#include "ev-text-index-private.h"
 #include "ev-debug.h"
 
 #include <errno.h>
@@ -70,6 +72,8 @@ static void ev_job_thumbnail_cairo_init       (EvJobThumbnailCairo      *job);
 static void ev_job_thumbnail_cairo_class_init (EvJobThumbnailCairoClass *class);
 static void ev_job_thumbnail_texture_init       (EvJobThumbnailTexture      *job);
 static void ev_job_thumbnail_texture_class_init (EvJobThumbnailTextureClass *class);
+static void ev_job_page_sizes_init           (EvJobPageSizes           *job);
+static void ev_job_page_sizes_class_init     (EvJobPageSizesClass      *class);
 static void ev_job_load_init                  (EvJobLoad                *job);
 static void ev_job_load_class_init            (EvJobLoadClass           *class);
 static void ev_job_save_init                  (EvJobSave                *job);
@@ -94,8 +98,14 @@ enum {
 	FIND_LAST_SIGNAL
 };
 
+enum {
+	PAGE_SIZES_UPDATED,
+	PAGE_SIZES_LAST_SIGNAL
+};
+
 static guint job_signals[LAST_SIGNAL] = { 0 };
 static guint job_find_signals[FIND_LAST_SIGNAL] = { 0 };
+static guint job_page_sizes_signals[PAGE_SIZES_LAST_SIGNAL] = { 0 };
 
 G_DEFINE_ABSTRACT_TYPE (EvJob, ev_job, G_TYPE_OBJECT)
 G_DEFINE_TYPE (EvJobLinks, ev_job_links, EV_TYPE_JOB)
@@ -107,6 +117,7 @@ G_DEFINE_TYPE (EvJobPageData, ev_job_page_data, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobThumbnailCairo, ev_job_thumbnail_cairo, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobThumbnailTexture, ev_job_thumbnail_texture, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobFonts, ev_job_fonts, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobPageSizes, ev_job_page_sizes, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobLoad, ev_job_load, EV_TYPE_JOB)
 G_DEFINE_TYPE_WITH_PRIVATE (EvJobLoadStream, ev_job_load_stream, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobLoadGFile, ev_job_load_gfile, EV_TYPE_JOB)
@@ -117,6 +128,25 @@ G_DEFINE_TYPE (EvJobLayers, ev_job_layers, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobExport, ev_job_export, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobPrint, ev_job_print, EV_TYPE_JOB)
 
+/* Backends that don't support concurrent reads are rendered while
+ * holding the fontconfig mutex too, like all of them used to be.
+ */
+static void
+ev_job_render_lock (EvDocument *document)
+{
+	ev_document_reader_lock (document);
+	if (!ev_document_supports_concurrent_reads (document))
+		ev_document_fc_mutex_lock ();
+}
+
+static void
+ev_job_render_unlock (EvDocument *document)
+{
+	if (!ev_document_supports_concurrent_reads (document))
+		ev_document_fc_mutex_unlock ();
+	ev_document_reader_unlock (document);
+}
+
 /* EvJob */
 static void
 ev_job_init (EvJob *job)
@@ -345,40 +375,52 @@ ev_job_links_dispose (GObject *object)
 	job = EV_JOB_LINKS (object);
 
 	g_clear_object (&job->model);
+	g_clear_pointer (&job->link_pages, g_hash_table_unref);
+	g_clear_pointer (&job->page_link_tree, g_tree_unref);
 
 	(* G_OBJECT_CLASS (ev_job_links_parent_class)->dispose) (object);
 }
 
+static gint
+page_link_tree_sort (gconstpointer a,
+		     gconstpointer b,
+		     gpointer      data)
+{
+	gint a_int = GPOINTER_TO_INT (a);
+	gint b_int = GPOINTER_TO_INT (b);
+
+	return (a_int < b_int) ? -1 : (a_int > b_int);
+}
+
 static gboolean
-fill_page_labels (GtkTreeModel   *tree_model,
-		  GtkTreePath    *path,
-		  GtkTreeIter    *iter,
-		  EvJob          *job)
+ev_job_links_index_item (GtkTreeModel *model,
+			 GtkTreePath  *path,
+			 GtkTreeIter  *iter,
+			 EvJobLinks   *job_links)
 {
-	EvDocumentLinks *document_links;
-	EvLink          *link;
-	gchar           *page_label;
+	EvJob  *job = EV_JOB (job_links);
+	EvLink *link;
+	gint    page;
 
-	gtk_tree_model_get (tree_model, iter,
+	gtk_tree_model_get (model, iter,
 			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
 			    -1);
-
 	if (!link)
-		return FALSE;
+		return g_cancellable_is_cancelled (job->cancellable);
 
-	document_links = EV_DOCUMENT_LINKS (job->document);
-	page_label = ev_document_links_get_link_page_label (document_links, link);
-	if (!page_label)
-		return FALSE;
+	/* Locked per item so that renders aren't held back by large outlines */
+	ev_document_reader_lock (job->document);
+	page = ev_document_links_get_link_page (EV_DOCUMENT_LINKS (job->document), link);
+	ev_document_reader_unlock (job->document);
 
-	gtk_tree_store_set (GTK_TREE_STORE (tree_model), iter,
-			    EV_DOCUMENT_LINKS_COLUMN_PAGE_LABEL, page_label,
-			    -1);
+	g_hash_table_insert (job_links->link_pages, link, GINT_TO_POINTER (page));
 
-	g_free (page_label);
-	g_object_unref (link);
+	/* Only save the first link we find per page. */
+	if (!g_tree_lookup (job_links->page_link_tree, GINT_TO_POINTER (page)))
+		g_tree_insert (job_links->page_link_tree, GINT_TO_POINTER (page),
+			       gtk_tree_path_copy (path));
 
-	return FALSE;
+	return g_cancellable_is_cancelled (job->cancellable);
 }
 
 static gboolean
@@ -389,11 +431,20 @@ ev_job_links_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (job->document);
 	job_links->model = ev_document_links_get_links_model (EV_DOCUMENT_LINKS (job->document));
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (job->document);
 
-	gtk_tree_model_foreach (job_links->model, (GtkTreeModelForeachFunc)fill_page_labels, job);
+	/* Resolve the page of every item here rather than in the sidebar,
+	 * page labels are only looked up for the rows being displayed
+	 */
+	job_links->link_pages = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+	job_links->page_link_tree = g_tree_new_full (page_link_tree_sort, NULL, NULL,
+						     (GDestroyNotify) gtk_tree_path_free);
+	if (job_links->model)
+		gtk_tree_model_foreach (job_links->model,
+					(GtkTreeModelForeachFunc) ev_job_links_index_item,
+					job_links);
 
 	ev_job_succeeded (job);
 
@@ -469,10 +520,10 @@ ev_job_attachments_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (job->document);
 	job_attachments->attachments =
 		ev_document_attachments_get_attachments (EV_DOCUMENT_ATTACHMENTS (job->document));
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (job->document);
 
 	ev_job_succeeded (job);
 
@@ -533,7 +584,7 @@ ev_job_annots_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (job->document);
 	for (i = 0; i < ev_document_get_n_pages (job->document); i++) {
 		EvMappingList *mapping_list;
 		EvPage        *page;
@@ -546,7 +597,7 @@ ev_job_annots_run (EvJob *job)
 		if (mapping_list)
 			job_annots->annots = g_list_prepend (job_annots->annots, mapping_list);
 	}
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (job->document);
 
 	job_annots->annots = g_list_reverse (job_annots->annots);
 
@@ -613,8 +664,7 @@ ev_job_render_cairo_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_render->page, job);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
-	ev_document_fc_mutex_lock ();
+	ev_job_render_lock (job->document);
 
 	ev_page = ev_document_get_page (job->document, job_render->page);
 	rc = ev_render_context_new (ev_page, job_render->rotation, job_render->scale);
@@ -626,8 +676,7 @@ ev_job_render_cairo_run (EvJob *job)
 
 	if (job_render->surface == NULL ||
 	    cairo_surface_status (job_render->surface) != CAIRO_STATUS_SUCCESS) {
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
+		ev_job_render_unlock (job->document);
 		g_object_unref (rc);
 
                 if (job_render->surface != NULL) {
@@ -654,15 +703,15 @@ ev_job_render_cairo_run (EvJob *job)
 	 * we return now, so that the thread is finished ASAP
 	 */
 	if (g_cancellable_is_cancelled (job->cancellable)) {
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
+		ev_job_render_unlock (job->document);
 		g_object_unref (rc);
 
 		EV_PROFILER_STOP ();
 		return FALSE;
 	}
 
-	if (job_render->include_selection && EV_IS_SELECTION (job->document)) {
+	if (job_render->include_selection && !job_render->has_clip &&
+	    EV_IS_SELECTION (job->document)) {
 		ev_selection_render_selection (EV_SELECTION (job->document),
 					       rc,
 					       &(job_render->selection),
@@ -679,8 +728,7 @@ ev_job_render_cairo_run (EvJob *job)
 
 	g_object_unref (rc);
 
-	ev_document_fc_mutex_unlock ();
-	ev_document_doc_mutex_unlock ();
+	ev_job_render_unlock (job->document);
 
 	ev_job_succeeded (job);
 
@@ -823,22 +871,21 @@ ev_job_render_texture_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_render->page, job);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
-
-	ev_document_fc_mutex_lock ();
+	ev_job_render_lock (job->document);
 
 	ev_page = ev_document_get_page (job->document, job_render->page);
 	rc = ev_render_context_new (ev_page, job_render->rotation, job_render->scale);
 	ev_render_context_set_target_size (rc,
 					   job_render->target_width, job_render->target_height);
+	if (job_render->has_clip)
+		ev_render_context_set_clip (rc, &job_render->clip);
 	g_object_unref (ev_page);
 
 	surface = ev_document_render (job->document, rc);
 
 	if (surface == NULL ||
 	    cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
+		ev_job_render_unlock (job->document);
 		g_object_unref (rc);
 
                 if (surface != NULL) {
@@ -869,15 +916,15 @@ ev_job_render_texture_run (EvJob *job)
 	 * we return now, so that the thread is finished ASAP
 	 */
 	if (g_cancellable_is_cancelled (job->cancellable)) {
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
+		ev_job_render_unlock (job->document);
 		g_object_unref (rc);
 		EV_PROFILER_STOP ();
 
 		return FALSE;
 	}
 
-	if (job_render->include_selection && EV_IS_SELECTION (job->document)) {
+	if (job_render->include_selection && !job_render->has_clip &&
+	    EV_IS_SELECTION (job->document)) {
 		ev_selection_render_selection (EV_SELECTION (job->document),
 					       rc,
 					       &selection,
@@ -899,8 +946,7 @@ ev_job_render_texture_run (EvJob *job)
 
 	g_object_unref (rc);
 
-	ev_document_fc_mutex_unlock ();
-	ev_document_doc_mutex_unlock ();
+	ev_job_render_unlock (job->document);
 
 	ev_job_succeeded (job);
 
@@ -933,6 +979,26 @@ ev_job_render_texture_set_selection_info (EvJobRenderTexture *job,
 	job->base = *base;
 }
 
+/**
+ * ev_job_render_texture_set_clip:
+ * @job: an #EvJobRenderTexture
+ * @clip: the area of the page to render
+ *
+ * Renders only @clip, in pixels of the page at the job scale and
+ * rotation, into a texture of the size of @clip. Selection is not
+ * rendered for clipped jobs.
+ *
+ * Since: 49.0
+ */
+void
+ev_job_render_texture_set_clip (EvJobRenderTexture          *job,
+				const cairo_rectangle_int_t *clip)
+{
+	job->has_clip = TRUE;
+	job->clip = *clip;
+	job->include_selection = FALSE;
+}
+
 /* EvJobPageData */
 static void
 ev_job_page_data_init (EvJobPageData *job)
@@ -949,7 +1015,7 @@ ev_job_page_data_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_pd->page, job);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (job->document);
 	ev_page = ev_document_get_page (job->document, job_pd->page);
 
 	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_MAPPING) && EV_IS_DOCUMENT_TEXT (job->document))
@@ -994,7 +1060,7 @@ ev_job_page_data_run (EvJob *job)
                         ev_document_media_get_media_mapping (EV_DOCUMENT_MEDIA (job->document),
                                                              ev_page);
 	g_object_unref (ev_page);
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (job->document);
 
 	ev_job_succeeded (job);
 
@@ -1060,7 +1126,7 @@ ev_job_thumbnail_cairo_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, "%d (%p)", job_thumb->page, job);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (job->document);
 
 	page = ev_document_get_page (job->document, job_thumb->page);
 	rc = ev_render_context_new (page, job_thumb->rotation, job_thumb->scale);
@@ -1070,7 +1136,7 @@ ev_job_thumbnail_cairo_run (EvJob *job)
 
 	job_thumb->thumbnail_surface = ev_document_get_thumbnail_surface (job->document, rc);
 	g_object_unref (rc);
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (job->document);
 
 	if (job_thumb->thumbnail_surface == NULL) {
 		ev_job_failed (job,
@@ -1167,7 +1233,7 @@ ev_job_thumbnail_texture_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, "%d (%p)", job_thumb->page, job);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (job->document);
 
 	page = ev_document_get_page (job->document, job_thumb->page);
 	rc = ev_render_context_new (page, job_thumb->rotation, job_thumb->scale);
@@ -1180,7 +1246,7 @@ ev_job_thumbnail_texture_run (EvJob *job)
 	job_thumb->thumbnail_texture = gdk_texture_new_for_surface (surface);
 	cairo_surface_destroy(surface);
 	g_object_unref (rc);
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (job->document);
 
 	if (job_thumb->thumbnail_texture == NULL) {
 		ev_job_failed (job,
@@ -1276,13 +1342,13 @@ ev_job_fonts_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
+	ev_document_writer_lock (document);
 	ev_document_fc_mutex_lock ();
 
 	ev_document_fonts_scan (EV_DOCUMENT_FONTS (document));
 
 	ev_document_fc_mutex_unlock ();
-	ev_document_doc_mutex_unlock ();
+	ev_document_writer_unlock (document);
 
 	ev_job_succeeded (job);
 
@@ -1312,6 +1378,118 @@ ev_job_fonts_new (EvDocument *document)
 	return EV_JOB (job);
 }
 
+/* EvJobPageSizes */
+
+/* Pages measured at a time, "updated" is emitted after every batch
+ * whose pages turned out not to have their estimated size */
+#define PAGE_SIZES_BATCH 8
+
+static void
+ev_job_page_sizes_init (EvJobPageSizes *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+}
+
+static gboolean
+ev_job_page_sizes_emit_updated (EvJobPageSizes *job)
+{
+	g_atomic_int_set (&job->update_pending, FALSE);
+	if (!EV_JOB (job)->cancelled)
+		g_signal_emit (job, job_page_sizes_signals[PAGE_SIZES_UPDATED], 0);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+ev_job_page_sizes_run (EvJob *job)
+{
+	EvJobPageSizes *job_sizes = EV_JOB_PAGE_SIZES (job);
+	gint            measured;
+
+	ev_debug_message (DEBUG_JOBS, "page: %d", job_sizes->start_page);
+	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
+
+	for (measured = 0; measured < job_sizes->n_pages; measured += PAGE_SIZES_BATCH) {
+		gboolean changed;
+
+		if (g_cancellable_is_cancelled (job->cancellable))
+			break;
+
+		ev_document_reader_lock (job->document);
+		changed = ev_document_fill_cache (job->document,
+						  job_sizes->start_page,
+						  MIN (PAGE_SIZES_BATCH, job_sizes->n_pages - measured));
+		ev_document_reader_unlock (job->document);
+
+		if (!changed)
+			continue;
+
+		job_sizes->sizes_changed = TRUE;
+		if (g_atomic_int_compare_and_exchange (&job_sizes->update_pending, FALSE, TRUE))
+			g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+					 (GSourceFunc) ev_job_page_sizes_emit_updated,
+					 g_object_ref (job),
+					 (GDestroyNotify) g_object_unref);
+	}
+
+	ev_job_succeeded (job);
+
+	EV_PROFILER_STOP ();
+	return FALSE;
+}
+
+static void
+ev_job_page_sizes_class_init (EvJobPageSizesClass *class)
+{
+	EvJobClass *job_class = EV_JOB_CLASS (class);
+
+	job_class->run = ev_job_page_sizes_run;
+
+	job_page_sizes_signals[PAGE_SIZES_UPDATED] =
+		g_signal_new ("updated",
+			      EV_TYPE_JOB_PAGE_SIZES,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobPageSizesClass, updated),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+}
+
+/**
+ * ev_job_page_sizes_new:
+ * @document: an #EvDocument loaded with %EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE
+ * @start_page: the page to start measuring from
+ * @n_pages: the maximum number of pages to measure
+ *
+ * Creates a job that fills the page cache of @document, see
+ * ev_document_fill_cache(). The document is locked a few pages at a
+ * time, and #EvJobPageSizes::updated is emitted in the main loop as soon
+ * as pages turn out not to have their estimated size, so the layout can
+ * be updated progressively. Large documents are measured by several
+ * jobs, letting other jobs run in between.
+ *
+ * Returns: (transfer full): the new #EvJob
+ *
+ * Since: 49.0
+ */
+EvJob *
+ev_job_page_sizes_new (EvDocument *document,
+		       gint        start_page,
+		       gint        n_pages)
+{
+	EvJobPageSizes *job;
+
+	ev_debug_message (DEBUG_JOBS, "page: %d", start_page);
+
+	job = g_object_new (EV_TYPE_JOB_PAGE_SIZES, NULL);
+
+	EV_JOB (job)->document = g_object_ref (document);
+	job->start_page = start_page;
+	job->n_pages = n_pages;
+
+	return EV_JOB (job);
+}
+
 /* EvJobLoad */
 static void
 ev_job_load_init (EvJobLoad *job)
@@ -1360,12 +1538,14 @@ ev_job_load_run (EvJob *job)
 
 		uncompressed_uri = g_object_get_data (G_OBJECT (job->document),
 						      "uri-uncompressed");
-		ev_document_load (job->document,
-				  uncompressed_uri ? uncompressed_uri : job_load->uri,
-				  &error);
+		ev_document_load_full (job->document,
+				       uncompressed_uri ? uncompressed_uri : job_load->uri,
+				       job_load->flags | EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE,
+				       &error);
 	} else {
-		job->document = ev_document_factory_get_document (job_load->uri,
-								  &error);
+		job->document = ev_document_factory_get_document_full (job_load->uri,
+								       job_load->flags | EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE,
+								       &error);
 	}
 
 	ev_document_fc_mutex_unlock ();
@@ -1424,6 +1604,25 @@ ev_job_load_set_password (EvJobLoad *job, const gchar *password)
 	job->password = password ? g_strdup (password) : NULL;
 }
 
+/**
+ * ev_job_load_set_load_flags:
+ * @job: an #EvJobLoad
+ * @flags: flags from #EvDocumentLoadFlags
+ *
+ * Sets flags to load the document with, in addition to
+ * %EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE.
+ *
+ * Since: 49.0
+ */
+void
+ev_job_load_set_load_flags (EvJobLoad          *job,
+			    EvDocumentLoadFlags flags)
+{
+	g_return_if_fail (EV_IS_JOB_LOAD (job));
+
+	job->flags = flags;
+}
+
 /* EvJobLoadStream */
 
 /**
@@ -2037,7 +2236,7 @@ ev_job_save_run (EvJob *job)
 	}
 	close (fd);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_writer_lock (job->document);
 
 	/* Save document to temp filename */
 	local_uri = g_filename_to_uri (tmp_filename, NULL, &error);
@@ -2045,7 +2244,7 @@ ev_job_save_run (EvJob *job)
                 ev_document_save (job->document, local_uri, &error);
         }
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_writer_unlock (job->document);
 
 	if (error) {
 		g_free (local_uri);
@@ -2148,10 +2347,68 @@ ev_job_save_new (EvDocument  *document,
 }
 
 /* EvJobFind */
+#define FIND_MAX_THREADS 4
+
 static void
 ev_job_find_init (EvJobFind *job)
 {
 	EV_JOB (job)->run_mode = EV_JOB_RUN_MAIN_LOOP;
+
+	g_mutex_init (&job->results_lock);
+}
+
+/* Packs the matches of a page into a single allocation, with the
+ * flags after the rectangles. Takes ownership of @matches.
+ */
+static EvFindPageResults *
+ev_job_find_page_results_new (GList *matches)
+{
+	EvFindPageResults *results;
+	GList             *l;
+	guint              n_results, i;
+
+	n_results = g_list_length (matches);
+	if (n_results == 0)
+		return NULL;
+
+	results = g_malloc (sizeof (EvFindPageResults) +
+			    n_results * (sizeof (EvRectangle) + sizeof (guint8)));
+	results->n_results = n_results;
+	results->n_main_results = 0;
+	results->areas = (EvRectangle *)(results + 1);
+	results->flags = (guint8 *)(results->areas + n_results);
+
+	for (l = matches, i = 0; l; l = g_list_next (l), i++) {
+		EvFindRectangle *match = (EvFindRectangle *)l->data;
+
+		results->areas[i].x1 = match->x1;
+		results->areas[i].y1 = match->y1;
+		results->areas[i].x2 = match->x2;
+		results->areas[i].y2 = match->y2;
+		results->flags[i] = 0;
+		if (match->next_line)
+			results->flags[i] |= EV_FIND_RESULT_NEXT_LINE;
+		else
+			results->n_main_results++;
+		if (match->after_hyphen)
+			results->flags[i] |= EV_FIND_RESULT_AFTER_HYPHEN;
+	}
+
+	g_list_free_full (matches, (GDestroyNotify)ev_find_rectangle_free);
+
+	return results;
+}
+
+static void
+ev_job_find_free_results (EvFindPageResults **results,
+			  gint                n_pages)
+{
+	gint i;
+
+	for (i = 0; i < n_pages; i++)
+		g_free (results[i]);
+
+	g_free (results);
 }
 
 static void
@@ -2161,35 +2418,251 @@ ev_job_find_dispose (GObject *object)
 
 	ev_debug_message (DEBUG_JOBS, NULL);
 
+	if (job->pool) {
+		/* Workers don't take a reference on the job, stop them
+		 * and wait for the pages being searched before releasing
+		 * what they use */
+		g_cancellable_cancel (EV_JOB (job)->cancellable);
+		g_thread_pool_free (job->pool, TRUE, TRUE);
+		job->pool = NULL;
+	}
+	g_clear_handle_id (&job->update_id, g_source_remove);
+
 	g_clear_pointer (&job->text, g_free);
+	g_clear_pointer (&job->searched, g_free);
+	g_clear_pointer (&job->index_query, g_array_unref);
+
+	if (job->results) {
+		ev_job_find_free_results (job->results, job->n_pages);
+		job->results = NULL;
+	}
+
+	if (job->page_results) {
+		ev_job_find_free_results (job->page_results, job->n_pages);
+		job->page_results = NULL;
+	}
 
 	if (job->pages) {
 		gint i;
 
-		for (i = 0; i < job->n_pages; i++) {
+		for (i = 0; i < job->n_pages; i++)
 			g_list_free_full (job->pages[i], (GDestroyNotify)ev_find_rectangle_free);
-		}
-
 		g_clear_pointer (&job->pages, g_free);
 	}
 
 	(* G_OBJECT_CLASS (ev_job_find_parent_class)->dispose) (object);
 }
 
+static void
+ev_job_find_finalize (GObject *object)
+{
+	EvJobFind *job = EV_JOB_FIND (object);
+
+	g_mutex_clear (&job->results_lock);
+
+	(* G_OBJECT_CLASS (ev_job_find_parent_class)->finalize) (object);
+}
+
+/* Stores the matches of @page, which must be the current page, and moves
+ * to the next one. Returns whether all pages have been searched.
+ */
+static gboolean
+ev_job_find_page_searched (EvJobFind         *job_find,
+			   gint               page,
+			   EvFindPageResults *matches)
+{
+	if (!job_find->has_results)
+		job_find->has_results = (matches != NULL);
+
+	job_find->page_results[page] = matches;
+	g_signal_emit (job_find, job_find_signals[FIND_UPDATED], 0, page);
+
+	job_find->current_page = (job_find->current_page + 1) % job_find->n_pages;
+
+	return job_find->current_page == job_find->start_page;
+}
+
+/* Emits the results found by the workers, in page order, so that
+ * "updated" is emitted for the same pages and in the same order
+ * than when searching one page at a time.
+ */
+static gboolean
+ev_job_find_emit_updates (EvJobFind *job_find)
+{
+	EvJob *job = EV_JOB (job_find);
+
+	g_mutex_lock (&job_find->results_lock);
+	job_find->update_id = 0;
+	g_mutex_unlock (&job_find->results_lock);
+
+	g_object_ref (job_find);
+
+	while (!ev_job_is_finished (job) && !job->cancelled) {
+		gint               page = job_find->current_page;
+		EvFindPageResults *matches;
+		gboolean           searched;
+
+		g_mutex_lock (&job_find->results_lock);
+		searched = job_find->searched[page];
+		matches = job_find->results[page];
+		job_find->results[page] = NULL;
+		g_mutex_unlock (&job_find->results_lock);
+
+		if (!searched)
+			break;
+
+		if (ev_job_find_page_searched (job_find, page, matches))
+			ev_job_succeeded (job);
+	}
+
+	g_object_unref (job_find);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Returns %TRUE if the matches of @page are known without searching it,
+ * because the same search was already done or the text index tells the
+ * page can't match.
+ */
+static gboolean
+ev_job_find_lookup_page (EvJobFind          *job_find,
+			 gint                page,
+			 EvFindPageResults **results)
+{
+	EvTextIndex *index = ev_document_get_text_index (EV_JOB (job_find)->document);
+	GList       *matches;
+
+	*results = NULL;
+	if (!index)
+		return FALSE;
+
+	if (ev_text_index_get_hits (index, job_find->text, job_find->options,
+				    page, &matches)) {
+		*results = ev_job_find_page_results_new (matches);
+		return TRUE;
+	}
+
+	if (!ev_text_index_page_may_match (index, page, job_find->index_query)) {
+		ev_text_index_add_hits (index, job_find->text, job_find->options,
+					page, NULL);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Searches @page, storing its matches in the text index, and adding the
+ * page to it if it's not there yet and @index_page is %TRUE. Getting the
+ * text of the page to index it is as slow as searching it, so it's only
+ * done from the worker threads, never from the main loop.
+ * Must be called with the reader lock of the document held.
+ */
+static EvFindPageResults *
+ev_job_find_search_page (EvJobFind *job_find,
+			 gint       page,
+			 gboolean   index_page)
+{
+	EvJob       *job = EV_JOB (job_find);
+	EvTextIndex *index = ev_document_get_text_index (job->document);
+	EvPage      *ev_page;
+	GList       *matches;
+
+	ev_page = ev_document_get_page (job->document, page);
+	matches = ev_document_find_find_text (EV_DOCUMENT_FIND (job->document),
+					      ev_page, job_find->text,
+					      job_find->options);
+	if (index)
+		ev_text_index_add_hits (index, job_find->text, job_find->options,
+					page, matches);
+
+	if (index && index_page && !ev_text_index_has_page (index, page)) {
+		gchar *text;
+
+		text = ev_document_text_get_text (EV_DOCUMENT_TEXT (job->document), ev_page);
+		ev_text_index_add_page (index, page, text);
+		g_free (text);
+	}
+
+	g_object_unref (ev_page);
+
+	return ev_job_find_page_results_new (matches);
+}
+
+static void
+ev_job_find_search_pages (gpointer data,
+			  gpointer user_data)
+{
+	EvJobFind *job_find = EV_JOB_FIND (user_data);
+	EvJob     *job = EV_JOB (job_find);
+
+	while (!g_cancellable_is_cancelled (job->cancellable)) {
+		EvFindPageResults *matches = NULL;
+		gint               page;
+
+		page = g_atomic_int_add (&job_find->next_page, 1);
+		if (page >= job_find->n_pages)
+			break;
+		page = (job_find->start_page + page) % job_find->n_pages;
+
+		if (!ev_job_find_lookup_page (job_find, page, &matches)) {
+			ev_document_reader_lock (job->document);
+			matches = ev_job_find_search_page (job_find, page, TRUE);
+			ev_document_reader_unlock (job->document);
+		}
+
+		g_mutex_lock (&job_find->results_lock);
+		job_find->results[page] = matches;
+		job_find->searched[page] = TRUE;
+		if (job_find->update_id == 0)
+			job_find->update_id = g_idle_add ((GSourceFunc)ev_job_find_emit_updates,
+							  job_find);
+		g_mutex_unlock (&job_find->results_lock);
+	}
+}
+
+static void
+ev_job_find_start_workers (EvJobFind *job_find)
+{
+	guint n_threads, i;
+
+	/* Don't take more threads than the scheduler workers, the searches
+	 * compete with them for the document. Backends that don't support
+	 * concurrent reads are searched by a single thread.
+	 */
+	if (ev_document_supports_concurrent_reads (EV_JOB (job_find)->document)) {
+		n_threads = CLAMP (g_get_num_processors () - 1, 1, FIND_MAX_THREADS);
+		n_threads = MIN (n_threads, ev_job_scheduler_get_max_threads ());
+	} else {
+		n_threads = 1;
+	}
+	n_threads = MIN (n_threads, (guint)job_find->n_pages);
+
+	ev_debug_message (DEBUG_JOBS, "Searching with %u threads", n_threads);
+
+	job_find->results = g_new0 (EvFindPageResults *, job_find->n_pages);
+	job_find->searched = g_new0 (guint8, job_find->n_pages);
+	job_find->pool = g_thread_pool_new (ev_job_find_search_pages, job_find,
+					    n_threads, FALSE, NULL);
+
+	/* Every worker keeps taking pages until all of them are taken */
+	for (i = 0; i < n_threads; i++)
+		g_thread_pool_push (job_find->pool, GUINT_TO_POINTER (i + 1), NULL);
+}
+
 static gboolean
 ev_job_find_run (EvJob *job)
 {
-	EvJobFind      *job_find = EV_JOB_FIND (job);
-	EvDocumentFind *find = EV_DOCUMENT_FIND (job->document);
-	EvPage         *ev_page;
-	GList          *matches;
-	int64_t         sysprof_begin;
+	EvJobFind         *job_find = EV_JOB_FIND (job);
+	EvFindPageResults *matches = NULL;
+	int64_t            sysprof_begin;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
 
-	/* Do not block the main loop */
-	if (!ev_document_doc_mutex_trylock ())
-		return TRUE;
+	/* Results are emitted by ev_job_find_emit_updates() from now on */
+	if (job_find->n_pages > 1) {
+		ev_job_find_start_workers (job_find);
+		return FALSE;
+	}
 
 #ifdef EV_ENABLE_DEBUG
 	/* We use the #ifdef in this case because of the if */
@@ -2200,21 +2673,17 @@ ev_job_find_run (EvJob *job)
 		sysprof_begin = SYSPROF_CAPTURE_CURRENT_TIME;
 #endif
 
-	ev_page = ev_document_get_page (job->document, job_find->current_page);
-	matches = ev_document_find_find_text (find, ev_page, job_find->text,
-					      job_find->options);
-	g_object_unref (ev_page);
+	if (!ev_job_find_lookup_page (job_find, job_find->current_page, &matches)) {
+		/* Do not block the main loop */
+		if (!ev_document_reader_trylock (job->document))
+			return TRUE;
 
-	ev_document_doc_mutex_unlock ();
+		matches = ev_job_find_search_page (job_find, job_find->current_page, FALSE);
 
-	if (!job_find->has_results)
-		job_find->has_results = (matches != NULL);
-
-	job_find->pages[job_find->current_page] = matches;
-	g_signal_emit (job_find, job_find_signals[FIND_UPDATED], 0, job_find->current_page);
+		ev_document_reader_unlock (job->document);
+	}
 
-	job_find->current_page = (job_find->current_page + 1) % job_find->n_pages;
-	if (job_find->current_page == job_find->start_page) {
+	if (ev_job_find_page_searched (job_find, job_find->current_page, matches)) {
 		ev_job_succeeded (job);
 #ifdef EV_ENABLE_DEBUG
 		/* Because we skipped EV_PROFILER_START () to escape the
@@ -2238,6 +2707,7 @@ ev_job_find_class_init (EvJobFindClass *class)
 
 	job_class->run = ev_job_find_run;
 	gobject_class->dispose = ev_job_find_dispose;
+	gobject_class->finalize = ev_job_find_finalize;
 
 	job_find_signals[FIND_UPDATED] =
 		g_signal_new ("updated",
@@ -2268,9 +2738,11 @@ ev_job_find_new (EvDocument    *document,
 	job->current_page = start_page;
 	job->n_pages = n_pages;
 	job->pages = g_new0 (GList *, n_pages);
+	job->page_results = g_new0 (EvFindPageResults *, n_pages);
 	job->text = g_strdup (text);
 	job->has_results = FALSE;
 	job->options = options;
+	job->index_query = ev_text_index_query_new (text);
 
 	return EV_JOB (job);
 }
@@ -2303,15 +2775,9 @@ gint
 ev_job_find_get_n_main_results (EvJobFind *job,
 				gint       page)
 {
-	GList *l;
-	int n = 0;
+	EvFindPageResults *results = job->page_results[page];
 
-	for (l = job->pages[page]; l; l = l->next) {
-		if ( !((EvFindRectangle *) l->data)->next_line )
-			n++;
-	}
-
-	return n;
+	return results ? results->n_main_results : 0;
 }
 
 gdouble
@@ -2339,15 +2805,60 @@ ev_job_find_has_results (EvJobFind *job)
 	return job->has_results;
 }
 
+/**
+ * ev_job_find_get_page_results: (skip)
+ * @job: an #EvJobFind
+ * @page: the page index
+ *
+ * Returns: the matches found in @page, or %NULL if there are no
+ *   matches or @page hasn't been searched yet
+ *
+ * Since: 49.0
+ */
+const EvFindPageResults *
+ev_job_find_get_page_results (EvJobFind *job,
+			      gint       page)
+{
+	g_return_val_if_fail (EV_IS_JOB_FIND (job), NULL);
+	g_return_val_if_fail (page >= 0 && page < job->n_pages, NULL);
+
+	return job->page_results[page];
+}
+
 /**
  * ev_job_find_get_results: (skip)
  * @job: an #EvJobFind
  *
+ * The lists are built from the page results on demand, use
+ * ev_job_find_get_page_results() instead.
+ *
  * Returns: a #GList of #GList<!-- -->s containing #EvFindRectangle<!-- -->s
  */
 GList **
 ev_job_find_get_results (EvJobFind *job)
 {
+	gint i;
+
+	for (i = 0; i < job->n_pages; i++) {
+		EvFindPageResults *results = job->page_results[i];
+		gint               j;
+
+		if (job->pages[i] || !results)
+			continue;
+
+		for (j = results->n_results - 1; j >= 0; j--) {
+			EvFindRectangle *match = ev_find_rectangle_new ();
+
+			match->x1 = results->areas[j].x1;
+			match->y1 = results->areas[j].y1;
+			match->x2 = results->areas[j].x2;
+			match->y2 = results->areas[j].y2;
+			match->next_line = (results->flags[j] & EV_FIND_RESULT_NEXT_LINE) != 0;
+			match->after_hyphen = (results->flags[j] & EV_FIND_RESULT_AFTER_HYPHEN) != 0;
+			job->pages[i] = g_list_prepend (job->pages[i], match);
+		}
+	}
+
 	return job->pages;
 }
 
@@ -2380,9 +2891,9 @@ ev_job_layers_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (job->document);
 	job_layers->model = ev_document_layers_get_layers (EV_DOCUMENT_LAYERS (job->document));
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (job->document);
 
 	ev_job_succeeded (job);
 
@@ -2446,7 +2957,7 @@ ev_job_export_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	EV_PROFILER_START (EV_GET_TYPE_NAME (job));
 
-	ev_document_doc_mutex_lock ();
+	ev_document_writer_lock (job->document);
 
 	ev_page = ev_document_get_page (job->document, job_export->page);
 	if (job_export->rc) {
@@ -2462,7 +2973,7 @@ ev_job_export_run (EvJob *job)
 
 	ev_file_exporter_do_page (EV_FILE_EXPORTER (job->document), job_export->rc);
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_writer_unlock (job->document);
 
 	ev_job_succeeded (job);
 
@@ -2539,14 +3050,14 @@ ev_job_print_run (EvJob *job)
 	job->finished = FALSE;
 	g_clear_error (&job->error);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (job->document);
 
 	ev_page = ev_document_get_page (job->document, job_print->page);
 	ev_document_print_print_page (EV_DOCUMENT_PRINT (job->document),
 				      ev_page, job_print->cr);
 	g_object_unref (ev_page);
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (job->document);
 
 	if (g_cancellable_is_cancelled (job->cancellable)) {
 		EV_PROFILER_STOP ();
@@ -62,6 +62,9 @@ typedef struct _EvJobAnnotsClass EvJobAnnotsClass;
 typedef struct _EvJobFonts EvJobFonts;
 typedef struct _EvJobFontsClass EvJobFontsClass;
 
+typedef struct _EvJobPageSizes EvJobPageSizes;
+typedef struct _EvJobPageSizesClass EvJobPageSizesClass;
+
 typedef struct _EvJobLoad EvJobLoad;
 typedef struct _EvJobLoadClass EvJobLoadClass;
 
@@ -79,6 +82,7 @@ typedef struct _EvJobSaveClass EvJobSaveClass;
 
 typedef struct _EvJobFind EvJobFind;
 typedef struct _EvJobFindClass EvJobFindClass;
+typedef struct _EvFindPageResults EvFindPageResults;
 
 typedef struct _EvJobLayers EvJobLayers;
 typedef struct _EvJobLayersClass EvJobLayersClass;
@@ -159,6 +163,13 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_IS_JOB_FONTS_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_FONTS))
 #define EV_JOB_FONTS_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_FONTS, EvJobFontsClass))
 
+#define EV_TYPE_JOB_PAGE_SIZES            (ev_job_page_sizes_get_type())
+#define EV_JOB_PAGE_SIZES(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_PAGE_SIZES, EvJobPageSizes))
+#define EV_IS_JOB_PAGE_SIZES(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_PAGE_SIZES))
+#define EV_JOB_PAGE_SIZES_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), EV_TYPE_JOB_PAGE_SIZES, EvJobPageSizesClass))
+#define EV_IS_JOB_PAGE_SIZES_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_PAGE_SIZES))
+#define EV_JOB_PAGE_SIZES_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_PAGE_SIZES, EvJobPageSizesClass))
+
 
 #define EV_TYPE_JOB_LOAD            (ev_job_load_get_type())
 #define EV_JOB_LOAD(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_LOAD, EvJobLoad))
@@ -263,6 +274,9 @@ struct _EvJobLinks
 	EvJob parent;
 
 	GtkTreeModel *model;
+	/* Page of every link in the model, and path of the first item of every page */
+	GHashTable   *link_pages;
+	GTree        *page_link_tree;
 };
 
 struct _EvJobLinksClass
@@ -332,6 +346,8 @@ struct _EvJobRenderTexture
 	gboolean page_ready;
 	gint target_width;
 	gint target_height;
+	gboolean has_clip;
+	cairo_rectangle_int_t clip;
 	GdkTexture *texture;
 
 	gboolean include_selection;
@@ -435,12 +451,31 @@ struct _EvJobFontsClass
 	EvJobClass parent_class;
 };
 
+struct _EvJobPageSizes
+{
+	EvJob parent;
+
+	gint start_page;
+	gint n_pages;
+	gboolean sizes_changed;
+	gint update_pending;
+};
+
+struct _EvJobPageSizesClass
+{
+	EvJobClass parent_class;
+
+	/* Signals */
+	void (* updated)  (EvJobPageSizes *job);
+};
+
 struct _EvJobLoad
 {
 	EvJob parent;
 
 	gchar *uri;
 	gchar *password;
+	EvDocumentLoadFlags flags;
 };
 
 struct _EvJobLoadClass
@@ -504,6 +539,24 @@ struct _EvJobSaveClass
 	EvJobClass parent_class;
 };
 
+typedef enum {
+	EV_FIND_RESULT_NEXT_LINE    = 1 << 0,
+	EV_FIND_RESULT_AFTER_HYPHEN = 1 << 1
+} EvFindResultFlags;
+
+/* The matches of a page. Rectangles and flags are kept in separate
+ * arrays, in the order returned by the backend; a match across two
+ * lines takes two consecutive entries, the first one with
+ * EV_FIND_RESULT_NEXT_LINE set.
+ */
+struct _EvFindPageResults
+{
+	guint        n_results;
+	guint        n_main_results;
+	EvRectangle *areas;
+	guint8      *flags;
+};
+
 struct _EvJobFind
 {
 	EvJob parent;
@@ -511,10 +564,22 @@ struct _EvJobFind
 	gint start_page;
 	gint current_page;
 	gint n_pages;
-	GList **pages;
+	GList **pages; /* Only filled by ev_job_find_get_results() */
+	EvFindPageResults **page_results;
 	gchar *text;
 	gboolean has_results;
         EvFindOptions options;
+	GArray *index_query;
+
+	/* Pages are searched in worker threads when the document
+	 * supports concurrent reads, results are moved to @pages
+	 * in order from the main loop */
+	GThreadPool *pool;
+	GMutex results_lock;
+	EvFindPageResults **results;
+	guint8 *searched;
+	gint next_page;
+	guint update_id;
 };
 
 struct _EvJobFindClass
@@ -647,6 +712,9 @@ void     ev_job_render_texture_set_selection_info (EvJobRenderTexture     *job,
 						 EvSelectionStyle selection_style,
 						 GdkRGBA         *text,
 						 GdkRGBA         *base);
+EV_PUBLIC
+void     ev_job_render_texture_set_clip           (EvJobRenderTexture          *job,
+						 const cairo_rectangle_int_t *clip);
 
 /* EvJobPageData */
 EV_PUBLIC
@@ -694,6 +762,14 @@ GType 		ev_job_fonts_get_type 	  (void) G_GNUC_CONST;
 EV_PUBLIC
 EvJob 	       *ev_job_fonts_new 	  (EvDocument      *document);
 
+/* EvJobPageSizes */
+EV_PUBLIC
+GType           ev_job_page_sizes_get_type (void) G_GNUC_CONST;
+EV_PUBLIC
+EvJob          *ev_job_page_sizes_new      (EvDocument      *document,
+					    gint             start_page,
+					    gint             n_pages);
+
 /* EvJobLoad */
 EV_PUBLIC
 GType 		ev_job_load_get_type 	  (void) G_GNUC_CONST;
@@ -705,6 +781,9 @@ void            ev_job_load_set_uri       (EvJobLoad       *load,
 EV_PUBLIC
 void            ev_job_load_set_password  (EvJobLoad       *job,
 					   const gchar     *password);
+EV_PUBLIC
+void            ev_job_load_set_load_flags (EvJobLoad          *job,
+					    EvDocumentLoadFlags flags);
 
 /* EvJobLoadStream */
 EV_PUBLIC
@@ -797,6 +876,9 @@ gdouble         ev_job_find_get_progress  (EvJobFind       *job);
 EV_PUBLIC
 gboolean        ev_job_find_has_results   (EvJobFind       *job);
 EV_PUBLIC
+const EvFindPageResults *ev_job_find_get_page_results (EvJobFind *job,
+						       gint       page);
+EV_PUBLIC
 GList         **ev_job_find_get_results   (EvJobFind       *job);
 
 /* EvJobLayers */
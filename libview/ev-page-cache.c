@@ -19,6 +19,7 @@
 
 #include <config.h>
 
+#include <string.h>
 #include <glib.h>
 #include "ev-jobs.h"
 #include "ev-job-scheduler.h"
@@ -57,6 +58,11 @@ typedef struct _EvPageCacheData {
 	PangoAttrList     *text_attrs;
         PangoLogAttr      *text_log_attrs;
         gulong             text_log_attrs_length;
+
+	/* Estimated size in bytes, and link in the LRU list
+	 * of pages whose data is done */
+	gsize              size;
+	GList              lru_link;
 } EvPageCacheData;
 
 struct _EvPageCache {
@@ -71,6 +77,14 @@ struct _EvPageCache {
 	gint               end_page;
 
 	EvJobPageDataFlags flags;
+
+	/* Data of pages outside of the current range and the
+	 * preloaded pages is evicted when size exceeds max_size,
+	 * least recently used first */
+	GQueue             lru;
+	gsize              size;
+	gsize              max_size;
+	gint               kept_page;
 };
 
 struct _EvPageCacheClass {
@@ -87,6 +101,13 @@ struct _EvPageCacheClass {
 
 #define PRE_CACHE_SIZE 1
 
+#define DEFAULT_MAX_SIZE (32 * 1024 * 1024)
+
+/* Rough estimates of the memory used by the data of a mapping
+ * and a text attribute, which can't be measured */
+#define MAPPING_DATA_SIZE 128
+#define TEXT_ATTR_SIZE    64
+
 static void job_page_data_finished_cb (EvJob       *job,
 				       EvPageCache *cache);
 static void job_page_data_cancelled_cb (EvJob       *job,
@@ -153,6 +174,9 @@ ev_page_cache_finalize (GObject *object)
 static void
 ev_page_cache_init (EvPageCache *cache)
 {
+	g_queue_init (&cache->lru);
+	cache->max_size = DEFAULT_MAX_SIZE;
+	cache->kept_page = -1;
 }
 
 static void
@@ -245,6 +269,111 @@ ev_page_cache_get_flags_for_data (EvPageCache     *cache,
 	return flags;
 }
 
+static gsize
+mapping_list_get_size (EvMappingList *mapping_list)
+{
+	if (!mapping_list)
+		return 0;
+
+	return ev_mapping_list_length (mapping_list) *
+		(sizeof (EvMapping) + sizeof (GList) + MAPPING_DATA_SIZE);
+}
+
+static gsize
+text_attrs_get_size (PangoAttrList *attrs)
+{
+	PangoAttrIterator *iter;
+	gsize              size = 0;
+
+	if (!attrs)
+		return 0;
+
+	iter = pango_attr_list_get_iterator (attrs);
+	do {
+		size += TEXT_ATTR_SIZE;
+	} while (pango_attr_iterator_next (iter));
+	pango_attr_iterator_destroy (iter);
+
+	return size;
+}
+
+static gsize
+ev_page_cache_data_get_size (EvPageCacheData *data)
+{
+	gsize size = 0;
+
+	size += mapping_list_get_size (data->link_mapping);
+	size += mapping_list_get_size (data->image_mapping);
+	size += mapping_list_get_size (data->form_field_mapping);
+	size += mapping_list_get_size (data->annot_mapping);
+	size += mapping_list_get_size (data->media_mapping);
+	if (data->text_mapping)
+		size += cairo_region_num_rectangles (data->text_mapping) * sizeof (cairo_rectangle_int_t);
+	if (data->text)
+		size += strlen (data->text) + 1;
+	size += data->text_layout_length * sizeof (EvRectangle);
+	size += text_attrs_get_size (data->text_attrs);
+	size += data->text_log_attrs_length * sizeof (PangoLogAttr);
+
+	return size;
+}
+
+static gboolean
+ev_page_cache_page_is_evictable (EvPageCache *cache,
+				 gint         page)
+{
+	EvPageCacheData *data = &cache->page_list[page];
+
+	if (data->job || page == cache->kept_page)
+		return FALSE;
+
+	/* Preloaded pages can all be on the same side of the range */
+	return page < cache->start_page - PRE_CACHE_SIZE * 2 ||
+		page > cache->end_page + PRE_CACHE_SIZE * 2;
+}
+
+static void
+ev_page_cache_evict (EvPageCache *cache)
+{
+	GList *l = cache->lru.tail;
+
+	while (l && cache->size > cache->max_size) {
+		EvPageCacheData *data = l->data;
+		gint             page = data - cache->page_list;
+
+		l = l->prev;
+
+		if (!ev_page_cache_page_is_evictable (cache, page))
+			continue;
+
+		/* The data is rebuilt when the page is needed again */
+		g_queue_unlink (&cache->lru, &data->lru_link);
+		data->lru_link.data = NULL;
+		cache->size -= data->size;
+		data->size = 0;
+
+		ev_page_cache_data_free (data);
+		data->done = FALSE;
+		data->dirty = FALSE;
+		data->flags = EV_PAGE_DATA_INCLUDE_NONE;
+	}
+}
+
+/* Updates the size of the data of a page, and makes it the most recently used */
+static void
+ev_page_cache_update_page (EvPageCache     *cache,
+			   EvPageCacheData *data)
+{
+	cache->size -= data->size;
+	data->size = ev_page_cache_data_get_size (data);
+	cache->size += data->size;
+
+	if (data->lru_link.data)
+		g_queue_unlink (&cache->lru, &data->lru_link);
+	data->lru_link.data = data;
+	g_queue_push_head_link (&cache->lru, &data->lru_link);
+}
+
 EvPageCache *
 ev_page_cache_new (EvDocument *document)
 {
@@ -261,6 +390,103 @@ ev_page_cache_new (EvDocument *document)
 	return cache;
 }
 
+static void
+ev_page_cache_data_end_job (EvPageCache     *cache,
+			    EvPageCacheData *data)
+{
+	g_signal_handlers_disconnect_by_func (data->job,
+					      G_CALLBACK (job_page_data_finished_cb),
+					      cache);
+	g_signal_handlers_disconnect_by_func (data->job,
+					      G_CALLBACK (job_page_data_cancelled_cb),
+					      data);
+	ev_job_cancel (data->job);
+	g_clear_object (&data->job);
+}
+
+/* Switches to @document, a new version of the current document loaded
+ * from the same file. The data of the pages that didn't change is kept,
+ * except for forms, annotations and media that refer to objects of the
+ * previous document.
+ */
+void
+ev_page_cache_reload_document (EvPageCache *cache,
+			       EvDocument  *document)
+{
+	EvPageCacheData *page_list;
+	EvDocument      *previous;
+	GQueue           lru;
+	GList           *l, *prev;
+	gsize            size;
+	gint             n_pages;
+	gint             i;
+
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	previous = cache->document;
+	n_pages = ev_document_get_n_pages (document);
+	page_list = g_new0 (EvPageCacheData, n_pages);
+	g_queue_init (&lru);
+	size = 0;
+
+	/* Move the data of the unchanged pages, keeping the LRU order */
+	for (l = cache->lru.tail; l; l = prev) {
+		EvPageCacheData *data = l->data;
+		EvPageCacheData *new_data;
+		gint             page = data - cache->page_list;
+
+		prev = l->prev;
+		if (page >= n_pages ||
+		    !ev_document_page_is_unchanged (document, previous, page))
+			continue;
+
+		/* Running jobs fetch data from the previous document */
+		if (data->job) {
+			ev_page_cache_data_end_job (cache, data);
+			data->dirty = TRUE;
+		}
+
+		new_data = &page_list[page];
+		*new_data = *data;
+		memset (data, 0, sizeof (EvPageCacheData));
+
+		if (new_data->form_field_mapping || new_data->annot_mapping ||
+		    new_data->media_mapping) {
+			g_clear_pointer (&new_data->form_field_mapping, ev_mapping_list_unref);
+			g_clear_pointer (&new_data->annot_mapping, ev_mapping_list_unref);
+			g_clear_pointer (&new_data->media_mapping, ev_mapping_list_unref);
+			new_data->dirty = TRUE;
+			new_data->size = ev_page_cache_data_get_size (new_data);
+		}
+
+		new_data->lru_link.data = new_data;
+		new_data->lru_link.prev = new_data->lru_link.next = NULL;
+		g_queue_push_head_link (&lru, &new_data->lru_link);
+		size += new_data->size;
+	}
+
+	for (i = 0; i < cache->n_pages; i++) {
+		EvPageCacheData *data = &cache->page_list[i];
+
+		if (data->job)
+			ev_page_cache_data_end_job (cache, data);
+		ev_page_cache_data_free (data);
+	}
+	g_free (cache->page_list);
+
+	cache->lru = lru;
+	cache->size = size;
+	cache->document = g_object_ref (document);
+	g_object_unref (previous);
+	cache->page_list = page_list;
+	cache->n_pages = n_pages;
+	if (cache->kept_page >= n_pages)
+		cache->kept_page = -1;
+	cache->start_page = MIN (cache->start_page, n_pages - 1);
+	cache->end_page = MIN (cache->end_page, n_pages - 1);
+}
+
 static void
 job_page_data_finished_cb (EvJob       *job,
 			   EvPageCache *cache)
@@ -300,6 +526,9 @@ job_page_data_finished_cb (EvJob       *job,
 
 	g_clear_object (&data->job);
 
+	ev_page_cache_update_page (cache, data);
+	ev_page_cache_evict (cache);
+
         g_signal_emit (cache, ev_page_cache_signals[PAGE_CACHED], 0, job_data->page);
 }
 
@@ -348,8 +577,16 @@ ev_page_cache_set_page_range (EvPageCache *cache,
 	if (cache->flags == EV_PAGE_DATA_INCLUDE_NONE)
 		return;
 
-	for (i = start; i <= end; i++)
+	for (i = start; i <= end; i++) {
+		EvPageCacheData *data = &cache->page_list[i];
+
+		if (data->lru_link.data) {
+			g_queue_unlink (&cache->lru, &data->lru_link);
+			g_queue_push_head_link (&cache->lru, &data->lru_link);
+		}
+
 		ev_page_cache_schedule_job_if_needed (cache, i);
+	}
 
 	cache->start_page = start;
 	cache->end_page = end;
@@ -437,6 +674,9 @@ ev_page_cache_mark_dirty (EvPageCache       *cache,
                 data->text_log_attrs_length = 0;
         }
 
+	if (data->lru_link.data)
+		ev_page_cache_update_page (cache, data);
+
 	/* Update the current range */
 	ev_page_cache_set_page_range (cache, cache->start_page, cache->end_page);
 }
@@ -713,6 +953,25 @@ ev_page_cache_ensure_page (EvPageCache *cache,
         ev_page_cache_schedule_job_if_needed (cache, page);
 }
 
+/**
+ * ev_page_cache_keep_page:
+ * @cache: a #EvPageCache
+ * @page: a page index, or -1
+ *
+ * Prevents the data of @page from being evicted when it's not in the page
+ * range, because it's still in use. Only one page is kept at a time, use
+ * -1 to allow evicting the previously kept page again.
+ */
+void
+ev_page_cache_keep_page (EvPageCache *cache,
+			 gint         page)
+{
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+	g_return_if_fail (page >= -1 && page < cache->n_pages);
+
+	cache->kept_page = page;
+}
+
 gboolean
 ev_page_cache_is_page_cached (EvPageCache   *cache,
 			      gint           page)
@@ -42,6 +42,8 @@ typedef struct _EvPageCacheClass   EvPageCacheClass;
 
 GType              ev_page_cache_get_type               (void) G_GNUC_CONST;
 EvPageCache       *ev_page_cache_new                    (EvDocument        *document);
+void               ev_page_cache_reload_document        (EvPageCache       *cache,
+							 EvDocument        *document);
 
 void               ev_page_cache_set_page_range         (EvPageCache       *cache,
 							 gint               start,
@@ -78,6 +80,8 @@ gboolean           ev_page_cache_get_text_log_attrs     (EvPageCache       *cach
                                                          gulong            *n_attrs);
 void               ev_page_cache_ensure_page            (EvPageCache       *cache,
                                                          gint               page);
+void               ev_page_cache_keep_page              (EvPageCache       *cache,
+							 gint               page);
 gboolean           ev_page_cache_is_page_cached         (EvPageCache       *cache,
                                                          gint               page);
 G_END_DECLS
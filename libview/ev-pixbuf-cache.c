@@ -13,6 +13,9 @@ typedef struct _CacheJobInfo
 	EvJob *job;
 	gboolean page_ready;
 
+	/* Low resolution render shown while job is running */
+	EvJob *preview_job;
+
 	/* Region of the page that needs to be drawn */
 	cairo_region_t  *region;
 	GdkTexture *texture;
@@ -36,6 +39,25 @@ typedef struct _CacheJobInfo
 	EvRectangle     selection_region_points;
 } CacheJobInfo;
 
+/* Pages too large to be kept in a single texture are rendered in tiles
+ * of TILE_SIZE device pixels, see ev_pixbuf_cache_get_tiles().
+ */
+typedef struct _CacheTile
+{
+	EvPixbufCache *pixbuf_cache;
+	gint page;
+	gint column;
+	gint row;
+
+	EvJob *job;
+	GdkTexture *texture;
+	gsize size;
+
+	/* Value of tiles_stamp when the tile was last requested */
+	guint stamp;
+	GList *link;
+} CacheTile;
+
 struct _EvPixbufCache
 {
 	GObject parent;
@@ -60,6 +82,17 @@ struct _EvPixbufCache
 	CacheJobInfo *prev_job;
 	CacheJobInfo *job_list;
 	CacheJobInfo *next_job;
+
+	/* Tiles of all pages, rendered at tiles_scale and tiles_rotation.
+	 * tiles_lru has the most recently used tiles at its head.
+	 */
+	GHashTable *tiles;
+	GQueue      tiles_lru;
+	gsize       tiles_size;
+	guint       tiles_stamp;
+	gdouble     tiles_scale;
+	gint        tiles_rotation;
+	gint        tiles_device_scale;
 };
 
 struct _EvPixbufCacheClass
@@ -84,12 +117,22 @@ static void          ev_pixbuf_cache_finalize   (GObject            *object);
 static void          ev_pixbuf_cache_dispose    (GObject            *object);
 static void          job_finished_cb            (EvJob              *job,
 						 EvPixbufCache      *pixbuf_cache);
+static void          preview_job_finished_cb    (EvJob              *job,
+						 EvPixbufCache      *pixbuf_cache);
 static CacheJobInfo *find_job_cache             (EvPixbufCache      *pixbuf_cache,
 						 int                 page);
 static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cache,
 						  CacheJobInfo       *job_info,
 						  gint                page,
 						  gfloat              scale);
+static void          ev_pixbuf_cache_clear_tiles (EvPixbufCache      *pixbuf_cache);
+static void          ev_pixbuf_cache_clear_page_tiles (EvPixbufCache *pixbuf_cache,
+						       gint           page);
+static void          ev_pixbuf_cache_cancel_tile_jobs (EvPixbufCache *pixbuf_cache);
+static gboolean      page_needs_tiles           (EvPixbufCache      *pixbuf_cache,
+						 gint                page,
+						 gdouble             scale,
+						 gint                rotation);
 
 
 /* These are used for iterating through the prev and next arrays */
@@ -102,13 +145,43 @@ static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cac
 
 #define MAX_PRELOADED_PAGES 3
 
+/* Scale of the preview rendered first for pages without texture */
+#define PREVIEW_SCALE_FACTOR 0.25
+
+#define TILE_SIZE 512
+/* Number of tiles around the visible ones that are rendered in advance */
+#define TILE_MARGIN 1
+
 G_DEFINE_TYPE (EvPixbufCache, ev_pixbuf_cache, G_TYPE_OBJECT)
 
+static guint
+cache_tile_hash (gconstpointer key)
+{
+	const CacheTile *tile = key;
+
+	return (tile->page * 31 + tile->row) * 31 + tile->column;
+}
+
+static gboolean
+cache_tile_equal (gconstpointer a,
+		  gconstpointer b)
+{
+	const CacheTile *tile_a = a;
+	const CacheTile *tile_b = b;
+
+	return tile_a->page == tile_b->page &&
+		tile_a->row == tile_b->row &&
+		tile_a->column == tile_b->column;
+}
+
 static void
 ev_pixbuf_cache_init (EvPixbufCache *pixbuf_cache)
 {
 	pixbuf_cache->start_page = -1;
 	pixbuf_cache->end_page = -1;
+
+	pixbuf_cache->tiles = g_hash_table_new (cache_tile_hash, cache_tile_equal);
+	g_queue_init (&pixbuf_cache->tiles_lru);
 }
 
 static void
@@ -155,6 +228,7 @@ ev_pixbuf_cache_finalize (GObject *object)
 		pixbuf_cache->next_job = NULL;
 	}
 
+	g_hash_table_destroy (pixbuf_cache->tiles);
 	g_object_unref (pixbuf_cache->model);
 
 	G_OBJECT_CLASS (ev_pixbuf_cache_parent_class)->finalize (object);
@@ -171,6 +245,17 @@ end_job (CacheJobInfo *job_info,
 	g_clear_object (&job_info->job);
 }
 
+static void
+end_preview_job (CacheJobInfo *job_info,
+		 gpointer      data)
+{
+	g_signal_handlers_disconnect_by_func (job_info->preview_job,
+					      G_CALLBACK (preview_job_finished_cb),
+					      data);
+	ev_job_cancel (job_info->preview_job);
+	g_clear_object (&job_info->preview_job);
+}
+
 static void
 dispose_cache_job_info (CacheJobInfo *job_info,
 			gpointer      data)
@@ -180,6 +265,8 @@ dispose_cache_job_info (CacheJobInfo *job_info,
 
 	if (job_info->job)
 		end_job (job_info, data);
+	if (job_info->preview_job)
+		end_preview_job (job_info, data);
 
 	g_clear_object (&job_info->texture);
 	g_clear_object (&job_info->selection_texture);
@@ -206,6 +293,8 @@ ev_pixbuf_cache_dispose (GObject *object)
 		dispose_cache_job_info (pixbuf_cache->job_list + i, pixbuf_cache);
 	}
 
+	ev_pixbuf_cache_clear_tiles (pixbuf_cache);
+
 	G_OBJECT_CLASS (ev_pixbuf_cache_parent_class)->dispose (object);
 }
 
@@ -307,6 +396,8 @@ copy_job_to_job_info (EvJobRenderTexture *job_render,
 
 	if (job_info->job)
 		end_job (job_info, pixbuf_cache);
+	if (job_info->preview_job)
+		end_preview_job (job_info, pixbuf_cache);
 
 	job_info->page_ready = TRUE;
 }
@@ -336,6 +427,26 @@ job_finished_cb (EvJob         *job,
 	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, job_info->region);
 }
 
+static void
+preview_job_finished_cb (EvJob         *job,
+			 EvPixbufCache *pixbuf_cache)
+{
+	CacheJobInfo *job_info;
+	EvJobRenderTexture *job_render = EV_JOB_RENDER_TEXTURE (job);
+
+	job_info = find_job_cache (pixbuf_cache, job_render->page);
+	if (job_info == NULL || job_info->preview_job != job)
+		return;
+
+	/* The preview is only useful until the page is rendered */
+	if (!ev_job_is_failed (job) && job_info->job && !job_info->texture) {
+		job_info->texture = g_object_ref (job_render->texture);
+		g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, NULL);
+	}
+
+	end_preview_job (job_info, pixbuf_cache);
+}
+
 /* This checks a job to see if the job would generate the right sized pixbuf
  * given a scale.  If it won't, it removes the job and clears it to NULL.
  */
@@ -417,12 +528,17 @@ move_one_job (CacheJobInfo  *job_info,
 
 	*target_page = *job_info;
 	job_info->job = NULL;
+	job_info->preview_job = NULL;
 	job_info->region = NULL;
 	job_info->texture = NULL;
 
 	if (new_priority != priority && target_page->job) {
 		ev_job_scheduler_update_job (target_page->job, new_priority);
 	}
+
+	/* Previews are only rendered for visible pages */
+	if (new_priority != EV_JOB_PRIORITY_URGENT && target_page->preview_job)
+		end_preview_job (target_page, pixbuf_cache);
 }
 
 static gsize
@@ -432,11 +548,19 @@ ev_pixbuf_cache_get_page_size (EvPixbufCache *pixbuf_cache,
 			       gint           rotation)
 {
 	gint width, height;
+	gint stride;
 
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page_index, scale, rotation,
 					       &width, &height);
-	return height * cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
+
+	/* Pages at high zoom levels can't fit in a gint, or even in a
+	 * cairo surface */
+	stride = cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
+	if (stride < 0)
+		return G_MAXSIZE;
+
+	return (gsize) height * stride;
 }
 
 static gint
@@ -451,8 +575,11 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 	gint  i;
 	guint n_pages = ev_document_get_n_pages (pixbuf_cache->document);
 
-	/* Get the size of the current range */
+	/* Get the size of the current range. Tiled pages are accounted
+	 * for by the tiles cache. */
 	for (i = start_page; i <= end_page; i++) {
+		if (page_needs_tiles (pixbuf_cache, i, scale, rotation))
+			continue;
 		range_size += ev_pixbuf_cache_get_page_size (pixbuf_cache, i, scale, rotation);
 	}
 
@@ -468,7 +595,7 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 		if (end_page + i < n_pages) {
 			page_size = ev_pixbuf_cache_get_page_size (pixbuf_cache, end_page + i,
 								   scale, rotation);
-			if (page_size + range_size <= pixbuf_cache->max_size) {
+			if (page_size <= pixbuf_cache->max_size - range_size) {
 				range_size += page_size;
 				new_preload_cache_size++;
 				updated = TRUE;
@@ -480,7 +607,7 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 		if (start_page - i > 0) {
 			page_size = ev_pixbuf_cache_get_page_size (pixbuf_cache, start_page - i,
 								   scale, rotation);
-			if (page_size + range_size <= pixbuf_cache->max_size) {
+			if (page_size <= pixbuf_cache->max_size - range_size) {
 				range_size += page_size;
 				if (!updated)
 					new_preload_cache_size++;
@@ -681,6 +808,33 @@ add_job (EvPixbufCache  *pixbuf_cache,
 	ev_job_scheduler_push_job (job_info->job, priority);
 }
 
+static void
+add_preview_job (EvPixbufCache *pixbuf_cache,
+		 CacheJobInfo  *job_info,
+		 gint           page,
+		 gint           rotation,
+		 gfloat         scale)
+{
+	gint device_scale = get_device_scale (pixbuf_cache);
+	gint width, height;
+
+	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+					       page, scale * PREVIEW_SCALE_FACTOR, rotation,
+					       &width, &height);
+	if (width <= 0 || height <= 0)
+		return;
+
+	job_info->preview_job = ev_job_render_texture_new (pixbuf_cache->document,
+							   page, rotation,
+							   scale * PREVIEW_SCALE_FACTOR * device_scale,
+							   width * device_scale,
+							   height * device_scale);
+	g_signal_connect (job_info->preview_job, "finished",
+			  G_CALLBACK (preview_job_finished_cb),
+			  pixbuf_cache);
+	ev_job_scheduler_push_job (job_info->preview_job, EV_JOB_PRIORITY_URGENT);
+}
+
 static void
 add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		   CacheJobInfo  *job_info,
@@ -695,6 +849,10 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 	if (job_info->job)
 		return;
 
+	/* Tiles are requested when the page is drawn */
+	if (page_needs_tiles (pixbuf_cache, page, scale, rotation))
+		return;
+
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
@@ -711,6 +869,12 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		g_clear_object (&job_info->selection_texture);
 	}
 
+	/* Visible pages with nothing to show get a quick low resolution
+	 * render first, so that they are not blank while scrolling */
+	if (priority == EV_JOB_PRIORITY_URGENT &&
+	    !job_info->texture && !job_info->preview_job)
+		add_preview_job (pixbuf_cache, job_info, page, rotation, scale);
+
 	add_job (pixbuf_cache, job_info, NULL,
 		 width, height, page, rotation, scale,
 		 priority);
@@ -832,6 +996,9 @@ ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
 	/* Finally, we add the new jobs for all the sizes that don't have a
 	 * pixbuf */
 	ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache, rotation, scale);
+
+	/* Tiles of pages that are no longer visible won't be needed soon */
+	ev_pixbuf_cache_cancel_tile_jobs (pixbuf_cache);
 }
 
 GdkTexture *
@@ -921,6 +1088,76 @@ ev_pixbuf_cache_clear (EvPixbufCache *pixbuf_cache)
 	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
 		dispose_cache_job_info (pixbuf_cache->job_list + i, pixbuf_cache);
 	}
+
+	ev_pixbuf_cache_clear_tiles (pixbuf_cache);
+}
+
+static void
+reload_cache_job_info (EvPixbufCache *pixbuf_cache,
+		       CacheJobInfo  *job_info,
+		       gint           page,
+		       EvDocument    *previous)
+{
+	if (page < 0 ||
+	    !ev_document_page_is_unchanged (pixbuf_cache->document, previous, page)) {
+		dispose_cache_job_info (job_info, pixbuf_cache);
+		return;
+	}
+
+	/* Running jobs render the previous document */
+	if (job_info->job)
+		end_job (job_info, pixbuf_cache);
+	if (job_info->preview_job)
+		end_preview_job (job_info, pixbuf_cache);
+
+	g_clear_object (&job_info->selection_texture);
+	job_info->selection_points.x1 = -1;
+	g_clear_pointer (&job_info->selection_region, cairo_region_destroy);
+	job_info->selection_region_points.x1 = -1;
+}
+
+/* Switches to the document of the model, a new version of @previous
+ * loaded from the same file, keeping what was rendered for the pages
+ * that didn't change.
+ */
+void
+ev_pixbuf_cache_reload_document (EvPixbufCache *pixbuf_cache,
+				 EvDocument    *previous)
+{
+	GList *l;
+	int    i;
+
+	pixbuf_cache->document = ev_document_model_get_document (pixbuf_cache->model);
+
+	if (pixbuf_cache->job_list) {
+		for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+			reload_cache_job_info (pixbuf_cache, pixbuf_cache->prev_job + i,
+					       pixbuf_cache->start_page - pixbuf_cache->preload_cache_size + i,
+					       previous);
+			reload_cache_job_info (pixbuf_cache, pixbuf_cache->next_job + i,
+					       pixbuf_cache->end_page + 1 + i,
+					       previous);
+		}
+
+		for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
+			reload_cache_job_info (pixbuf_cache, pixbuf_cache->job_list + i,
+					       pixbuf_cache->start_page + i,
+					       previous);
+		}
+	}
+
+	l = pixbuf_cache->tiles_lru.head;
+	while (l) {
+		CacheTile *tile = l->data;
+
+		l = l->next;
+		if (!tile->job &&
+		    ev_document_page_is_unchanged (pixbuf_cache->document, previous, tile->page))
+			continue;
+
+		g_hash_table_remove (pixbuf_cache->tiles, tile);
+		cache_tile_free (tile);
+	}
 }
 
 
@@ -973,6 +1210,11 @@ ev_pixbuf_cache_get_selection_texture (EvPixbufCache   *pixbuf_cache,
 	if (!EV_IS_SELECTION (pixbuf_cache->document))
 		return NULL;
 
+	/* Tiled pages are too large for a selection texture, the
+	 * selection region is used instead */
+	if (ev_pixbuf_cache_page_is_tiled (pixbuf_cache, page))
+		return NULL;
+
 	job_info = find_job_cache (pixbuf_cache, page);
 	if (job_info == NULL)
 		return NULL;
@@ -1005,7 +1247,7 @@ ev_pixbuf_cache_get_selection_texture (EvPixbufCache   *pixbuf_cache,
 		cairo_surface_t *selection = NULL;
 
 		/* we need to get a new selection pixbuf */
-		ev_document_doc_mutex_lock ();
+		ev_document_reader_lock (pixbuf_cache->document);
 		if (job_info->selection_points.x1 < 0) {
 			g_assert (job_info->selection_texture == NULL);
 			old_points = NULL;
@@ -1037,7 +1279,7 @@ ev_pixbuf_cache_get_selection_texture (EvPixbufCache   *pixbuf_cache,
 		job_info->selection_texture = gdk_texture_new_for_surface (selection);
 		cairo_surface_destroy (selection);
 		g_object_unref (rc);
-		ev_document_doc_mutex_unlock ();
+		ev_document_reader_unlock (pixbuf_cache->document);
 	}
 	return job_info->selection_texture;
 }
@@ -1080,7 +1322,7 @@ ev_pixbuf_cache_get_selection_region (EvPixbufCache *pixbuf_cache,
 		EvPage *ev_page;
 		gint width, height;
 
-		ev_document_doc_mutex_lock ();
+		ev_document_reader_lock (pixbuf_cache->document);
 		ev_page = ev_document_get_page (pixbuf_cache->document, page);
 
 		_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
@@ -1100,7 +1342,7 @@ ev_pixbuf_cache_get_selection_region (EvPixbufCache *pixbuf_cache,
 		job_info->selection_region_points = job_info->target_points;
 		job_info->selection_region_scale = scale;
 		g_object_unref (rc);
-		ev_document_doc_mutex_unlock ();
+		ev_document_reader_unlock (pixbuf_cache->document);
 	}
 	return job_info->selection_region && !cairo_region_is_empty(job_info->selection_region) ?
                 job_info->selection_region : NULL;
@@ -1295,6 +1537,12 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 	if (job_info == NULL)
 		return;
 
+	if (page_needs_tiles (pixbuf_cache, page, scale, rotation)) {
+		ev_pixbuf_cache_clear_page_tiles (pixbuf_cache, page);
+		g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, region);
+		return;
+	}
+
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
@@ -1302,3 +1550,294 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 		 width, height, page, rotation, scale,
 		 EV_JOB_PRIORITY_URGENT);
 }
+
+/* Tiles */
+
+static gboolean
+page_needs_tiles (EvPixbufCache *pixbuf_cache,
+		  gint           page,
+		  gdouble        scale,
+		  gint           rotation)
+{
+	gint device_scale;
+
+	if (!ev_document_supports_clipped_render (pixbuf_cache->document))
+		return FALSE;
+
+	device_scale = get_device_scale (pixbuf_cache);
+
+	return ev_pixbuf_cache_get_page_size (pixbuf_cache, page,
+					      scale * device_scale,
+					      rotation) > pixbuf_cache->max_size / 2;
+}
+
+gboolean
+ev_pixbuf_cache_page_is_tiled (EvPixbufCache *pixbuf_cache,
+			       gint           page)
+{
+	g_return_val_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache), FALSE);
+
+	return page_needs_tiles (pixbuf_cache, page,
+				 ev_document_model_get_scale (pixbuf_cache->model),
+				 ev_document_model_get_rotation (pixbuf_cache->model));
+}
+
+static void
+tile_job_finished_cb (EvJob     *job,
+		      CacheTile *tile)
+{
+	EvPixbufCache      *pixbuf_cache = tile->pixbuf_cache;
+	EvJobRenderTexture *job_render = EV_JOB_RENDER_TEXTURE (job);
+
+	if (ev_job_is_failed (job) || !job_render->texture) {
+		g_clear_object (&tile->job);
+		return;
+	}
+
+	tile->texture = g_object_ref (job_render->texture);
+	tile->size = gdk_texture_get_height (tile->texture) *
+		cairo_format_stride_for_width (CAIRO_FORMAT_RGB24,
+					       gdk_texture_get_width (tile->texture));
+	pixbuf_cache->tiles_size += tile->size;
+	g_clear_object (&tile->job);
+
+	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, NULL);
+}
+
+static void
+cache_tile_end_job (CacheTile *tile)
+{
+	g_signal_handlers_disconnect_by_func (tile->job,
+					      G_CALLBACK (tile_job_finished_cb),
+					      tile);
+	ev_job_cancel (tile->job);
+	g_clear_object (&tile->job);
+}
+
+static void
+cache_tile_free (CacheTile *tile)
+{
+	EvPixbufCache *pixbuf_cache = tile->pixbuf_cache;
+
+	if (tile->job)
+		cache_tile_end_job (tile);
+
+	pixbuf_cache->tiles_size -= tile->size;
+	g_queue_delete_link (&pixbuf_cache->tiles_lru, tile->link);
+	g_clear_object (&tile->texture);
+	g_free (tile);
+}
+
+static void
+ev_pixbuf_cache_clear_tiles (EvPixbufCache *pixbuf_cache)
+{
+	while (!g_queue_is_empty (&pixbuf_cache->tiles_lru)) {
+		CacheTile *tile = g_queue_peek_tail (&pixbuf_cache->tiles_lru);
+
+		g_hash_table_remove (pixbuf_cache->tiles, tile);
+		cache_tile_free (tile);
+	}
+}
+
+static void
+ev_pixbuf_cache_clear_page_tiles (EvPixbufCache *pixbuf_cache,
+				  gint           page)
+{
+	GList *l = pixbuf_cache->tiles_lru.head;
+
+	while (l) {
+		CacheTile *tile = l->data;
+
+		l = l->next;
+		if (tile->page != page)
+			continue;
+
+		g_hash_table_remove (pixbuf_cache->tiles, tile);
+		cache_tile_free (tile);
+	}
+}
+
+static void
+ev_pixbuf_cache_cancel_tile_jobs (EvPixbufCache *pixbuf_cache)
+{
+	GList *l;
+
+	for (l = pixbuf_cache->tiles_lru.head; l; l = l->next) {
+		CacheTile *tile = l->data;
+
+		if (tile->job &&
+		    (tile->page < pixbuf_cache->start_page ||
+		     tile->page > pixbuf_cache->end_page))
+			cache_tile_end_job (tile);
+	}
+}
+
+/* Drops the least recently used tiles until the cache fits in max_size
+ * again. Tiles requested in the current call are never dropped.
+ */
+static void
+ev_pixbuf_cache_evict_tiles (EvPixbufCache *pixbuf_cache)
+{
+	while (pixbuf_cache->tiles_size > pixbuf_cache->max_size) {
+		CacheTile *tile = g_queue_peek_tail (&pixbuf_cache->tiles_lru);
+
+		if (!tile || tile->stamp == pixbuf_cache->tiles_stamp)
+			break;
+
+		g_hash_table_remove (pixbuf_cache->tiles, tile);
+		cache_tile_free (tile);
+	}
+}
+
+static CacheTile *
+ev_pixbuf_cache_lookup_tile (EvPixbufCache *pixbuf_cache,
+			     gint           page,
+			     gint           column,
+			     gint           row,
+			     gint           page_width,
+			     gint           page_height,
+			     EvJobPriority  priority)
+{
+	CacheTile             key = { NULL, page, column, row };
+	CacheTile            *tile;
+	cairo_rectangle_int_t clip;
+
+	tile = g_hash_table_lookup (pixbuf_cache->tiles, &key);
+	if (tile) {
+		g_queue_unlink (&pixbuf_cache->tiles_lru, tile->link);
+		g_queue_push_head_link (&pixbuf_cache->tiles_lru, tile->link);
+	} else {
+		tile = g_new0 (CacheTile, 1);
+		tile->pixbuf_cache = pixbuf_cache;
+		tile->page = page;
+		tile->column = column;
+		tile->row = row;
+		g_queue_push_head (&pixbuf_cache->tiles_lru, tile);
+		tile->link = pixbuf_cache->tiles_lru.head;
+		g_hash_table_add (pixbuf_cache->tiles, tile);
+	}
+
+	tile->stamp = pixbuf_cache->tiles_stamp;
+
+	if (tile->texture)
+		return tile;
+
+	if (tile->job) {
+		ev_job_scheduler_update_job (tile->job, priority);
+		return tile;
+	}
+
+	clip.x = column * TILE_SIZE;
+	clip.y = row * TILE_SIZE;
+	clip.width = MIN (TILE_SIZE, page_width - clip.x);
+	clip.height = MIN (TILE_SIZE, page_height - clip.y);
+
+	tile->job = ev_job_render_texture_new (pixbuf_cache->document,
+					       page,
+					       pixbuf_cache->tiles_rotation,
+					       pixbuf_cache->tiles_scale * pixbuf_cache->tiles_device_scale,
+					       page_width, page_height);
+	ev_job_render_texture_set_clip (EV_JOB_RENDER_TEXTURE (tile->job), &clip);
+	g_signal_connect (tile->job, "finished",
+			  G_CALLBACK (tile_job_finished_cb),
+			  tile);
+	ev_job_scheduler_push_job (tile->job, priority);
+
+	return tile;
+}
+
+/* Returns the rendered tiles of page covering area, the visible area of
+ * the page relative to its origin, and schedules rendering of the missing
+ * ones and of the tiles around area. complete is set to whether all the
+ * tiles covering area are rendered. The list must be freed with
+ * g_list_free_full (tiles, g_free); textures belong to the cache.
+ */
+GList *
+ev_pixbuf_cache_get_tiles (EvPixbufCache      *pixbuf_cache,
+			   gint                page,
+			   const GdkRectangle *area,
+			   gboolean           *complete)
+{
+	gdouble scale = ev_document_model_get_scale (pixbuf_cache->model);
+	gint    rotation = ev_document_model_get_rotation (pixbuf_cache->model);
+	gint    device_scale = get_device_scale (pixbuf_cache);
+	gint    width, height;
+	gint    n_columns, n_rows;
+	gint    first_column, last_column, first_row, last_row;
+	gint    column, row;
+	GList  *retval = NULL;
+
+	g_return_val_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache), NULL);
+
+	*complete = FALSE;
+
+	if (pixbuf_cache->tiles_scale != scale ||
+	    pixbuf_cache->tiles_rotation != rotation ||
+	    pixbuf_cache->tiles_device_scale != device_scale) {
+		ev_pixbuf_cache_clear_tiles (pixbuf_cache);
+		pixbuf_cache->tiles_scale = scale;
+		pixbuf_cache->tiles_rotation = rotation;
+		pixbuf_cache->tiles_device_scale = device_scale;
+	}
+
+	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+					       page, scale * device_scale, rotation,
+					       &width, &height);
+	if (width <= 0 || height <= 0)
+		return NULL;
+
+	n_columns = (width + TILE_SIZE - 1) / TILE_SIZE;
+	n_rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	first_column = CLAMP (area->x * device_scale / TILE_SIZE, 0, n_columns - 1);
+	last_column = CLAMP ((area->x + area->width) * device_scale / TILE_SIZE, 0, n_columns - 1);
+	first_row = CLAMP (area->y * device_scale / TILE_SIZE, 0, n_rows - 1);
+	last_row = CLAMP ((area->y + area->height) * device_scale / TILE_SIZE, 0, n_rows - 1);
+
+	pixbuf_cache->tiles_stamp++;
+
+	*complete = TRUE;
+	for (row = first_row; row <= last_row; row++) {
+		for (column = first_column; column <= last_column; column++) {
+			CacheTile         *tile;
+			EvPixbufCacheTile *cache_tile;
+
+			tile = ev_pixbuf_cache_lookup_tile (pixbuf_cache, page,
+							    column, row,
+							    width, height,
+							    EV_JOB_PRIORITY_URGENT);
+			if (!tile->texture) {
+				*complete = FALSE;
+				continue;
+			}
+
+			cache_tile = g_new (EvPixbufCacheTile, 1);
+			cache_tile->texture = tile->texture;
+			cache_tile->area = GRAPHENE_RECT_INIT ((gdouble) column * TILE_SIZE / device_scale,
+							       (gdouble) row * TILE_SIZE / device_scale,
+							       (gdouble) gdk_texture_get_width (tile->texture) / device_scale,
+							       (gdouble) gdk_texture_get_height (tile->texture) / device_scale);
+			retval = g_list_prepend (retval, cache_tile);
+		}
+	}
+
+	/* Render the tiles around the visible area in advance */
+	for (row = MAX (first_row - TILE_MARGIN, 0);
+	     row <= MIN (last_row + TILE_MARGIN, n_rows - 1); row++) {
+		for (column = MAX (first_column - TILE_MARGIN, 0);
+		     column <= MIN (last_column + TILE_MARGIN, n_columns - 1); column++) {
+			if (row >= first_row && row <= last_row &&
+			    column >= first_column && column <= last_column)
+				continue;
+
+			ev_pixbuf_cache_lookup_tile (pixbuf_cache, page,
+						     column, row,
+						     width, height,
+						     EV_JOB_PRIORITY_LOW);
+		}
+	}
+
+	ev_pixbuf_cache_evict_tiles (pixbuf_cache);
+
+	return g_list_reverse (retval);
+}
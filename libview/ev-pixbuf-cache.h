@@ -55,6 +55,16 @@ struct _EvViewSelection {
 typedef struct _EvPixbufCache       EvPixbufCache;
 typedef struct _EvPixbufCacheClass  EvPixbufCacheClass;
 
+/* A rendered part of a tiled page. The area is relative to the page
+ * origin, in widget coordinates.
+ */
+typedef struct _EvPixbufCacheTile EvPixbufCacheTile;
+
+struct _EvPixbufCacheTile {
+	GdkTexture     *texture;
+	graphene_rect_t area;
+};
+
 GType           ev_pixbuf_cache_get_type                (void) G_GNUC_CONST;
 EvPixbufCache  *ev_pixbuf_cache_new                     (GtkWidget       *view,
 						         EvDocumentModel *model,
@@ -68,12 +78,21 @@ void            ev_pixbuf_cache_set_page_range          (EvPixbufCache   *pixbuf
 GdkTexture     *ev_pixbuf_cache_get_texture             (EvPixbufCache   *pixbuf_cache,
 						         gint             page);
 void            ev_pixbuf_cache_clear                   (EvPixbufCache   *pixbuf_cache);
+void            ev_pixbuf_cache_reload_document         (EvPixbufCache   *pixbuf_cache,
+						         EvDocument      *previous);
 void            ev_pixbuf_cache_style_changed           (EvPixbufCache   *pixbuf_cache);
 void            ev_pixbuf_cache_reload_page 	        (EvPixbufCache   *pixbuf_cache,
                     				         cairo_region_t  *region,
                     				         gint             page,
 			                                 gint             rotation,
 						         gdouble          scale);
+/* Tiles */
+gboolean        ev_pixbuf_cache_page_is_tiled           (EvPixbufCache      *pixbuf_cache,
+						         gint                page);
+GList          *ev_pixbuf_cache_get_tiles               (EvPixbufCache      *pixbuf_cache,
+						         gint                page,
+						         const GdkRectangle *area,
+						         gboolean           *complete);
 /* Selection */
 GdkTexture     *ev_pixbuf_cache_get_selection_texture   (EvPixbufCache   *pixbuf_cache,
 							 gint             page,
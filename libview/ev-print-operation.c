@@ -746,7 +746,7 @@ export_print_inc_page (EvPrintOperationExport *export)
 				    (export->page_count - 1) % export->pages_per_sheet != 0) {
 
 					EvPrintOperation *op = EV_PRINT_OPERATION (export);
-					ev_document_doc_mutex_lock ();
+					ev_document_writer_lock (op->document);
 
 					/* keep track of all blanks but only actualise those
 					 * which are in the current odd / even sheet set */
@@ -757,7 +757,7 @@ export_print_inc_page (EvPrintOperationExport *export)
 						(export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1) ) {
 						ev_file_exporter_end_page (EV_FILE_EXPORTER (op->document));
 					}
-					ev_document_doc_mutex_unlock ();
+					ev_document_writer_unlock (op->document);
 					export->sheet = 1 + (export->page_count - 1) / export->pages_per_sheet;
 				}
 
@@ -879,9 +879,9 @@ export_job_finished (EvJobExport            *job,
 	   ( export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0 ) ||
 	   ( export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1 ) ) ) ) {
 
-		ev_document_doc_mutex_lock ();
+		ev_document_writer_lock (op->document);
 		ev_file_exporter_end_page (EV_FILE_EXPORTER (op->document));
-		ev_document_doc_mutex_unlock ();
+		ev_document_writer_unlock (op->document);
 	}
 
 	/* Reschedule */
@@ -957,9 +957,9 @@ export_print_page (EvPrintOperationExport *export)
 	if (export->collated == export->collated_copies) {
 		export->collated = 0;
 		if (!export_print_inc_page (export)) {
-			ev_document_doc_mutex_lock ();
+			ev_document_writer_lock (op->document);
 			ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
-			ev_document_doc_mutex_unlock ();
+			ev_document_writer_unlock (op->document);
 
 			update_progress (export);
 			export_print_done (export);
@@ -982,9 +982,9 @@ export_print_page (EvPrintOperationExport *export)
 				export->collated = 0;
 
 				if (!export_print_inc_page (export)) {
-					ev_document_doc_mutex_lock ();
+					ev_document_writer_lock (op->document);
 					ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
-					ev_document_doc_mutex_unlock ();
+					ev_document_writer_unlock (op->document);
 
 					update_progress (export);
 
@@ -1003,9 +1003,9 @@ export_print_page (EvPrintOperationExport *export)
 	    (export->page_set == GTK_PAGE_SET_ALL ||
 	    (export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0) ||
 	    (export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1)))) {
-		ev_document_doc_mutex_lock ();
+		ev_document_writer_lock (op->document);
 		ev_file_exporter_begin_page (EV_FILE_EXPORTER (op->document));
-		ev_document_doc_mutex_unlock ();
+		ev_document_writer_unlock (op->document);
 	}
 
 	if (!export->job_export) {
@@ -1034,9 +1034,9 @@ ev_print_operation_export_begin (EvPrintOperationExport *export)
 	if (!export->temp_file)
 		return; /* cancelled */
 
-	ev_document_doc_mutex_lock ();
+	ev_document_writer_lock (op->document);
 	ev_file_exporter_begin (EV_FILE_EXPORTER (op->document), &export->fc);
-	ev_document_doc_mutex_unlock ();
+	ev_document_writer_unlock (op->document);
 
 	export->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
 					   (GSourceFunc)export_print_page,
@@ -2453,7 +2453,7 @@ print_job_finished (EvJobPrint            *job,
 static gboolean
 draw_page_finish_idle (EvPrintOperationPrint *print)
 {
-        if (ev_job_scheduler_get_running_thread_job () == print->job_print)
+        if (ev_job_scheduler_is_job_running (print->job_print))
 		return G_SOURCE_CONTINUE;
 
         gtk_print_operation_draw_page_finish (print->op);
@@ -2470,7 +2470,7 @@ print_job_cancelled (EvJobPrint            *job,
          * print operation. If the job is still
          * running, wait until it finishes.
          */
-        if (ev_job_scheduler_get_running_thread_job () == print->job_print)
+        if (ev_job_scheduler_is_job_running (print->job_print))
                 g_idle_add ((GSourceFunc)draw_page_finish_idle, print);
         else
                 gtk_print_operation_draw_page_finish (print->op);
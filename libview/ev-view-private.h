@@ -140,11 +140,11 @@ typedef struct _EvViewPrivate {
 
 	/* Find */
 	EvJobFind *find_job;
-	GList **find_pages; /* Backwards compatibility. Contains EvFindRectangles's elements per page */
+	EvFindPageResults **find_pages; /* Results of find_job per page, owned by the job */
 	gint find_page;     /* Page of active find result */
 	gint find_result;   /* Index of active find result on find_pages[find_page]. For matches across
-	                     * two lines (which comprise two EvFindRectangle's), this will always point
-	                     * to the first one, i.e. the one where rect->next_line is TRUE */
+	                     * two lines (which comprise two results), this will always point
+	                     * to the first one, i.e. the one with EV_FIND_RESULT_NEXT_LINE set */
 	gboolean jump_to_find_result;
 	gboolean highlight_find_results;
 
@@ -153,6 +153,7 @@ typedef struct _EvViewPrivate {
 	gsize pixbuf_cache_size;
 	EvPageCache *page_cache;
 	EvHeightToPageCache *height_to_page_cache;
+	EvJob *page_sizes_job;
 	EvViewCursor cursor;
 
 	GtkRequisition requisition;
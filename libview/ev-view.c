@@ -95,6 +95,7 @@ typedef struct {
 } EvViewChild;
 
 #define MIN_SCALE 0.05409 /* large documents (comics) need a small value, see #702 */
+#define MAX_TILED_SCALE 16.0 /* pages rendered in tiles don't need to fit in the pixbuf cache */
 #define ZOOM_IN_FACTOR  1.2
 #define ZOOM_OUT_FACTOR (1.0/ZOOM_IN_FACTOR)
 
@@ -102,6 +103,7 @@ typedef struct {
 #define SCROLL_PAGE_THRESHOLD 0.7
 
 #define DEFAULT_PIXBUF_CACHE_SIZE 52428800 /* 50MB */
+#define PAGE_SIZES_CHUNK 64 /* pages measured by each page sizes job */
 
 #define EV_STYLE_CLASS_DOCUMENT_PAGE "document-page"
 #define EV_STYLE_CLASS_INVERTED      "inverted"
@@ -125,6 +127,11 @@ static void       get_page_y_offset                          (EvView
 							      int                 page,
 							      int                *y_offset,
 							      GtkBorder          *border);
+static void       get_page_row_at_y                          (EvView             *view,
+							      gint                y,
+							      GtkBorder          *border,
+							      gint               *first,
+							      gint               *last);
 static void       find_page_at_location                      (EvView             *view,
 							      gdouble             x,
 							      gdouble             y,
@@ -695,8 +702,8 @@ view_update_range_and_current_page (EvView *view)
 		gboolean found = FALSE;
 		gint area_max = -1, area;
 		gint best_current_page = -1;
-		gint n_pages;
-		int i, j = 0;
+		gint first, last, unused_page;
+		int i;
 
 		if (!(priv->vadjustment && priv->hadjustment))
 			return;
@@ -706,9 +713,15 @@ view_update_range_and_current_page (EvView *view)
 		current_area.y = gtk_adjustment_get_value (priv->vadjustment);
 		current_area.height = gtk_adjustment_get_page_size (priv->vadjustment);
 
-		n_pages = ev_document_get_n_pages (priv->document);
 		compute_border (view, &border);
-		for (i = 0; i < n_pages; i++) {
+
+		/* Only the pages between the row at the top of the visible
+		 * area and the one at its bottom can be visible */
+		get_page_row_at_y (view, current_area.y, &border, &first, &unused_page);
+		get_page_row_at_y (view, current_area.y + current_area.height, &border,
+				   &unused_page, &last);
+
+		for (i = first; i <= last; i++) {
 
 			ev_view_get_page_extents_for_border (view, i, &border, &page_area);
 
@@ -727,16 +740,6 @@ view_update_range_and_current_page (EvView *view)
 				}
 
 				priv->end_page = i;
-				j = 0;
-			} else if (found && priv->current_page <= priv->end_page) {
-				if (is_dual_page (view, NULL) && j < 1) {
-					/* In dual mode  we stop searching
-					 * after two consecutive non-visible pages.
-					 */
-					j++;
-					continue;
-				}
-				break;
 			}
 		}
 
@@ -800,7 +803,8 @@ view_update_range_and_current_page (EvView *view)
 						   priv->end_page);
 #endif
 
-	if (ev_pixbuf_cache_get_texture (priv->pixbuf_cache, priv->current_page))
+	if (ev_pixbuf_cache_get_texture (priv->pixbuf_cache, priv->current_page) ||
+	    ev_pixbuf_cache_page_is_tiled (priv->pixbuf_cache, priv->current_page))
 		gtk_widget_queue_draw (GTK_WIDGET (view));
 }
 
@@ -911,11 +915,11 @@ compute_scroll_increment (EvView        *view,
 		doc_rect.x1 = doc_rect.x2 = rect.x + 0.5;
 		doc_rect.y1 = doc_rect.y2 = rect.y + 0.5;
 
-		ev_document_doc_mutex_lock ();
+		ev_document_reader_lock (priv->document);
 		sel_region = ev_selection_get_selection_region (EV_SELECTION (priv->document),
 								rc, EV_SELECTION_STYLE_LINE,
 								&doc_rect);
-		ev_document_doc_mutex_unlock ();
+		ev_document_reader_unlock (priv->document);
 
 		g_object_unref (rc);
 
@@ -1204,6 +1208,52 @@ get_page_y_offset (EvView *view, int page, int *y_offset, GtkBorder *border)
 	return;
 }
 
+/* Returns in first and last the pages of the row of the continuous
+ * layout at y, that is the last row starting above y. Rows hold one or
+ * two pages depending on dual mode. Page offsets come from the height to
+ * page cache, so this is a binary search.
+ */
+static void
+get_page_row_at_y (EvView    *view,
+		   gint       y,
+		   GtkBorder *border,
+		   gint      *first,
+		   gint      *last)
+{
+	EvViewPrivate *priv = GET_PRIVATE (view);
+	gint n_pages = ev_document_get_n_pages (priv->document);
+	gint low = 0, high = n_pages - 1;
+	gint offset, row_offset;
+
+	while (low < high) {
+		gint mid = low + (high - low + 1) / 2;
+
+		get_page_y_offset (view, mid, &offset, border);
+		if (offset <= y)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	get_page_y_offset (view, low, &row_offset, border);
+
+	*first = low;
+	while (*first > 0) {
+		get_page_y_offset (view, *first - 1, &offset, border);
+		if (offset != row_offset)
+			break;
+		(*first)--;
+	}
+
+	*last = low;
+	while (*last < n_pages - 1) {
+		get_page_y_offset (view, *last + 1, &offset, border);
+		if (offset != row_offset)
+			break;
+		(*last)++;
+	}
+}
+
 gboolean
 ev_view_get_page_extents_for_border (EvView       *view,
 				     gint          page,
@@ -1545,7 +1595,7 @@ find_page_at_location (EvView  *view,
 		       gint    *y_offset)
 {
 	EvViewPrivate *priv = GET_PRIVATE (view);
-	int i;
+	int i, first, last;
 	GtkBorder border;
 
 	if (priv->document == NULL)
@@ -1556,7 +1606,13 @@ find_page_at_location (EvView  *view,
 	g_assert (y_offset);
 
 	compute_border (view, &border);
-	for (i = priv->start_page; i >= 0 && i <= priv->end_page; i++) {
+
+	first = priv->start_page;
+	last = priv->end_page;
+	if (priv->continuous && first >= 0)
+		get_page_row_at_y (view, y, &border, &first, &last);
+
+	for (i = first; i >= 0 && i <= last; i++) {
 		GdkRectangle page_area;
 
 		if (! ev_view_get_page_extents_for_border (view, i, &border, &page_area))
@@ -2454,6 +2510,8 @@ _ev_view_set_focused_element (EvView *view,
 
 	priv->focused_element = element_mapping;
 	priv->focused_element_page = page;
+	if (priv->page_cache)
+		ev_page_cache_keep_page (priv->page_cache, element_mapping ? page : -1);
 
 	if (ev_view_get_focused_area (view, &view_rect)) {
 		if (!region)
@@ -3288,10 +3346,10 @@ ev_view_annotation_save_contents (EvView       *view,
 	if (!priv->document)
 		return;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_writer_lock (priv->document);
 	ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (priv->document),
 						 annot, EV_ANNOTATIONS_SAVE_CONTENTS);
-	ev_document_doc_mutex_unlock ();
+	ev_document_writer_unlock (priv->document);
 	g_signal_emit (view, signals[SIGNAL_ANNOT_CHANGED], 0, annot);
 }
 
@@ -3602,7 +3660,7 @@ ev_view_create_annotation_real (EvView *view,
 	GdkRectangle    view_rect;
 	cairo_region_t *region;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_writer_lock (priv->document);
 	page = ev_document_get_page (priv->document, annot_page);
         switch (priv->adding_annot_info.type) {
         case EV_ANNOTATION_TYPE_TEXT:
@@ -3622,7 +3680,7 @@ ev_view_create_annotation_real (EvView *view,
 	case EV_ANNOTATION_TYPE_ATTACHMENT:
 		/* TODO */
 		g_object_unref (page);
-		ev_document_doc_mutex_unlock ();
+		ev_document_writer_unlock (priv->document);
 		return;
 	default:
 		g_assert_not_reached ();
@@ -3650,7 +3708,7 @@ ev_view_create_annotation_real (EvView *view,
 						annot, &doc_rect);
 	/* Re-fetch area as eg. adding Text Markup annots updates area for its bounding box */
 	ev_annotation_get_area (annot, &doc_rect);
-	ev_document_doc_mutex_unlock ();
+	ev_document_writer_unlock (priv->document);
 
 	/* If the page didn't have annots, mark the cache as dirty */
 	if (!ev_page_cache_get_annot_mapping (priv->page_cache, annot_page))
@@ -3793,10 +3851,10 @@ ev_view_cancel_add_annotation (EvView *view)
 
 	if (priv->adding_annot_info.annot && priv->pressed_button == GDK_BUTTON_PRIMARY) {
 		annot_page = ev_annotation_get_page_index (priv->adding_annot_info.annot);
-		ev_document_doc_mutex_lock ();
+		ev_document_writer_lock (priv->document);
 		ev_document_annotations_remove_annotation (EV_DOCUMENT_ANNOTATIONS (priv->document),
 							   priv->adding_annot_info.annot);
-		ev_document_doc_mutex_unlock ();
+		ev_document_writer_unlock (priv->document);
 		ev_page_cache_mark_dirty (priv->page_cache, annot_page, EV_PAGE_DATA_INCLUDE_ANNOTS);
 		priv->adding_annot_info.annot = NULL;
 		priv->pressed_button = -1;
@@ -3830,10 +3888,10 @@ ev_view_remove_annotation (EvView       *view,
 
         _ev_view_set_focused_element (view, NULL, -1);
 
-        ev_document_doc_mutex_lock ();
+        ev_document_writer_lock (priv->document);
         ev_document_annotations_remove_annotation (EV_DOCUMENT_ANNOTATIONS (priv->document),
                                                    annot);
-        ev_document_doc_mutex_unlock ();
+        ev_document_writer_unlock (priv->document);
 
         ev_page_cache_mark_dirty (priv->page_cache, page, EV_PAGE_DATA_INCLUDE_ANNOTS);
 
@@ -5820,9 +5878,9 @@ drag_prepare_cb (GtkDragSource	*self,
 
 	if (!location_in_text (view, x + priv->scroll_x, y + priv->scroll_y) &&
 				   (image = ev_view_get_image_at_location (view, x, y))) {
-		ev_document_doc_mutex_lock ();
+		ev_document_reader_lock (priv->document);
 		pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (priv->document), image);
-		ev_document_doc_mutex_unlock ();
+		ev_document_reader_unlock (priv->document);
 
 		tmp_uri = ev_image_save_tmp (image, pixbuf);
 		file = g_file_new_for_uri (tmp_uri);
@@ -5961,13 +6019,13 @@ ev_view_motion_notify_event (GtkEventControllerMotion	*self,
 
 			/* Take the mutex before set_area, because the notify signal
 			 * updates the mappings in the backend */
-			ev_document_doc_mutex_lock ();
+			ev_document_writer_lock (priv->document);
 			if (ev_annotation_set_area (priv->adding_annot_info.annot, &rect)) {
 				ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (priv->document),
 									 priv->adding_annot_info.annot,
 									 EV_ANNOTATIONS_SAVE_AREA);
 			}
-			ev_document_doc_mutex_unlock ();
+			ev_document_writer_unlock (priv->document);
 
 
 			/* FIXME: reload only annotation area */
@@ -6025,13 +6083,13 @@ ev_view_motion_notify_event (GtkEventControllerMotion	*self,
 
 			/* Take the mutex before set_area, because the notify signal
 			 * updates the mappings in the backend */
-			ev_document_doc_mutex_lock ();
+			ev_document_writer_lock (priv->document);
 			if (ev_annotation_set_area (priv->moving_annot_info.annot, &rect)) {
 				ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (priv->document),
 									 priv->moving_annot_info.annot,
 									 EV_ANNOTATIONS_SAVE_AREA);
 			}
-			ev_document_doc_mutex_unlock ();
+			ev_document_writer_unlock (priv->document);
 
 			/* FIXME: reload only annotation area */
 			ev_view_reload_page (view, annot_page, NULL);
@@ -6242,10 +6300,10 @@ ev_view_button_release_event(GtkGestureClick		*self,
 				/* Do not create empty annots */
 				annot_added = FALSE;
 
-				ev_document_doc_mutex_lock ();
+				ev_document_writer_lock (priv->document);
 				ev_document_annotations_remove_annotation (EV_DOCUMENT_ANNOTATIONS (priv->document),
 									   priv->adding_annot_info.annot);
-				ev_document_doc_mutex_unlock ();
+				ev_document_writer_unlock (priv->document);
 
 				ev_page_cache_mark_dirty (priv->page_cache,
 							  ev_annotation_get_page_index (priv->adding_annot_info.annot),
@@ -6258,11 +6316,11 @@ ev_view_button_release_event(GtkGestureClick		*self,
 
 				if (ev_annotation_markup_set_rectangle (EV_ANNOTATION_MARKUP (priv->adding_annot_info.annot),
 									&popup_rect)) {
-					ev_document_doc_mutex_lock ();
+					ev_document_writer_lock (priv->document);
 					ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (priv->document),
 										 priv->adding_annot_info.annot,
 										 EV_ANNOTATIONS_SAVE_POPUP_RECT);
-					ev_document_doc_mutex_unlock ();
+					ev_document_writer_unlock (priv->document);
 				}
 			}
 		}
@@ -6714,7 +6772,7 @@ cursor_clear_selection (EvView  *view,
 		EvRenderContext *rc;
 		EvPage          *page;
 
-		ev_document_doc_mutex_lock ();
+		ev_document_reader_lock (priv->document);
 
 		page = ev_document_get_page (priv->document, selection->page);
 		rc = ev_render_context_new (page, priv->rotation, priv->scale);
@@ -6726,7 +6784,7 @@ cursor_clear_selection (EvView  *view,
 								&(selection->rect));
 		g_object_unref (rc);
 
-		ev_document_doc_mutex_unlock();
+		ev_document_reader_unlock (priv->document);
 
 		if (!tmp_region || cairo_region_is_empty (tmp_region)) {
 			cairo_region_destroy (tmp_region);
@@ -7171,42 +7229,30 @@ highlight_find_results (EvView		*view,
                         GtkSnapshot	*snapshot,
                         int		 page)
 {
-	EvRectangle *ev_rect;
-	gint i, n_results = 0;
+	const EvFindPageResults *results;
+	guint i;
 	EvViewPrivate *priv = GET_PRIVATE (view);
 
-	n_results = ev_view_find_get_n_results (view, page);
-	ev_rect = ev_rectangle_new ();
+	results = priv->find_pages[page];
+	if (!results)
+		return;
 
-	for (i = 0; i < n_results; i++) {
-		EvFindRectangle *find_rect;
+	for (i = 0; i < results->n_results; i++) {
 		GdkRectangle view_rectangle;
 		gboolean active;
 
-		find_rect = ev_view_find_get_result (view, page, i);
-		ev_rect->x1 = find_rect->x1;
-		ev_rect->x2 = find_rect->x2;
-		ev_rect->y1 = find_rect->y1;
-		ev_rect->y2 = find_rect->y2;
-
-		active = page == priv->find_page && i == priv->find_result;
-		_ev_view_transform_doc_rect_to_view_rect (view, page, ev_rect, &view_rectangle);
+		active = page == priv->find_page && i == (guint)priv->find_result;
+		_ev_view_transform_doc_rect_to_view_rect (view, page, &results->areas[i], &view_rectangle);
 		draw_rubberband (view, snapshot, &view_rectangle, active);
 
-		if (active && find_rect->next_line) {
+		if (active && (results->flags[i] & EV_FIND_RESULT_NEXT_LINE) &&
+		    i + 1 < results->n_results) {
 			/* Draw now next result (which is second part of multi-line match) */
 			i++;
-			find_rect = ev_view_find_get_result (view, page, i);
-			ev_rect->x1 = find_rect->x1;
-			ev_rect->x2 = find_rect->x2;
-			ev_rect->y1 = find_rect->y1;
-			ev_rect->y2 = find_rect->y2;
-			_ev_view_transform_doc_rect_to_view_rect (view, page, ev_rect, &view_rectangle);
+			_ev_view_transform_doc_rect_to_view_rect (view, page, &results->areas[i], &view_rectangle);
 			draw_rubberband (view, snapshot, &view_rectangle, TRUE);
 		}
         }
-
-	ev_rectangle_free (ev_rect);
 }
 
 static void
@@ -7325,6 +7371,55 @@ draw_selection_region (GtkSnapshot    *snapshot,
 	gtk_style_context_restore (context);
 }
 
+/* Returns whether anything was drawn for page, complete is set to
+ * whether all its visible tiles are rendered */
+static gboolean
+draw_page_tiles (EvView       *view,
+		 gint          page,
+		 GtkSnapshot  *snapshot,
+		 GdkRectangle *real_page_area,
+		 GdkRectangle *overlap,
+		 gboolean      inverted,
+		 gboolean     *complete)
+{
+	EvViewPrivate   *priv = GET_PRIVATE (view);
+	GdkTexture      *page_texture;
+	GdkRectangle     visible;
+	graphene_point_t point;
+	GList           *tiles, *l;
+	gboolean         drawn;
+	gint             width, height;
+
+	visible.x = overlap->x - real_page_area->x;
+	visible.y = overlap->y - real_page_area->y;
+	visible.width = overlap->width;
+	visible.height = overlap->height;
+
+	point = GRAPHENE_POINT_INIT (real_page_area->x, real_page_area->y);
+
+	/* A texture rendered at a previous scale, if any, is drawn
+	 * below the tiles until they are ready */
+	page_texture = ev_pixbuf_cache_get_texture (priv->pixbuf_cache, page);
+	if (page_texture) {
+		graphene_rect_t area;
+
+		ev_view_get_page_size (view, page, &width, &height);
+		area = GRAPHENE_RECT_INIT (0, 0, width, height);
+		draw_surface (snapshot, page_texture, &point, &area, inverted);
+	}
+
+	tiles = ev_pixbuf_cache_get_tiles (priv->pixbuf_cache, page, &visible, complete);
+	drawn = tiles != NULL;
+	for (l = tiles; l; l = g_list_next (l)) {
+		EvPixbufCacheTile *tile = l->data;
+
+		draw_surface (snapshot, tile->texture, &point, &tile->area, inverted);
+	}
+	g_list_free_full (tiles, g_free);
+
+	return drawn || page_texture != NULL;
+}
+
 static void
 draw_one_page (EvView       *view,
 	       gint          page,
@@ -7375,10 +7470,23 @@ draw_one_page (EvView       *view,
 		graphene_rect_t area;
 		cairo_region_t *region = NULL;
 		gboolean inverted = ev_document_model_get_inverted_colors (priv->model);
+		gboolean tiled = ev_pixbuf_cache_page_is_tiled (priv->pixbuf_cache, page);
+		gboolean complete = TRUE;
+
+		if (tiled) {
+			if (!draw_page_tiles (view, page, snapshot, &real_page_area, &overlap, inverted, &complete)) {
+				if (page == current_page)
+					ev_view_set_loading (view, TRUE);
 
-		page_texture = ev_pixbuf_cache_get_texture (priv->pixbuf_cache, page);
+				*page_ready = FALSE;
 
-		if (!page_texture) {
+				return;
+			}
+		} else {
+			page_texture = ev_pixbuf_cache_get_texture (priv->pixbuf_cache, page);
+		}
+
+		if (!tiled && !page_texture) {
 			if (page == current_page)
 				ev_view_set_loading (view, TRUE);
 
@@ -7387,8 +7495,13 @@ draw_one_page (EvView       *view,
 			return;
 		}
 
+		/* Some visible tiles are still missing, only a part of the
+		 * page or a preview at a previous scale is drawn */
+		if (!complete)
+			*page_ready = FALSE;
+
 		if (page == current_page)
-			ev_view_set_loading (view, FALSE);
+			ev_view_set_loading (view, !complete);
 
 		ev_view_get_page_size (view, page, &width, &height);
 
@@ -7397,7 +7510,8 @@ draw_one_page (EvView       *view,
 					   width, height);
 		point = GRAPHENE_POINT_INIT (overlap.x, overlap.y);
 
-		draw_surface (snapshot, page_texture, &point, &area, inverted);
+		if (!tiled)
+			draw_surface (snapshot, page_texture, &point, &area, inverted);
 
 		/* Get the selection pixbuf iff we have something to draw */
 		if (!find_selection_for_page (view, page))
@@ -7418,8 +7532,12 @@ draw_one_page (EvView       *view,
 			double scale_x, scale_y;
 			GdkRGBA color;
 
-			scale_x = (gdouble)width / gdk_texture_get_width (page_texture);
-			scale_y = (gdouble)height / gdk_texture_get_height (page_texture);
+			if (tiled) {
+				scale_x = scale_y = 1.0;
+			} else {
+				scale_x = (gdouble)width / gdk_texture_get_width (page_texture);
+				scale_y = (gdouble)height / gdk_texture_get_height (page_texture);
+			}
 
 			_ev_view_get_selection_colors (view, &color, NULL);
 			draw_selection_region (snapshot, widget, region, &color, real_page_area.x, real_page_area.y,
@@ -7458,6 +7576,7 @@ ev_view_dispose (GObject *object)
 		g_clear_object (&priv->model);
 	}
 
+	ev_view_cancel_page_sizes (view);
 	g_clear_object (&priv->pixbuf_cache);
 	g_clear_object (&priv->document);
 	g_clear_object (&priv->page_cache);
@@ -7579,6 +7698,8 @@ view_update_scale_limits (EvView *view)
 	width = (rotation == 0 || rotation == 180) ? min_width : min_height;
 	height = (rotation == 0 || rotation == 180) ? min_height : min_width;
 	max_scale = sqrt (priv->pixbuf_cache_size / (width * dpi * 4 * height * dpi));
+	if (ev_document_supports_clipped_render (priv->document))
+		max_scale = MAX (max_scale, MAX_TILED_SCALE);
 
 	ev_document_model_set_min_scale (priv->model, MIN_SCALE * dpi);
 	ev_document_model_set_max_scale (priv->model, max_scale * dpi);
@@ -8348,10 +8469,83 @@ setup_caches (EvView *view)
 	g_signal_connect (priv->pixbuf_cache, "job-finished", G_CALLBACK (job_finished_cb), view);
 }
 
+static void page_sizes_job_updated_cb  (EvJobPageSizes *job,
+					EvView         *view);
+static void page_sizes_job_finished_cb (EvJob          *job,
+					EvView         *view);
+
+/* Documents loaded with a lazy cache only know the size of their first
+ * page, the others are measured in the background starting around the
+ * current page.
+ */
+static void
+ev_view_fill_page_sizes (EvView *view)
+{
+	EvViewPrivate *priv = GET_PRIVATE (view);
+	gint start_page;
+
+	if (priv->page_sizes_job || ev_document_is_cache_complete (priv->document))
+		return;
+
+	start_page = MAX (ev_document_model_get_page (priv->model) - PAGE_SIZES_CHUNK / 2, 0);
+	priv->page_sizes_job = ev_job_page_sizes_new (priv->document, start_page,
+						      PAGE_SIZES_CHUNK);
+	g_signal_connect (priv->page_sizes_job, "updated",
+			  G_CALLBACK (page_sizes_job_updated_cb),
+			  view);
+	g_signal_connect (priv->page_sizes_job, "finished",
+			  G_CALLBACK (page_sizes_job_finished_cb),
+			  view);
+	ev_job_scheduler_push_job (priv->page_sizes_job, EV_JOB_PRIORITY_LOW);
+}
+
+static void
+ev_view_cancel_page_sizes (EvView *view)
+{
+	EvViewPrivate *priv = GET_PRIVATE (view);
+
+	if (!priv->page_sizes_job)
+		return;
+
+	g_signal_handlers_disconnect_by_data (priv->page_sizes_job, view);
+	ev_job_cancel (priv->page_sizes_job);
+	g_clear_object (&priv->page_sizes_job);
+}
+
+/* Estimated sizes became exact, relayout keeping the current page */
+static void
+page_sizes_job_updated_cb (EvJobPageSizes *job,
+			   EvView         *view)
+{
+	EvViewPrivate *priv = GET_PRIVATE (view);
+
+	if (priv->height_to_page_cache)
+		ev_view_build_height_to_page_cache (view, priv->height_to_page_cache);
+	priv->pending_scroll = SCROLL_TO_PAGE_POSITION;
+	view_update_scale_limits (view);
+	gtk_widget_queue_resize (GTK_WIDGET (view));
+}
+
+static void
+page_sizes_job_finished_cb (EvJob  *job,
+			    EvView *view)
+{
+	EvViewPrivate *priv = GET_PRIVATE (view);
+
+	/* The last "updated" may still be pending */
+	g_signal_handlers_disconnect_by_data (job, view);
+	if (g_atomic_int_get (&EV_JOB_PAGE_SIZES (job)->update_pending))
+		page_sizes_job_updated_cb (EV_JOB_PAGE_SIZES (job), view);
+
+	g_clear_object (&priv->page_sizes_job);
+	ev_view_fill_page_sizes (view);
+}
+
 static void
 clear_caches (EvView *view)
 {
 	EvViewPrivate *priv = GET_PRIVATE (view);
+	ev_view_cancel_page_sizes (view);
 	g_clear_object (&priv->pixbuf_cache);
 	g_clear_object (&priv->page_cache);
 }
@@ -8444,16 +8638,32 @@ ev_view_document_changed_cb (EvDocumentModel *model,
 	EvViewPrivate *priv = GET_PRIVATE (view);
 
 	if (document != priv->document) {
+		EvDocument *previous = priv->document;
+		gboolean    reload;
 		gint current_page;
 
-		ev_view_remove_all (view);
-		clear_caches (view);
+		/* A new version of the same file when the document is
+		 * reloaded, what was cached for the pages that didn't
+		 * change is kept
+		 */
+		reload = previous && document && priv->pixbuf_cache &&
+			ev_document_get_page_fingerprint (previous, 0) &&
+			ev_document_get_page_fingerprint (document, 0) &&
+			ev_document_check_dimensions (document);
 
-		if (priv->document) {
-			g_object_unref (priv->document);
-                }
+		ev_view_remove_all (view);
+		if (reload) {
+			ev_view_cancel_page_sizes (view);
+			priv->document = g_object_ref (document);
+			priv->height_to_page_cache = ev_view_get_height_to_page_cache (view);
+			ev_pixbuf_cache_reload_document (priv->pixbuf_cache, previous);
+			ev_page_cache_reload_document (priv->page_cache, document);
+		} else {
+			clear_caches (view);
+			priv->document = document ? g_object_ref (document) : NULL;
+		}
 
-		priv->document = document ? g_object_ref (document) : NULL;
+		g_clear_object (&previous);
 		priv->find_page = -1;
 		priv->find_result = 0;
 
@@ -8463,7 +8673,9 @@ ev_view_document_changed_cb (EvDocumentModel *model,
 				return;
 
 			ev_view_set_loading (view, FALSE);
-			setup_caches (view);
+			if (!reload)
+				setup_caches (view);
+			ev_view_fill_page_sizes (view);
 
 			if (priv->caret_enabled)
 				preload_pages_for_caret_navigation (view);
@@ -9111,15 +9323,21 @@ ev_view_find_get_n_results (EvView *view, gint page)
 {
 	EvViewPrivate *priv = GET_PRIVATE (view);
 
-	return priv->find_pages ? g_list_length (priv->find_pages[page]) : 0;
+	if (!priv->find_pages || !priv->find_pages[page])
+		return 0;
+
+	return priv->find_pages[page]->n_results;
 }
 
-static EvFindRectangle *
+static EvRectangle *
 ev_view_find_get_result (EvView *view, gint page, gint result)
 {
 	EvViewPrivate *priv = GET_PRIVATE (view);
 
-	return priv->find_pages ? (EvFindRectangle *) g_list_nth_data (priv->find_pages[page], result) : NULL;
+	if (result < 0 || result >= ev_view_find_get_n_results (view, page))
+		return NULL;
+
+	return &priv->find_pages[page]->areas[result];
 }
 
 static gboolean
@@ -9127,11 +9345,10 @@ ev_view_find_is_next_line (EvView *view, gint page, gint result)
 {
 	EvViewPrivate *priv = GET_PRIVATE (view);
 
-	if (!priv->find_pages)
+	if (result < 0 || result >= ev_view_find_get_n_results (view, page))
 		return FALSE;
 
-	GList *elem = g_list_nth (priv->find_pages[page], result);
-	return elem && ((EvFindRectangle *) elem->data)->next_line;
+	return (priv->find_pages[page]->flags[result] & EV_FIND_RESULT_NEXT_LINE) != 0;
 }
 
 static void
@@ -9146,12 +9363,13 @@ jump_to_find_result (EvView *view)
 	rect = ev_rectangle_new ();
 
 	if (n_results > 0 && priv->find_result < n_results) {
-		EvFindRectangle *find_rect, *rect_next;
+		EvRectangle *find_rect, *rect_next;
 		GdkRectangle view_rect;
 
 		rect_next = NULL;
 		find_rect = ev_view_find_get_result (view, page, priv->find_result);
-		if (find_rect->next_line) {
+		if (ev_view_find_is_next_line (view, page, priv->find_result) &&
+		    priv->find_result + 1 < n_results) {
 			/* For an across-lines match, make sure both rectangles are visible */
 			rect_next = ev_view_find_get_result (view, page, priv->find_result + 1);
 			rect->x1 = MIN (find_rect->x1, rect_next->x1);
@@ -9222,7 +9440,7 @@ find_job_updated_cb (EvJobFind *job, gint page, EvView *view)
 {
 	EvViewPrivate *priv = GET_PRIVATE (view);
 
-	priv->find_pages = ev_job_find_get_results (job);
+	priv->find_pages = job->page_results;
 	if (priv->find_page == -1)
 		priv->find_page = priv->current_page;
 
@@ -9731,7 +9949,7 @@ get_selected_text (EvView *view)
 
 	text = g_string_new (NULL);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (priv->document);
 
 	for (l = priv->selection_info.selections; l != NULL; l = l->next) {
 		EvViewSelection *selection = (EvViewSelection *)l->data;
@@ -9747,7 +9965,7 @@ get_selected_text (EvView *view)
 		g_free (tmp);
 	}
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (priv->document);
 
 	/* For copying text from the document to the clipboard, we want a normalization
 	 * that preserves 'canonical equivalence' i.e. that text after normalization
@@ -403,10 +403,10 @@ get_page_text (EvDocument   *document,
         gchar   *text;
         gboolean success;
 
-        ev_document_doc_mutex_lock ();
+        ev_document_reader_lock (document);
         text = ev_document_text_get_text (EV_DOCUMENT_TEXT (document), page);
         success = ev_document_text_get_text_layout (EV_DOCUMENT_TEXT (document), page, areas, n_areas);
-        ev_document_doc_mutex_unlock ();
+        ev_document_reader_unlock (document);
 
         if (!success) {
                 g_free (text);
@@ -419,7 +419,7 @@ get_page_text (EvDocument   *document,
 static gint
 get_match_offset (EvRectangle *areas,
                   guint        n_areas,
-                  EvFindRectangle *match,
+                  EvRectangle *match,
                   gint         offset)
 {
         gdouble x, y;
@@ -468,9 +468,9 @@ process_matches_idle (EvFindSidebar *sidebar)
         model = gtk_tree_view_get_model (GTK_TREE_VIEW (priv->tree_view));
 
         do {
-                GList        *matches, *l;
+                const EvFindPageResults *matches;
                 EvPage       *page;
-                gint          result;
+                guint         i;
                 gchar        *page_label;
                 gchar        *page_text;
                 EvRectangle  *areas = NULL;
@@ -482,7 +482,7 @@ process_matches_idle (EvFindSidebar *sidebar)
                 current_page = priv->current_page;
                 priv->current_page = (priv->current_page + 1) % priv->job->n_pages;
 
-                matches = priv->job->pages[current_page];
+                matches = ev_job_find_get_page_results (priv->job, current_page);
                 if (!matches)
                         continue;
 
@@ -502,16 +502,16 @@ process_matches_idle (EvFindSidebar *sidebar)
 
                 offset = 0;
 
-                for (l = matches, result = 0; l; l = g_list_next (l), result++) {
-                        EvFindRectangle *match = (EvFindRectangle *)l->data;
+                for (i = 0; i < matches->n_results; i++) {
+                        guint8       flags = matches->flags[i];
                         gchar       *markup;
                         GtkTreeIter  iter;
                         gint         new_offset;
 
-                        if (l->prev && ((EvFindRectangle *)l->prev->data)->next_line)
+                        if (i > 0 && (matches->flags[i - 1] & EV_FIND_RESULT_NEXT_LINE))
                                 continue; /* Skip as this is second part of a multi-line match */
 
-                        new_offset = get_match_offset (areas, n_areas, match, offset);
+                        new_offset = get_match_offset (areas, n_areas, &matches->areas[i], offset);
                         if (new_offset == -1) {
                                 /* It may happen that a text match has no corresponding text area available,
                                  * (due to limitations/bugs of Poppler's TextPage->getSelectionWords() used by
@@ -527,8 +527,8 @@ process_matches_idle (EvFindSidebar *sidebar)
                                                                       text_log_attrs,
                                                                       text_log_attrs_length,
                                                                       offset,
-                                                                      match->next_line,
-                                                                      match->after_hyphen);
+                                                                      (flags & EV_FIND_RESULT_NEXT_LINE) != 0,
+                                                                      (flags & EV_FIND_RESULT_AFTER_HYPHEN) != 0);
                         }
 
                         if (current_page >= priv->job->start_page) {
@@ -543,7 +543,7 @@ process_matches_idle (EvFindSidebar *sidebar)
                                             TEXT_COLUMN, markup,
 					    PAGE_LABEL_COLUMN, page_label,
                                             PAGE_COLUMN, current_page + 1,
-                                            RESULT_COLUMN, result,
+                                            RESULT_COLUMN, i,
                                             -1);
                         g_free (markup);
                 }
@@ -617,7 +617,7 @@ ev_find_sidebar_restart (EvFindSidebar *sidebar,
                 if (index >= priv->job->n_pages)
                         index -= priv->job->n_pages;
 
-                if (priv->job->pages[index]) {
+                if (ev_job_find_get_page_results (priv->job, index)) {
                         first_match_page = index;
                         break;
                 }
@@ -19,6 +19,7 @@
  */
 
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 #include <string.h>
 
 #include "ev-metadata.h"
@@ -29,6 +30,14 @@ struct _EvMetadata {
 
 	GFile      *file;
 	GHashTable *items;
+
+	/* Keys changed since the last write */
+	GHashTable *dirty;
+	guint       flush_id;
+
+	/* Key file used instead of GIO when the file system doesn't
+	 * support metadata */
+	gchar      *local_path;
 };
 
 struct _EvMetadataClass {
@@ -37,14 +46,26 @@ struct _EvMetadataClass {
 
 G_DEFINE_TYPE (EvMetadata, ev_metadata, G_TYPE_OBJECT)
 
-#define EV_METADATA_NAMESPACE "metadata::evince"
+#define EV_METADATA_NAMESPACE   "metadata::evince"
+#define EV_METADATA_LOCAL_GROUP "Metadata"
+/* Local key files of documents not opened for this long are removed */
+#define EV_METADATA_LOCAL_MAX_AGE (90 * 24 * 60 * 60)
+/* Changes are written at most once per this number of seconds */
+#define EV_METADATA_FLUSH_DELAY 2
+
+static void ev_metadata_write (EvMetadata *metadata,
+			       gboolean    sync);
 
 static void
 ev_metadata_finalize (GObject *object)
 {
 	EvMetadata *metadata = EV_METADATA (object);
 
+	ev_metadata_write (metadata, TRUE);
+
 	g_clear_pointer (&metadata->items, g_hash_table_destroy);
+	g_clear_pointer (&metadata->dirty, g_hash_table_destroy);
+	g_clear_pointer (&metadata->local_path, g_free);
 	g_clear_object (&metadata->file);
 
 	G_OBJECT_CLASS (ev_metadata_parent_class)->finalize (object);
@@ -57,6 +78,10 @@ ev_metadata_init (EvMetadata *metadata)
 						 g_str_equal,
 						 g_free,
 						 g_free);
+	metadata->dirty = g_hash_table_new_full (g_str_hash,
+						 g_str_equal,
+						 g_free,
+						 NULL);
 }
 
 static void
@@ -115,6 +140,115 @@ ev_metadata_load (EvMetadata *metadata)
 	g_object_unref (info);
 }
 
+static gchar *
+ev_metadata_get_local_dir (void)
+{
+	return g_build_filename (g_get_user_data_dir (), "evince", "metadata", NULL);
+}
+
+/* Removes the key files of documents that have not been opened for
+ * EV_METADATA_LOCAL_MAX_AGE, opening a document refreshes its mtime */
+static void
+ev_metadata_expire_local (void)
+{
+	GDir        *dir;
+	gchar       *dirname;
+	const gchar *name;
+	gint64       now;
+
+	dirname = ev_metadata_get_local_dir ();
+	dir = g_dir_open (dirname, 0, NULL);
+	if (!dir) {
+		g_free (dirname);
+		return;
+	}
+
+	now = g_get_real_time () / G_USEC_PER_SEC;
+	while ((name = g_dir_read_name (dir))) {
+		gchar    *filename;
+		GStatBuf  buf;
+
+		if (!g_str_has_suffix (name, ".ini"))
+			continue;
+
+		filename = g_build_filename (dirname, name, NULL);
+		if (g_stat (filename, &buf) == 0 &&
+		    now - buf.st_mtime > EV_METADATA_LOCAL_MAX_AGE)
+			g_unlink (filename);
+		g_free (filename);
+	}
+
+	g_dir_close (dir);
+	g_free (dirname);
+}
+
+static GKeyFile *
+ev_metadata_load_key_file (const gchar *path)
+{
+	GKeyFile *key_file;
+	GError   *error = NULL;
+
+	key_file = g_key_file_new ();
+	if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &error)) {
+		/* Don't warn if the file simply doesn't exist */
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_warning ("%s", error->message);
+		g_error_free (error);
+	}
+
+	return key_file;
+}
+
+static void
+ev_metadata_load_local (EvMetadata *metadata,
+			GFile      *file)
+{
+	static gboolean expired = FALSE;
+	GKeyFile *key_file;
+	gchar    *uri;
+	gchar    *checksum;
+	gchar    *filename;
+	gchar    *dirname;
+	gchar   **keys;
+	gint      i;
+
+	if (!expired) {
+		ev_metadata_expire_local ();
+		expired = TRUE;
+	}
+
+	/* Only a hash of the URI is stored, not the URI itself */
+	uri = g_file_get_uri (file);
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+	filename = g_strconcat (checksum, ".ini", NULL);
+	dirname = ev_metadata_get_local_dir ();
+	metadata->local_path = g_build_filename (dirname, filename, NULL);
+	g_free (dirname);
+	g_free (filename);
+	g_free (checksum);
+	g_free (uri);
+
+	key_file = ev_metadata_load_key_file (metadata->local_path);
+	keys = g_key_file_get_keys (key_file, EV_METADATA_LOCAL_GROUP, NULL, NULL);
+	for (i = 0; keys && keys[i]; i++) {
+		gchar *value;
+
+		value = g_key_file_get_string (key_file, EV_METADATA_LOCAL_GROUP,
+					       keys[i], NULL);
+		if (value)
+			g_hash_table_insert (metadata->items, g_strdup (keys[i]), value);
+	}
+	g_strfreev (keys);
+	g_key_file_free (key_file);
+
+	/* Keep the file from expiring while the document is used */
+	if (g_hash_table_size (metadata->items) > 0)
+		g_utime (metadata->local_path, NULL);
+}
+
+/* Documents in file systems without metadata support, like most remote
+ * ones, get a key file in the user data dir instead.
+ */
 EvMetadata *
 ev_metadata_new (GFile *file)
 {
@@ -123,10 +257,15 @@ ev_metadata_new (GFile *file)
 	g_return_val_if_fail (G_IS_FILE (file), NULL);
 
 	metadata = EV_METADATA (g_object_new (EV_TYPE_METADATA, NULL));
-        if (!ev_file_is_temp (file)) {
-                metadata->file = g_object_ref (file);
-                ev_metadata_load (metadata);
-        }
+	if (ev_file_is_temp (file))
+		return metadata;
+
+	if (ev_is_metadata_supported_for_file (file)) {
+		metadata->file = g_object_ref (file);
+		ev_metadata_load (metadata);
+	} else {
+		ev_metadata_load_local (metadata, file);
+	}
 
 	return metadata;
 }
@@ -155,7 +294,7 @@ ev_metadata_get_string (EvMetadata  *metadata,
 static void
 metadata_set_callback (GObject      *file,
 		       GAsyncResult *result,
-		       EvMetadata   *metadata)
+		       gpointer      user_data)
 {
 	GError *error = NULL;
 
@@ -165,38 +304,142 @@ metadata_set_callback (GObject      *file,
 	}
 }
 
-gboolean
-ev_metadata_set_string (EvMetadata  *metadata,
-			const gchar *key,
-			const gchar *value)
+/* Other windows may have written the same document since it was loaded,
+ * so only the changed keys are merged into the file on disk */
+static void
+ev_metadata_write_local (EvMetadata *metadata)
 {
-	GFileInfo *info;
-	gchar     *gio_key;
+	GKeyFile      *key_file;
+	GHashTableIter iter;
+	const gchar   *key;
+	gchar         *dirname;
+	GError        *error = NULL;
+
+	key_file = ev_metadata_load_key_file (metadata->local_path);
+
+	g_hash_table_iter_init (&iter, metadata->dirty);
+	while (g_hash_table_iter_next (&iter, (gpointer *)&key, NULL)) {
+		const gchar *value = g_hash_table_lookup (metadata->items, key);
+
+		if (value)
+			g_key_file_set_string (key_file, EV_METADATA_LOCAL_GROUP, key, value);
+		else
+			g_key_file_remove_key (key_file, EV_METADATA_LOCAL_GROUP, key, NULL);
+	}
 
-        g_hash_table_insert (metadata->items, g_strdup (key), g_strdup (value));
-        if (!metadata->file)
-                return TRUE;
+	dirname = g_path_get_dirname (metadata->local_path);
+	g_mkdir_with_parents (dirname, 0700);
+	g_free (dirname);
+
+	if (!g_key_file_save_to_file (key_file, metadata->local_path, &error)) {
+		g_warning ("Failed to save metadata: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_key_file_free (key_file);
+}
+
+static void
+ev_metadata_write_file (EvMetadata *metadata,
+			gboolean    sync)
+{
+	GFileInfo     *info;
+	GHashTableIter iter;
+	const gchar   *key;
 
 	info = g_file_info_new ();
 
-	gio_key = g_strconcat (EV_METADATA_NAMESPACE"::", key, NULL);
-	if (value) {
-		g_file_info_set_attribute_string (info, gio_key, value);
+	g_hash_table_iter_init (&iter, metadata->dirty);
+	while (g_hash_table_iter_next (&iter, (gpointer *)&key, NULL)) {
+		const gchar *value = g_hash_table_lookup (metadata->items, key);
+		gchar       *gio_key;
+
+		gio_key = g_strconcat (EV_METADATA_NAMESPACE"::", key, NULL);
+		if (value) {
+			g_file_info_set_attribute_string (info, gio_key, value);
+		} else {
+			g_file_info_set_attribute (info, gio_key,
+						   G_FILE_ATTRIBUTE_TYPE_INVALID,
+						   NULL);
+		}
+		g_free (gio_key);
+	}
+
+	if (sync) {
+		GError *error = NULL;
+
+		if (!g_file_set_attributes_from_info (metadata->file, info, 0, NULL, &error)) {
+			g_warning ("%s", error->message);
+			g_error_free (error);
+		}
 	} else {
-		g_file_info_set_attribute (info, gio_key,
-					   G_FILE_ATTRIBUTE_TYPE_INVALID,
-					   NULL);
+		g_file_set_attributes_async (metadata->file,
+					     info,
+					     0,
+					     G_PRIORITY_DEFAULT,
+					     NULL,
+					     metadata_set_callback,
+					     NULL);
 	}
-	g_free (gio_key);
-
-	g_file_set_attributes_async (metadata->file,
-				     info,
-				     0,
-				     G_PRIORITY_DEFAULT,
-				     NULL,
-				     (GAsyncReadyCallback)metadata_set_callback,
-				     metadata);
 	g_object_unref (info);
+}
+
+/* Writes all the changed keys at once */
+static void
+ev_metadata_write (EvMetadata *metadata,
+		   gboolean    sync)
+{
+	g_clear_handle_id (&metadata->flush_id, g_source_remove);
+
+	if (g_hash_table_size (metadata->dirty) == 0)
+		return;
+
+	if (metadata->file)
+		ev_metadata_write_file (metadata, sync);
+	else if (metadata->local_path)
+		ev_metadata_write_local (metadata);
+
+	g_hash_table_remove_all (metadata->dirty);
+}
+
+static gboolean
+ev_metadata_flush_timeout (EvMetadata *metadata)
+{
+	metadata->flush_id = 0;
+	ev_metadata_write (metadata, FALSE);
+
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * ev_metadata_flush:
+ * @metadata: an #EvMetadata
+ *
+ * Writes the pending changes now instead of waiting for the timeout,
+ * and doesn't return until they are written.
+ */
+void
+ev_metadata_flush (EvMetadata *metadata)
+{
+	g_return_if_fail (EV_IS_METADATA (metadata));
+
+	ev_metadata_write (metadata, TRUE);
+}
+
+gboolean
+ev_metadata_set_string (EvMetadata  *metadata,
+			const gchar *key,
+			const gchar *value)
+{
+        g_hash_table_insert (metadata->items, g_strdup (key), g_strdup (value));
+        if (!metadata->file && !metadata->local_path)
+                return TRUE;
+
+	g_hash_table_add (metadata->dirty, g_strdup (key));
+	if (metadata->flush_id == 0)
+		metadata->flush_id = g_timeout_add_seconds (EV_METADATA_FLUSH_DELAY,
+							    (GSourceFunc)ev_metadata_flush_timeout,
+							    metadata);
 
 	return TRUE;
 }
@@ -29,8 +29,7 @@
 #include "ev-file-helpers.h"
 #include "ev-document-misc.h"
 #include "ev-document-model.h"
-#include "ev-jobs.h"
-#include "ev-job-scheduler.h"
+#include "ev-document-factory.h"
 
 #ifdef HAVE_LIBGNOME_DESKTOP
 #define GNOME_DESKTOP_USE_UNSTABLE_API
@@ -44,6 +43,12 @@ typedef struct {
 	GtkRecentManager *recent_manager;
 	gulong            recent_manager_changed_handler_id;
 
+	/* Documents are loaded outside of the job scheduler, so that
+	 * they never delay the document being opened */
+	GCancellable     *cancellable;
+	GQueue            pending_loads;
+	guint             n_loads;
+
 #ifdef HAVE_LIBGNOME_DESKTOP
 	GnomeDesktopThumbnailFactory *thumbnail_factory;
 #endif
@@ -60,6 +65,7 @@ G_DEFINE_TYPE_WITH_PRIVATE (EvRecentView, ev_recent_view, ADW_TYPE_BIN);
 
 #define ICON_VIEW_SIZE 128
 #define MAX_RECENT_VIEW_ITEMS 64
+#define MAX_DOCUMENT_LOADS 2
 #define GET_PRIVATE(o) ev_recent_view_get_instance_private (o);
 
 typedef struct {
@@ -69,7 +75,9 @@ typedef struct {
 	int                  scale;
 	EvThumbnailItem     *item;
         GCancellable        *cancellable;
-        EvJob               *job;
+        cairo_surface_t     *thumbnail_surface;
+        gchar               *title;
+        gchar               *author;
         guint                needs_metadata : 1;
         guint                needs_thumbnail : 1;
 } GetDocumentInfoAsyncData;
@@ -77,13 +85,10 @@ typedef struct {
 static void
 get_document_info_async_data_free (GetDocumentInfoAsyncData *data)
 {
-        if (data->job) {
-                g_signal_handlers_disconnect_by_data (data->job, data->ev_recent_view);
-                ev_job_cancel (data->job);
-                g_object_unref (data->job);
-        }
-
         g_clear_object (&data->cancellable);
+        g_clear_pointer (&data->thumbnail_surface, cairo_surface_destroy);
+        g_free (data->title);
+        g_free (data->author);
         g_free (data->uri);
 
 	g_object_unref (data->item);
@@ -100,12 +105,32 @@ ev_recent_view_clear_model (EvRecentView *ev_recent_view)
         g_list_store_remove_all (priv->model);
 }
 
+/* Stops getting the info of the current items. Loads already running
+ * in a thread can't be interrupted, but their results are dropped.
+ */
+static void
+ev_recent_view_cancel_document_info (EvRecentView *ev_recent_view)
+{
+        EvRecentViewPrivate      *priv = GET_PRIVATE (ev_recent_view);
+        GetDocumentInfoAsyncData *data;
+
+        if (priv->cancellable) {
+                g_cancellable_cancel (priv->cancellable);
+                g_clear_object (&priv->cancellable);
+        }
+
+        while ((data = g_queue_pop_head (&priv->pending_loads)))
+                get_document_info_async_data_free (data);
+}
+
 static void
 ev_recent_view_dispose (GObject *obj)
 {
         EvRecentView        *ev_recent_view = EV_RECENT_VIEW (obj);
         EvRecentViewPrivate *priv = GET_PRIVATE (ev_recent_view);
 
+        ev_recent_view_cancel_document_info (ev_recent_view);
+
         if (priv->model) {
                 ev_recent_view_clear_model (ev_recent_view);
         }
@@ -166,6 +191,9 @@ grid_view_item_activated_cb (GtkGridView  *gridview,
 	if (!uri)
 		return;
 
+	/* Leave the CPU to the document being opened */
+	ev_recent_view_cancel_document_info (ev_recent_view);
+
         g_signal_emit (ev_recent_view, signals[ITEM_ACTIVATED], 0, uri);
         g_free (uri);
 	g_object_unref (recent_item);
@@ -209,7 +237,7 @@ save_thumbnail_in_cache_thread (GTask                    *task,
         GError *error = NULL;
 #endif
 
-	surface = EV_JOB_THUMBNAIL_CAIRO (data->job)->thumbnail_surface;
+	surface = data->thumbnail_surface;
         thumbnail = gdk_pixbuf_get_from_surface (surface, 0, 0,
                                                  cairo_image_surface_get_width (surface),
                                                  cairo_image_surface_get_height (surface));
@@ -256,43 +284,49 @@ save_document_thumbnail_in_cache (GetDocumentInfoAsyncData *data)
 #endif /* HAVE_LIBGNOME_DESKTOP */
 }
 
+static void ev_recent_view_start_document_loads (EvRecentView *ev_recent_view);
+
+/* Only the first page is measured and rendered, and the rendered
+ * thumbnail is stored in the document cache, so getting it again is
+ * cheap even when the desktop thumbnail cache is not available.
+ */
 static void
-thumbnail_job_completed_callback (EvJobThumbnailCairo      *job,
-                                  GetDocumentInfoAsyncData *data)
+load_document_thread (GTask                    *task,
+                      EvRecentView             *ev_recent_view,
+                      GetDocumentInfoAsyncData *data,
+                      GCancellable             *cancellable)
 {
-	GdkPixbuf *pixbuf;
+        EvDocument *document;
+        GError     *error = NULL;
 
-        if (g_cancellable_is_cancelled (data->cancellable) ||
-            ev_job_is_failed (EV_JOB (job))) {
-                get_document_info_async_data_free (data);
+        if (g_task_return_error_if_cancelled (task))
                 return;
-        }
-
-	pixbuf = gdk_pixbuf_get_from_surface (job->thumbnail_surface, 0, 0,
-			cairo_image_surface_get_width (job->thumbnail_surface),
-			cairo_image_surface_get_height (job->thumbnail_surface));
-
-	add_thumbnail_to_model (data, pixbuf);
-        save_document_thumbnail_in_cache (data);
-}
 
-static void
-document_load_job_completed_callback (EvJobLoad                *job_load,
-                                      GetDocumentInfoAsyncData *data)
-{
-        EvDocument          *document = EV_JOB (job_load)->document;
-
-        if (g_cancellable_is_cancelled (data->cancellable) ||
-            ev_job_is_failed (EV_JOB (job_load))) {
-                get_document_info_async_data_free (data);
+        /* Backends are loaded with the same lock as EvJobLoad takes */
+        ev_document_fc_mutex_lock ();
+        document = ev_document_factory_get_document_full (data->uri,
+                                                          EV_DOCUMENT_LOAD_FLAG_LAZY_CACHE,
+                                                          &error);
+        ev_document_fc_mutex_unlock ();
+        if (!document) {
+                g_task_return_error (task, error);
                 return;
         }
 
-        g_clear_object (&data->job);
+        if (data->needs_metadata) {
+                const EvDocumentInfo *info = ev_document_get_info (document);
 
-        if (data->needs_thumbnail) {
-                gdouble width, height;
-                gint    target_width, target_height;
+                if (info->fields_mask & EV_DOCUMENT_INFO_TITLE && info->title && info->title[0] != '\0')
+                        data->title = g_strdup (info->title);
+                if (info->fields_mask & EV_DOCUMENT_INFO_AUTHOR && info->author && info->author[0] != '\0')
+                        data->author = g_strdup (info->author);
+        }
+
+        if (data->needs_thumbnail && !g_cancellable_is_cancelled (cancellable)) {
+                EvRenderContext *rc;
+                EvPage          *page;
+                gdouble          width, height;
+                gint             target_width, target_height;
 
                 ev_document_get_page_size (document, 0, &width, &height);
                 if (height < width) {
@@ -303,55 +337,112 @@ document_load_job_completed_callback (EvJobLoad                *job_load,
                         target_height = ICON_VIEW_SIZE;
                 }
 
-		target_width *= data->scale;
-		target_height *= data->scale;
+                /* Same locks as the thumbnail jobs, see ev_job_render_lock() */
+                ev_document_reader_lock (document);
+                if (!ev_document_supports_concurrent_reads (document))
+                        ev_document_fc_mutex_lock ();
+                page = ev_document_get_page (document, 0);
+                rc = ev_render_context_new (page, 0, 1.);
+                ev_render_context_set_target_size (rc,
+                                                   target_width * data->scale,
+                                                   target_height * data->scale);
+                data->thumbnail_surface = ev_document_get_thumbnail_surface (document, rc);
+                g_object_unref (rc);
+                g_object_unref (page);
+                if (!ev_document_supports_concurrent_reads (document))
+                        ev_document_fc_mutex_unlock ();
+                ev_document_reader_unlock (document);
+        }
 
-		data->job = ev_job_thumbnail_cairo_new_with_target_size (document, 0, 0,
-									 target_width,
-									 target_height);
+        g_object_unref (document);
 
-                g_signal_connect (data->job, "finished",
-                                  G_CALLBACK (thumbnail_job_completed_callback),
-                                  data);
-                ev_job_scheduler_push_job (data->job, EV_JOB_PRIORITY_HIGH);
+        g_task_return_boolean (task, TRUE);
+}
+
+static void
+load_document_cb (EvRecentView             *ev_recent_view,
+                  GAsyncResult             *result,
+                  GetDocumentInfoAsyncData *data)
+{
+        EvRecentViewPrivate *priv = GET_PRIVATE (ev_recent_view);
+
+        priv->n_loads--;
+        ev_recent_view_start_document_loads (ev_recent_view);
+
+        if (g_cancellable_is_cancelled (data->cancellable) ||
+            !g_task_propagate_boolean (G_TASK (result), NULL)) {
+                get_document_info_async_data_free (data);
+                return;
         }
 
         if (data->needs_metadata) {
-                const EvDocumentInfo *info;
-                GFile                *file;
-                GFileInfo            *file_info = g_file_info_new ();
-
-                info = ev_document_get_info (document);
-                if (info->fields_mask & EV_DOCUMENT_INFO_TITLE && info->title && info->title[0] != '\0') {
-			ev_thumbnail_item_set_primary_text (data->item, info->title);
-                        g_file_info_set_attribute_string (file_info, "metadata::evince::title", info->title);
-                } else {
-                        g_file_info_set_attribute_string (file_info, "metadata::evince::title", "");
-                }
-                if (info->fields_mask & EV_DOCUMENT_INFO_AUTHOR && info->author && info->author[0] != '\0') {
-			ev_thumbnail_item_set_secondary_text (data->item, info->author);
-                        g_file_info_set_attribute_string (file_info, "metadata::evince::author", info->author);
-                } else {
-                        g_file_info_set_attribute_string (file_info, "metadata::evince::author", "");
-                }
+                GFile     *file;
+                GFileInfo *file_info = g_file_info_new ();
+
+                if (data->title)
+			ev_thumbnail_item_set_primary_text (data->item, data->title);
+                g_file_info_set_attribute_string (file_info, "metadata::evince::title",
+                                                  data->title ? data->title : "");
+                if (data->author)
+			ev_thumbnail_item_set_secondary_text (data->item, data->author);
+                g_file_info_set_attribute_string (file_info, "metadata::evince::author",
+                                                  data->author ? data->author : "");
 
                 file = g_file_new_for_uri (data->uri);
                 g_file_set_attributes_async (file, file_info, G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT, NULL, NULL, NULL);
                 g_object_unref (file);
+                g_object_unref (file_info);
         }
 
-        if (!data->job)
-                get_document_info_async_data_free (data);
+        if (data->thumbnail_surface) {
+                GdkPixbuf *pixbuf;
+
+                pixbuf = gdk_pixbuf_get_from_surface (data->thumbnail_surface, 0, 0,
+                                                      cairo_image_surface_get_width (data->thumbnail_surface),
+                                                      cairo_image_surface_get_height (data->thumbnail_surface));
+                add_thumbnail_to_model (data, pixbuf);
+                g_object_unref (pixbuf);
+                save_document_thumbnail_in_cache (data);
+                return;
+        }
+
+        get_document_info_async_data_free (data);
+}
+
+/* At most MAX_DOCUMENT_LOADS documents are loaded at the same time,
+ * at low priority, in the order of the items.
+ */
+static void
+ev_recent_view_start_document_loads (EvRecentView *ev_recent_view)
+{
+        EvRecentViewPrivate *priv = GET_PRIVATE (ev_recent_view);
+
+        while (priv->n_loads < MAX_DOCUMENT_LOADS) {
+                GetDocumentInfoAsyncData *data;
+                GTask                    *task;
+
+                data = g_queue_pop_head (&priv->pending_loads);
+                if (!data)
+                        break;
+
+                task = g_task_new (ev_recent_view, data->cancellable,
+                                   (GAsyncReadyCallback)load_document_cb, data);
+                g_task_set_task_data (task, data, NULL);
+                g_task_set_priority (task, G_PRIORITY_LOW);
+                g_task_run_in_thread (task, (GTaskThreadFunc)load_document_thread);
+                g_object_unref (task);
+
+                priv->n_loads++;
+        }
 }
 
 static void
 load_document_and_get_document_info (GetDocumentInfoAsyncData *data)
 {
-        data->job = EV_JOB (ev_job_load_new (data->uri));
-        g_signal_connect (data->job, "finished",
-                          G_CALLBACK (document_load_job_completed_callback),
-                          data);
-        ev_job_scheduler_push_job (data->job, EV_JOB_PRIORITY_HIGH);
+        EvRecentViewPrivate *priv = GET_PRIVATE (data->ev_recent_view);
+
+        g_queue_push_tail (&priv->pending_loads, data);
+        ev_recent_view_start_document_loads (data->ev_recent_view);
 }
 
 #ifdef HAVE_LIBGNOME_DESKTOP
@@ -553,11 +644,12 @@ document_query_info_cb (GFile                    *file,
         get_document_info (data);
 }
 
-static GetDocumentInfoAsyncData *
+static void
 ev_recent_view_get_document_info (EvRecentView  *ev_recent_view,
                                   const gchar   *uri,
                                   EvThumbnailItem  *item)
 {
+        EvRecentViewPrivate      *priv = GET_PRIVATE (ev_recent_view);
         GFile                    *file;
         GetDocumentInfoAsyncData *data;
 
@@ -565,7 +657,7 @@ ev_recent_view_get_document_info (EvRecentView  *ev_recent_view,
         data->ev_recent_view = g_object_ref (ev_recent_view);
         data->uri = g_strdup (uri);
         data->item = g_object_ref (item);
-        data->cancellable = g_cancellable_new ();
+        data->cancellable = g_object_ref (priv->cancellable);
         data->needs_metadata = TRUE;
         data->needs_thumbnail = TRUE;
 	data->scale = gtk_widget_get_scale_factor (GTK_WIDGET (ev_recent_view));
@@ -576,8 +668,6 @@ ev_recent_view_get_document_info (EvRecentView  *ev_recent_view,
                                  (GAsyncReadyCallback)document_query_info_cb,
                                  data);
         g_object_unref (file);
-
-        return data;
 }
 
 static void
@@ -593,6 +683,9 @@ ev_recent_view_refresh (EvRecentView *ev_recent_view)
 
 	g_list_store_remove_all (priv->model);
 
+        ev_recent_view_cancel_document_info (ev_recent_view);
+        priv->cancellable = g_cancellable_new ();
+
         for (l = items; l && l->data; l = g_list_next (l)) {
                 GtkRecentInfo            *info;
                 const gchar              *uri;
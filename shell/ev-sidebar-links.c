@@ -39,6 +39,8 @@
 
 struct _EvSidebarLinksPrivate {
 	GtkWidget *tree_view;
+	GtkTreeViewColumn *page_label_column;
+	GtkCellRenderer *page_label_renderer;
 	GActionGroup *group;
 
 	/* Keep these ids around for blocking */
@@ -51,6 +53,8 @@ struct _EvSidebarLinksPrivate {
 	EvDocument *document;
 	EvDocumentModel *doc_model;
 
+	/* Built by the links job, see ev_job_links_run() */
+	GHashTable *link_pages;
 	GTree *page_link_tree;
 
 	GtkWidget  *popup;
@@ -159,6 +163,7 @@ ev_sidebar_links_dispose (GObject *object)
 	}
 
 	g_clear_object (&sidebar->priv->model);
+	g_clear_pointer (&sidebar->priv->link_pages, g_hash_table_unref);
 	g_clear_pointer (&sidebar->priv->page_link_tree, g_tree_unref);
 
 	if (sidebar->priv->document) {
@@ -965,6 +970,34 @@ create_links_action_group (EvSidebarLinks *ev_sidebar_links) {
 	return G_ACTION_GROUP (group);
 }
 
+/* Page labels are only looked up for the rows being displayed */
+static void
+page_label_cell_data_func (GtkTreeViewColumn *column,
+			   GtkCellRenderer   *renderer,
+			   GtkTreeModel      *model,
+			   GtkTreeIter       *iter,
+			   gpointer           user_data)
+{
+	EvSidebarLinksPrivate *priv = EV_SIDEBAR_LINKS (user_data)->priv;
+	EvLink *link = NULL;
+	gpointer page;
+	gchar *page_label = NULL;
+
+	if (priv->link_pages && priv->document)
+		gtk_tree_model_get (model, iter,
+				    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
+				    -1);
+
+	if (link && g_hash_table_lookup_extended (priv->link_pages, link, NULL, &page) &&
+	    GPOINTER_TO_INT (page) >= 0)
+		page_label = ev_document_get_page_label (priv->document, GPOINTER_TO_INT (page));
+
+	g_object_set (renderer, "text", page_label, NULL);
+
+	g_clear_object (&link);
+	g_free (page_label);
+}
+
 static void
 ev_sidebar_links_init (EvSidebarLinks *ev_sidebar_links)
 {
@@ -977,6 +1010,10 @@ ev_sidebar_links_init (EvSidebarLinks *ev_sidebar_links)
 	ev_sidebar_links->priv = priv;
 
 	gtk_widget_init_template (GTK_WIDGET (ev_sidebar_links));
+	gtk_tree_view_column_set_cell_data_func (priv->page_label_column,
+						 priv->page_label_renderer,
+						 page_label_cell_data_func,
+						 ev_sidebar_links, NULL);
 
 	priv->group = create_links_action_group (ev_sidebar_links);
 	gtk_widget_insert_action_group (priv->popup, "links", priv->group);
@@ -1010,6 +1047,8 @@ ev_sidebar_links_class_init (EvSidebarLinksClass *ev_sidebar_links_class)
 	gtk_widget_class_set_template_from_resource (widget_class,
 			"/org/gnome/evince/ui/sidebar-links.ui");
 	gtk_widget_class_bind_template_child_private (widget_class, EvSidebarLinks, tree_view);
+	gtk_widget_class_bind_template_child_private (widget_class, EvSidebarLinks, page_label_column);
+	gtk_widget_class_bind_template_child_private (widget_class, EvSidebarLinks, page_label_renderer);
 	gtk_widget_class_bind_template_child_private (widget_class, EvSidebarLinks, popup);
 
 	gtk_widget_class_bind_template_callback (widget_class, button_press_cb);
@@ -1076,6 +1115,10 @@ ev_sidebar_links_set_current_page (EvSidebarLinks *sidebar_links,
 	if (!gtk_widget_is_visible (GTK_WIDGET (sidebar_links)))
 		return;
 
+	/* The outline hasn't been indexed yet */
+	if (!sidebar_links->priv->page_link_tree)
+		return;
+
 	search_data.page = current_page;
 	search_data.best_existing = G_MININT;
 
@@ -1185,44 +1228,6 @@ expand_open_links (GtkTreeView  *tree_view,
 }
 
 
-static gint
-page_link_tree_sort (gconstpointer a, gconstpointer b, void *data)
-{
-	gint a_int = GPOINTER_TO_INT (a);
-	gint b_int = GPOINTER_TO_INT (b);
-
-	return (a_int < b_int) ? -1 : (a_int > b_int);
-}
-
-static gboolean
-update_page_link_tree_foreach (GtkTreeModel *model,
-			       GtkTreePath  *path,
-			       GtkTreeIter  *iter,
-			       gpointer      data)
-{
-	EvSidebarLinks *sidebar_links = data;
-	EvSidebarLinksPrivate *priv = sidebar_links->priv;
-	EvDocumentLinks *document_links = EV_DOCUMENT_LINKS (priv->document);
-	EvLink *link;
-	int page;
-
-	gtk_tree_model_get (model, iter,
-			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
-			    -1);
-
-	if (!link)
-		return FALSE;
-
-	page = ev_document_links_get_link_page (document_links, link);
-	g_object_unref (link);
-
-	/* Only save the first link we find per page. */
-	if (!g_tree_lookup (priv->page_link_tree, GINT_TO_POINTER (page)))
-		g_tree_insert (priv->page_link_tree, GINT_TO_POINTER (page), gtk_tree_path_copy (path));
-
-	return FALSE;
-}
-
 static void
 ev_sidebar_links_set_links_model (EvSidebarLinks *sidebar_links,
 				  GtkTreeModel   *model)
@@ -1236,14 +1241,9 @@ ev_sidebar_links_set_links_model (EvSidebarLinks *sidebar_links,
 		g_object_unref (priv->model);
 	priv->model = g_object_ref (model);
 
-	/* Rebuild the binary search tree for finding links on pages. */
-	if (priv->page_link_tree)
-		g_tree_unref (priv->page_link_tree);
-	priv->page_link_tree = g_tree_new_full (page_link_tree_sort, NULL, NULL, (GDestroyNotify) gtk_tree_path_free);
-
-	gtk_tree_model_foreach (model,
-				update_page_link_tree_foreach,
-				sidebar_links);
+	/* The index of the previous model doesn't apply to this one */
+	g_clear_pointer (&priv->link_pages, g_hash_table_unref);
+	g_clear_pointer (&priv->page_link_tree, g_tree_unref);
 
 	g_object_notify (G_OBJECT (sidebar_links), "model");
 }
@@ -1260,6 +1260,10 @@ job_finished_callback (EvJobLinks     *job,
 	gchar *index_collapse = NULL;
 
 	ev_sidebar_links_set_links_model (sidebar_links, job->model);
+	if (job->link_pages)
+		priv->link_pages = g_hash_table_ref (job->link_pages);
+	if (job->page_link_tree)
+		priv->page_link_tree = g_tree_ref (job->page_link_tree);
 
 	gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), job->model);
 
@@ -1322,6 +1326,8 @@ ev_sidebar_links_document_changed_cb (EvDocumentModel *model,
 	}
 
 	priv->document = g_object_ref (document);
+	g_clear_pointer (&priv->link_pages, g_hash_table_unref);
+	g_clear_pointer (&priv->page_link_tree, g_tree_unref);
 
 	if (priv->job) {
 		g_signal_handlers_disconnect_by_func (priv->job,
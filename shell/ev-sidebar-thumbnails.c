@@ -39,11 +39,20 @@
 #include "ev-sidebar.h"
 #include "ev-sidebar-page.h"
 #include "ev-sidebar-thumbnails.h"
+#include "ev-thumbnail-item.h"
 #include "ev-utils.h"
 #include "ev-window.h"
 
 #define THUMBNAIL_WIDTH 100
 
+/* Padding of the grid view, see evince.css, and of its items */
+#define THUMBNAIL_ITEM_MARGIN  6
+#define THUMBNAIL_ITEM_PADDING 6
+
+/* Memory used by the thumbnails rendered in the model, the least recently
+ * used ones out of the preloaded range go back to the loading icon */
+#define THUMBNAILS_MAX_SIZE (32 * 1024 * 1024)
+
 typedef struct _EvThumbsSize
 {
 	gint width;
@@ -55,35 +64,56 @@ typedef struct _EvThumbsSizeCache {
 	gint uniform_width;
 	gint uniform_height;
 	EvThumbsSize *sizes;
+	EvDocument *document; /* The cache is data of the document */
 } EvThumbsSizeCache;
 
+/* The list model of the grid view. Items are only created for the rows
+ * the view asks for, i.e. the ones on screen, so nothing is done per page
+ * when a document is loaded.
+ */
+#define EV_TYPE_SIDEBAR_THUMBNAILS_LIST (ev_sidebar_thumbnails_list_get_type ())
+G_DECLARE_FINAL_TYPE (EvSidebarThumbnailsList, ev_sidebar_thumbnails_list, EV, SIDEBAR_THUMBNAILS_LIST, GObject)
+
+struct _EvSidebarThumbnailsList {
+	GObject              parent;
+
+	EvSidebarThumbnails *sidebar;
+};
+
 struct _EvSidebarThumbnailsPrivate {
 	GtkWidget *swindow;
-	GtkWidget *icon_view;
-	GtkAdjustment *vadjustment;
-	GtkListStore *list_store;
+	GtkWidget *grid_view;
+	GtkSingleSelection *selection;
+	EvSidebarThumbnailsList *list;
 	GHashTable *loading_icons;
 	EvDocument *document;
 	EvDocumentModel *model;
 	EvThumbsSizeCache *size_cache;
         gint width;
 
-	gint n_pages, pages_done;
+	gint n_pages;
+	guint n_items;
 
 	int rotation;
 	gboolean inverted_colors;
 	gboolean blank_first_dual_mode; /* flag for when we're using a blank first thumbnail
 					 * for dual mode with !odd_left preference. Issue #30 */
-	/* Visible pages */
+	/* Pages being displayed and preloaded */
 	gint start_page, end_page;
-};
 
-enum {
-	COLUMN_PAGE_STRING,
-	COLUMN_SURFACE,
-	COLUMN_THUMBNAIL_SET,
-	COLUMN_JOB,
-	NUM_COLUMNS
+	/* GtkListItems bound in the grid view */
+	GHashTable *bound_items;
+	guint update_range_id;
+
+	/* Per page state, jobs only exist in the preloaded range */
+	GdkTexture **thumbnails;
+	EvJob **jobs;
+
+	/* Rendered thumbnails, most recently used first */
+	GQueue thumbnails_lru;
+	GList *thumbnail_links;
+	gsize *thumbnail_sizes;
+	gsize thumbnails_size;
 };
 
 enum {
@@ -103,7 +133,9 @@ static void         ev_sidebar_thumbnails_set_current_page (EvSidebarThumbnails
 static void         thumbnail_job_completed_callback       (EvJobThumbnailCairo     *job,
 							    EvSidebarThumbnails     *sidebar_thumbnails);
 static void         ev_sidebar_thumbnails_reload           (EvSidebarThumbnails     *sidebar_thumbnails);
-static void         adjustment_changed_cb                  (EvSidebarThumbnails     *sidebar_thumbnails);
+static void         ev_sidebar_thumbnails_queue_update_range (EvSidebarThumbnails   *sidebar_thumbnails);
+static gpointer     ev_sidebar_thumbnails_get_item         (EvSidebarThumbnails     *sidebar_thumbnails,
+							    guint                    position);
 static void         check_toggle_blank_first_dual_mode     (EvSidebarThumbnails     *sidebar_thumbnails);
 
 G_DEFINE_TYPE_EXTENDED (EvSidebarThumbnails,
@@ -114,6 +146,70 @@ G_DEFINE_TYPE_EXTENDED (EvSidebarThumbnails,
                         G_IMPLEMENT_INTERFACE (EV_TYPE_SIDEBAR_PAGE,
 					       ev_sidebar_thumbnails_page_iface_init))
 
+static GType
+ev_sidebar_thumbnails_list_get_item_type (GListModel *model)
+{
+	return EV_TYPE_THUMBNAIL_ITEM;
+}
+
+static guint
+ev_sidebar_thumbnails_list_get_n_items (GListModel *model)
+{
+	EvSidebarThumbnailsList *list = EV_SIDEBAR_THUMBNAILS_LIST (model);
+
+	return list->sidebar ? list->sidebar->priv->n_items : 0;
+}
+
+static gpointer
+ev_sidebar_thumbnails_list_get_item (GListModel *model,
+				     guint       position)
+{
+	EvSidebarThumbnailsList *list = EV_SIDEBAR_THUMBNAILS_LIST (model);
+
+	if (!list->sidebar || position >= list->sidebar->priv->n_items)
+		return NULL;
+
+	return ev_sidebar_thumbnails_get_item (list->sidebar, position);
+}
+
+static void
+ev_sidebar_thumbnails_list_model_iface_init (GListModelInterface *iface)
+{
+	iface->get_item_type = ev_sidebar_thumbnails_list_get_item_type;
+	iface->get_n_items = ev_sidebar_thumbnails_list_get_n_items;
+	iface->get_item = ev_sidebar_thumbnails_list_get_item;
+}
+
+G_DEFINE_TYPE_WITH_CODE (EvSidebarThumbnailsList,
+			 ev_sidebar_thumbnails_list,
+			 G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL,
+						ev_sidebar_thumbnails_list_model_iface_init))
+
+static void
+ev_sidebar_thumbnails_list_init (EvSidebarThumbnailsList *list)
+{
+}
+
+static void
+ev_sidebar_thumbnails_list_class_init (EvSidebarThumbnailsListClass *klass)
+{
+}
+
+/* Replaces all the items of the model, the ones being displayed are
+ * created again by the view */
+static void
+ev_sidebar_thumbnails_set_n_items (EvSidebarThumbnails *sidebar_thumbnails,
+				   guint                n_items)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	guint old_n_items = priv->n_items;
+
+	priv->n_items = n_items;
+	if (old_n_items != 0 || n_items != 0)
+		g_list_model_items_changed (G_LIST_MODEL (priv->list), 0, old_n_items, n_items);
+}
+
 /* Thumbnails dimensions cache */
 #define EV_THUMBNAILS_SIZE_CACHE_KEY "ev-thumbnails-size-cache"
 
@@ -137,8 +233,7 @@ static EvThumbsSizeCache *
 ev_thumbnails_size_cache_new (EvDocument *document)
 {
 	EvThumbsSizeCache *cache;
-	gint               i, n_pages;
-	EvThumbsSize      *thumb_size;
+	gint               n_pages;
 
 	cache = g_new0 (EvThumbsSizeCache, 1);
 
@@ -156,14 +251,9 @@ ev_thumbnails_size_cache_new (EvDocument *document)
 	if ((gsize)n_pages > G_MAXSIZE / sizeof(EvThumbsSize))
 		g_error ("Exiting program due to abnormal page count detected: %d", n_pages);
 
+	/* Sizes are filled in the first time they are asked for */
 	cache->sizes = g_new0 (EvThumbsSize, n_pages);
-
-	for (i = 0; i < n_pages; i++) {
-		thumb_size = &(cache->sizes[i]);
-		get_thumbnail_size_for_page (document, i,
-					     &thumb_size->width,
-					     &thumb_size->height);
-	}
+	cache->document = document;
 
 	return cache;
 }
@@ -184,6 +274,10 @@ ev_thumbnails_size_cache_get_size (EvThumbsSizeCache *cache,
 		EvThumbsSize *thumb_size;
 
 		thumb_size = &(cache->sizes[page]);
+		if (thumb_size->width == 0)
+			get_thumbnail_size_for_page (cache->document, page,
+						     &thumb_size->width,
+						     &thumb_size->height);
 
 		w = thumb_size->width;
 		h = thumb_size->height;
@@ -223,47 +317,75 @@ ev_thumbnails_size_cache_get (EvDocument *document)
 }
 
 static gboolean
-ev_sidebar_thumbnails_page_is_in_visible_range (EvSidebarThumbnails *sidebar,
-                                                guint                page)
+ev_sidebar_thumbnails_get_bound_range (EvSidebarThumbnails *sidebar,
+				       guint               *start,
+				       guint               *end)
 {
-        GtkTreePath *path;
-        GtkTreePath *start, *end;
-        gboolean     retval;
-        GList *selection;
+	GHashTableIter iter;
+	gpointer       list_item;
+
+	*start = G_MAXUINT;
+	*end = 0;
 
-	if (!sidebar->priv->icon_view)
+	if (!sidebar->priv->bound_items)
 		return FALSE;
 
-        selection = gtk_icon_view_get_selected_items (GTK_ICON_VIEW (sidebar->priv->icon_view));
-        if (!selection)
-                return FALSE;
+	g_hash_table_iter_init (&iter, sidebar->priv->bound_items);
+	while (g_hash_table_iter_next (&iter, &list_item, NULL)) {
+		guint position = gtk_list_item_get_position (GTK_LIST_ITEM (list_item));
+
+		if (position == GTK_INVALID_LIST_POSITION)
+			continue;
+
+		*start = MIN (*start, position);
+		*end = MAX (*end, position);
+	}
+
+	return *start <= *end;
+}
 
-        path = (GtkTreePath *)selection->data;
+static gboolean
+ev_sidebar_thumbnails_page_is_in_visible_range (EvSidebarThumbnails *sidebar,
+                                                guint                page)
+{
+        guint selected;
+        guint start, end;
 
-        /* We don't handle or expect multiple selection. */
-        g_assert (selection->next == NULL);
-        g_list_free (selection);
+	if (!sidebar->priv->selection)
+		return FALSE;
 
-        if (!gtk_icon_view_get_visible_range (GTK_ICON_VIEW (sidebar->priv->icon_view), &start, &end)) {
-                gtk_tree_path_free (path);
+        selected = gtk_single_selection_get_selected (sidebar->priv->selection);
+        if (selected == GTK_INVALID_LIST_POSITION)
                 return FALSE;
-        }
 
-        retval = gtk_tree_path_compare (path, start) >= 0 && gtk_tree_path_compare (path, end) <= 0;
-        gtk_tree_path_free (path);
-        gtk_tree_path_free (start);
-        gtk_tree_path_free (end);
+        if (!ev_sidebar_thumbnails_get_bound_range (sidebar, &start, &end))
+                return FALSE;
 
-        return retval;
+        return selected >= start && selected <= end;
 }
 
 static void
 ev_sidebar_thumbnails_dispose (GObject *object)
 {
 	EvSidebarThumbnails *sidebar_thumbnails = EV_SIDEBAR_THUMBNAILS (object);
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	if (priv->list) {
+		ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
+		ev_sidebar_thumbnails_set_n_items (sidebar_thumbnails, 0);
+		priv->list->sidebar = NULL;
+		g_clear_object (&priv->list);
+	}
 
-	g_clear_pointer (&sidebar_thumbnails->priv->loading_icons,
+	g_clear_handle_id (&priv->update_range_id, g_source_remove);
+	g_clear_pointer (&priv->bound_items, g_hash_table_destroy);
+	g_clear_pointer (&priv->loading_icons,
 			 g_hash_table_destroy);
+	g_clear_pointer (&priv->thumbnails, g_free);
+	g_clear_pointer (&priv->jobs, g_free);
+	g_clear_pointer (&priv->thumbnail_links, g_free);
+	g_clear_pointer (&priv->thumbnail_sizes, g_free);
+	g_clear_object (&priv->document);
 
 	G_OBJECT_CLASS (ev_sidebar_thumbnails_parent_class)->dispose (object);
 }
@@ -278,7 +400,7 @@ ev_sidebar_thumbnails_get_property (GObject    *object,
 
 	switch (prop_id) {
 	case PROP_WIDGET:
-		g_value_set_object (value, sidebar->priv->icon_view);
+		g_value_set_object (value, sidebar->priv->grid_view);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -315,7 +437,7 @@ ev_sidebar_thumbnails_map (GtkWidget *widget)
 
 	GTK_WIDGET_CLASS (ev_sidebar_thumbnails_parent_class)->map (widget);
 
-	adjustment_changed_cb (sidebar);
+	ev_sidebar_thumbnails_queue_update_range (sidebar);
 }
 
 static void
@@ -355,28 +477,60 @@ ev_sidebar_thumbnails_new (void)
 	return GTK_WIDGET (g_object_new (EV_TYPE_SIDEBAR_THUMBNAILS, NULL));
 }
 
-static cairo_surface_t *
+static GdkTexture *
+gdk_texture_new_for_surface (cairo_surface_t *surface)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+
+  g_return_val_if_fail (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE, NULL);
+  g_return_val_if_fail (cairo_image_surface_get_width (surface) > 0, NULL);
+  g_return_val_if_fail (cairo_image_surface_get_height (surface) > 0, NULL);
+
+  bytes = g_bytes_new_with_free_func (cairo_image_surface_get_data (surface),
+                                      cairo_image_surface_get_height (surface)
+                                      * cairo_image_surface_get_stride (surface),
+                                      (GDestroyNotify) cairo_surface_destroy,
+                                      cairo_surface_reference (surface));
+
+  texture = gdk_memory_texture_new (cairo_image_surface_get_width (surface),
+                                    cairo_image_surface_get_height (surface),
+                                    GDK_MEMORY_DEFAULT,
+                                    bytes,
+                                    cairo_image_surface_get_stride (surface));
+
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+/* The loading icons are shared by all the pages with the same size */
+static GdkTexture *
 ev_sidebar_thumbnails_get_loading_icon (EvSidebarThumbnails *sidebar_thumbnails,
 					gint                 width,
 					gint                 height)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-        cairo_surface_t *icon;
+	GdkTexture      *icon;
 	gchar           *key;
 
 	key = g_strdup_printf ("%dx%d", width, height);
 	icon = g_hash_table_lookup (priv->loading_icons, key);
 	if (!icon) {
+		cairo_surface_t *surface;
 		gboolean inverted_colors;
                 gint device_scale = 1;
 
                 device_scale = gtk_widget_get_scale_factor (GTK_WIDGET (sidebar_thumbnails));
 
 		inverted_colors = ev_document_model_get_inverted_colors (priv->model);
-                icon = ev_document_misc_render_loading_thumbnail_surface (GTK_WIDGET (sidebar_thumbnails),
-                                                                          width * device_scale,
-                                                                          height * device_scale,
-                                                                          inverted_colors);
+                surface = ev_document_misc_render_loading_thumbnail_surface (GTK_WIDGET (sidebar_thumbnails),
+                                                                             width * device_scale,
+                                                                             height * device_scale,
+                                                                             inverted_colors);
+		icon = gdk_texture_new_for_surface (surface);
+		cairo_surface_destroy (surface);
+
 		g_hash_table_insert (priv->loading_icons, key, icon);
 	} else {
 		g_free (key);
@@ -385,48 +539,177 @@ ev_sidebar_thumbnails_get_loading_icon (EvSidebarThumbnails *sidebar_thumbnails,
 	return icon;
 }
 
+static GdkPaintable *
+ev_sidebar_thumbnails_get_page_paintable (EvSidebarThumbnails *sidebar_thumbnails,
+					  gint                 page)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	gint width, height;
+
+	if (priv->thumbnails[page])
+		return GDK_PAINTABLE (priv->thumbnails[page]);
+
+	ev_thumbnails_size_cache_get_size (priv->size_cache, page,
+					   priv->rotation,
+					   &width, &height);
+
+	return GDK_PAINTABLE (ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails,
+								      width, height));
+}
+
+/* Only the items being displayed are updated, the others are created
+ * again with the current paintable when they are needed */
+static void
+ev_sidebar_thumbnails_update_item (EvSidebarThumbnails *sidebar_thumbnails,
+				   gint                 page)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GHashTableIter iter;
+	gpointer       list_item;
+
+	g_hash_table_iter_init (&iter, priv->bound_items);
+	while (g_hash_table_iter_next (&iter, &list_item, NULL)) {
+		GObject *item = gtk_list_item_get_item (GTK_LIST_ITEM (list_item));
+
+		if (!item || GPOINTER_TO_INT (g_object_get_data (item, "page")) != page + 1)
+			continue;
+
+		ev_thumbnail_item_set_paintable (EV_THUMBNAIL_ITEM (item),
+						 ev_sidebar_thumbnails_get_page_paintable (sidebar_thumbnails,
+											   page));
+	}
+}
+
+static gpointer
+ev_sidebar_thumbnails_get_item (EvSidebarThumbnails *sidebar_thumbnails,
+				guint                position)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	EvThumbnailItem *item;
+	gchar           *page_label;
+	gchar           *page_string;
+	gint             page = position;
+
+	/* The blank item has neither a thumbnail nor a label */
+	if (priv->blank_first_dual_mode) {
+		if (position == 0)
+			return g_object_new (EV_TYPE_THUMBNAIL_ITEM, NULL);
+		page--;
+	}
+
+	page_label = ev_document_get_page_label (priv->document, page);
+	page_string = g_markup_printf_escaped ("<i>%s</i>", page_label);
+
+	item = g_object_new (EV_TYPE_THUMBNAIL_ITEM,
+			     "primary-text", page_string,
+			     "paintable", ev_sidebar_thumbnails_get_page_paintable (sidebar_thumbnails,
+										    page),
+			     NULL);
+	/* Offset by one so that the blank item has no page */
+	g_object_set_data (G_OBJECT (item), "page", GINT_TO_POINTER (page + 1));
+
+	g_free (page_label);
+	g_free (page_string);
+
+	return item;
+}
+
+static void
+ev_sidebar_thumbnails_clear_thumbnails_lru (EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GList *link;
+
+	for (link = priv->thumbnails_lru.head; link; link = link->next) {
+		gint page = GPOINTER_TO_INT (link->data);
+
+		g_clear_object (&priv->thumbnails[page]);
+		priv->thumbnail_sizes[page] = 0;
+	}
+
+	/* The links are owned by thumbnail_links */
+	g_queue_init (&priv->thumbnails_lru);
+	priv->thumbnails_size = 0;
+}
+
+static void
+ev_sidebar_thumbnails_use_thumbnail (EvSidebarThumbnails *sidebar_thumbnails,
+				     gint                 page)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GList *link = &priv->thumbnail_links[page];
+
+	if (priv->thumbnail_sizes[page] == 0)
+		return;
+
+	g_queue_unlink (&priv->thumbnails_lru, link);
+	g_queue_push_head_link (&priv->thumbnails_lru, link);
+}
+
+static void
+ev_sidebar_thumbnails_add_thumbnail (EvSidebarThumbnails *sidebar_thumbnails,
+				     gint                 page,
+				     GdkTexture          *texture)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	g_set_object (&priv->thumbnails[page], texture);
+	priv->thumbnail_sizes[page] = (gsize)gdk_texture_get_width (texture) *
+		gdk_texture_get_height (texture) * 4;
+	priv->thumbnails_size += priv->thumbnail_sizes[page];
+	priv->thumbnail_links[page].data = GINT_TO_POINTER (page);
+	g_queue_push_head_link (&priv->thumbnails_lru, &priv->thumbnail_links[page]);
+}
+
+/* Puts back the loading icon in place of the least recently used
+ * thumbnails until they fit in THUMBNAILS_MAX_SIZE. Thumbnails in the
+ * preloaded range are kept, they'd be rendered again right away.
+ */
+static void
+ev_sidebar_thumbnails_evict_thumbnails (EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GList *link, *prev;
+
+	for (link = priv->thumbnails_lru.tail;
+	     link && priv->thumbnails_size > THUMBNAILS_MAX_SIZE;
+	     link = prev) {
+		gint page = GPOINTER_TO_INT (link->data);
+
+		prev = link->prev;
+
+		if (page >= priv->start_page && page <= priv->end_page)
+			continue;
+
+		g_queue_unlink (&priv->thumbnails_lru, link);
+		priv->thumbnails_size -= priv->thumbnail_sizes[page];
+		priv->thumbnail_sizes[page] = 0;
+		g_clear_object (&priv->thumbnails[page]);
+
+		ev_sidebar_thumbnails_update_item (sidebar_thumbnails, page);
+	}
+}
+
 static void
 cancel_running_jobs (EvSidebarThumbnails *sidebar_thumbnails,
 		     gint                 start_page,
 		     gint                 end_page)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreePath *path;
-	GtkTreeIter iter;
-	gboolean result;
+	gint page;
 
 	g_assert (start_page <= end_page);
 
-	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
-	     result && start_page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), start_page ++) {
-		EvJobThumbnailCairo *job;
-		gboolean thumbnail_set;
-
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store),
-				    &iter,
-				    COLUMN_JOB, &job,
-				    COLUMN_THUMBNAIL_SET, &thumbnail_set,
-				    -1);
-
-		if (thumbnail_set) {
-			g_assert (job == NULL);
-			continue;
-		}
+	for (page = start_page; page <= end_page; page++) {
+		EvJob *job = priv->jobs[page];
 
-		if (job) {
-			g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
-			ev_job_cancel (EV_JOB (job));
-			g_object_unref (job);
-		}
+		if (!job)
+			continue;
 
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_JOB, NULL,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    -1);
+		g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
+		ev_job_cancel (job);
+		g_clear_object (&priv->jobs[page]);
 	}
-	gtk_tree_path_free (path);
 }
 
 static void
@@ -458,57 +741,36 @@ add_range (EvSidebarThumbnails *sidebar_thumbnails,
 	   gint                 end_page)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreePath *path;
-	GtkTreeIter iter;
-	gboolean result;
-	gint page = start_page;
+	gint page;
 
 	g_assert (start_page <= end_page);
 
-	if (priv->blank_first_dual_mode)
-		page--;
-
-	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
-	     result && page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), page ++) {
+	for (page = start_page; page <= end_page; page++) {
 		EvJob *job;
-		gboolean thumbnail_set;
-
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store), &iter,
-				    COLUMN_JOB, &job,
-				    COLUMN_THUMBNAIL_SET, &thumbnail_set,
-				    -1);
-
-		if (job == NULL && !thumbnail_set) {
-			gint thumbnail_width, thumbnail_height;
-			get_size_for_page (sidebar_thumbnails, page, &thumbnail_width, &thumbnail_height);
-
-			job = ev_job_thumbnail_cairo_new_with_target_size (priv->document,
-									   page, priv->rotation,
-									   thumbnail_width,
-									   thumbnail_height);
-			g_object_set_data_full (G_OBJECT (job), "tree_iter",
-						gtk_tree_iter_copy (&iter),
-						(GDestroyNotify) gtk_tree_iter_free);
-			g_signal_connect (job, "finished",
-					  G_CALLBACK (thumbnail_job_completed_callback),
-					  sidebar_thumbnails);
-			gtk_list_store_set (priv->list_store, &iter,
-					    COLUMN_JOB, job,
-					    -1);
-			ev_job_scheduler_push_job (EV_JOB (job), EV_JOB_PRIORITY_HIGH);
-
-			/* The queue and the list own a ref to the job now */
-			g_object_unref (job);
-		} else if (job) {
-			g_object_unref (job);
+		gint   thumbnail_width, thumbnail_height;
+
+		if (priv->thumbnails[page]) {
+			ev_sidebar_thumbnails_use_thumbnail (sidebar_thumbnails, page);
+			continue;
 		}
+
+		if (priv->jobs[page])
+			continue;
+
+		get_size_for_page (sidebar_thumbnails, page, &thumbnail_width, &thumbnail_height);
+
+		job = ev_job_thumbnail_cairo_new_with_target_size (priv->document,
+								   page, priv->rotation,
+								   thumbnail_width,
+								   thumbnail_height);
+		g_signal_connect (job, "finished",
+				  G_CALLBACK (thumbnail_job_completed_callback),
+				  sidebar_thumbnails);
+		priv->jobs[page] = job;
+		ev_job_scheduler_push_job (job, EV_JOB_PRIORITY_HIGH);
 	}
-	gtk_tree_path_free (path);
 }
 
-/* This modifies start */
 static void
 update_visible_range (EvSidebarThumbnails *sidebar_thumbnails,
 		      gint                 start_page,
@@ -546,150 +808,137 @@ update_visible_range (EvSidebarThumbnails *sidebar_thumbnails,
 }
 
 static void
-adjustment_changed_cb (EvSidebarThumbnails *sidebar_thumbnails)
+ev_sidebar_thumbnails_update_range (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreePath *path = NULL;
-	GtkTreePath *path2 = NULL;
-	gdouble page_size;
+	guint start, end;
+
+	priv->update_range_id = 0;
 
 	/* Widget is not currently visible */
 	if (!gtk_widget_get_mapped (GTK_WIDGET (sidebar_thumbnails)))
 		return;
 
-	page_size = gtk_adjustment_get_page_size (priv->vadjustment);
-
-	if (page_size == 0)
+	if (!priv->document || priv->n_pages <= 0)
 		return;
 
-	if (priv->icon_view) {
-		if (! gtk_widget_get_realized (priv->icon_view))
-			return;
-		if (! gtk_icon_view_get_visible_range (GTK_ICON_VIEW (priv->icon_view), &path, &path2))
-			return;
-	} else {
+	if (!ev_sidebar_thumbnails_get_bound_range (sidebar_thumbnails, &start, &end))
 		return;
-	}
 
-	if (path && path2) {
-		update_visible_range (sidebar_thumbnails,
-				      gtk_tree_path_get_indices (path)[0],
-				      gtk_tree_path_get_indices (path2)[0]);
+	if (priv->blank_first_dual_mode) {
+		start = MAX (start, 1) - 1;
+		end = MAX (end, 1) - 1;
 	}
 
-	gtk_tree_path_free (path);
-	gtk_tree_path_free (path2);
+	update_visible_range (sidebar_thumbnails,
+			      MIN (start, (guint)priv->n_pages - 1),
+			      MIN (end, (guint)priv->n_pages - 1));
 }
 
-static GdkTexture *
-gdk_texture_new_for_surface (cairo_surface_t *surface)
+/* The view binds and unbinds several items at once while scrolling */
+static void
+ev_sidebar_thumbnails_queue_update_range (EvSidebarThumbnails *sidebar_thumbnails)
 {
-  GdkTexture *texture;
-  GBytes *bytes;
-
-  g_return_val_if_fail (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE, NULL);
-  g_return_val_if_fail (cairo_image_surface_get_width (surface) > 0, NULL);
-  g_return_val_if_fail (cairo_image_surface_get_height (surface) > 0, NULL);
-
-  bytes = g_bytes_new_with_free_func (cairo_image_surface_get_data (surface),
-                                      cairo_image_surface_get_height (surface)
-                                      * cairo_image_surface_get_stride (surface),
-                                      (GDestroyNotify) cairo_surface_destroy,
-                                      cairo_surface_reference (surface));
-
-  texture = gdk_memory_texture_new (cairo_image_surface_get_width (surface),
-                                    cairo_image_surface_get_height (surface),
-                                    GDK_MEMORY_DEFAULT,
-                                    bytes,
-                                    cairo_image_surface_get_stride (surface));
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 
-  g_bytes_unref (bytes);
+	if (priv->update_range_id)
+		return;
 
-  return texture;
+	priv->update_range_id =
+		g_idle_add_once ((GSourceOnceFunc)ev_sidebar_thumbnails_update_range,
+				 sidebar_thumbnails);
 }
 
 static void
-ev_sidebar_thumbnails_fill_model (EvSidebarThumbnails *sidebar_thumbnails)
+ev_sidebar_thumbnails_setup_item (GtkSignalListItemFactory *factory,
+				  GtkListItem              *list_item,
+				  EvSidebarThumbnails      *sidebar_thumbnails)
 {
-	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreeIter iter;
-	int i;
-	gint prev_width = -1;
-	gint prev_height = -1;
-
-	for (i = 0; i < sidebar_thumbnails->priv->n_pages; i++) {
-		gchar     *page_label;
-		gchar     *page_string;
-		cairo_surface_t *loading_icon = NULL;
-		GdkTexture *texture;
-		gint       width, height;
-
-		page_label = ev_document_get_page_label (priv->document, i);
-		page_string = g_markup_printf_escaped ("<i>%s</i>", page_label);
-		ev_thumbnails_size_cache_get_size (sidebar_thumbnails->priv->size_cache, i,
-						  sidebar_thumbnails->priv->rotation,
-						  &width, &height);
-		if (!loading_icon || (width != prev_width && height != prev_height)) {
-			loading_icon =
-				ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails,
-									width, height);
-		}
+	GtkWidget     *box;
+	GtkWidget     *picture;
+	GtkWidget     *label;
+	GtkExpression *expression;
+
+	box = gtk_box_new (GTK_ORIENTATION_VERTICAL, THUMBNAIL_ITEM_PADDING);
+	gtk_widget_set_margin_top (box, THUMBNAIL_ITEM_PADDING);
+	gtk_widget_set_margin_bottom (box, THUMBNAIL_ITEM_PADDING);
+	gtk_widget_set_margin_start (box, THUMBNAIL_ITEM_PADDING);
+	gtk_widget_set_margin_end (box, THUMBNAIL_ITEM_PADDING);
+
+	picture = gtk_picture_new ();
+	gtk_picture_set_can_shrink (GTK_PICTURE (picture), FALSE);
+	gtk_widget_set_halign (picture, GTK_ALIGN_CENTER);
+	gtk_widget_set_valign (picture, GTK_ALIGN_END);
+	gtk_widget_set_vexpand (picture, TRUE);
+	gtk_box_append (GTK_BOX (box), picture);
+
+	label = gtk_label_new (NULL);
+	gtk_label_set_use_markup (GTK_LABEL (label), TRUE);
+	gtk_label_set_justify (GTK_LABEL (label), GTK_JUSTIFY_CENTER);
+	gtk_label_set_wrap (GTK_LABEL (label), TRUE);
+	gtk_label_set_wrap_mode (GTK_LABEL (label), PANGO_WRAP_CHAR);
+	gtk_label_set_max_width_chars (GTK_LABEL (label), 1);
+	gtk_widget_set_size_request (label, THUMBNAIL_WIDTH, -1);
+	gtk_widget_set_halign (label, GTK_ALIGN_CENTER);
+	gtk_box_append (GTK_BOX (box), label);
+
+	expression = gtk_property_expression_new (GTK_TYPE_LIST_ITEM, NULL, "item");
+	expression = gtk_property_expression_new (EV_TYPE_THUMBNAIL_ITEM, expression, "paintable");
+	gtk_expression_bind (expression, picture, "paintable", list_item);
+
+	expression = gtk_property_expression_new (GTK_TYPE_LIST_ITEM, NULL, "item");
+	expression = gtk_property_expression_new (EV_TYPE_THUMBNAIL_ITEM, expression, "primary-text");
+	gtk_expression_bind (expression, label, "label", list_item);
+
+	gtk_list_item_set_child (list_item, box);
+}
 
-		prev_width = width;
-		prev_height = height;
+static void
+ev_sidebar_thumbnails_bind_item (GtkSignalListItemFactory *factory,
+				 GtkListItem              *list_item,
+				 EvSidebarThumbnails      *sidebar_thumbnails)
+{
+	g_hash_table_add (sidebar_thumbnails->priv->bound_items, list_item);
+	ev_sidebar_thumbnails_queue_update_range (sidebar_thumbnails);
+}
 
-		texture = gdk_texture_new_for_surface (loading_icon);
+static void
+ev_sidebar_thumbnails_unbind_item (GtkSignalListItemFactory *factory,
+				   GtkListItem              *list_item,
+				   EvSidebarThumbnails      *sidebar_thumbnails)
+{
+	if (!sidebar_thumbnails->priv->bound_items)
+		return;
 
-		gtk_list_store_append (priv->list_store, &iter);
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_PAGE_STRING, page_string,
-				    COLUMN_SURFACE, texture,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    -1);
-		g_free (page_label);
-		g_free (page_string);
-		cairo_surface_destroy (loading_icon);
-	}
+	g_hash_table_remove (sidebar_thumbnails->priv->bound_items, list_item);
+	ev_sidebar_thumbnails_queue_update_range (sidebar_thumbnails);
 }
 
 static void
-ev_sidebar_icon_selection_changed (GtkIconView         *icon_view,
-				   EvSidebarThumbnails *ev_sidebar_thumbnails)
+ev_sidebar_thumbnails_selection_changed (GtkSingleSelection  *selection,
+					 GParamSpec          *pspec,
+					 EvSidebarThumbnails *ev_sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = ev_sidebar_thumbnails->priv;
-	GtkTreePath *path;
-	GList *selected;
-	int page;
+	guint page;
 
-	selected = gtk_icon_view_get_selected_items (icon_view);
-	if (selected == NULL)
+	page = gtk_single_selection_get_selected (selection);
+	if (page == GTK_INVALID_LIST_POSITION)
 		return;
 
-	/* We don't handle or expect multiple selection. */
-	g_assert (selected->next == NULL);
-
-	path = selected->data;
-	page = gtk_tree_path_get_indices (path)[0];
-
 	if (priv->blank_first_dual_mode) {
 		if (page == 0) {
-			gtk_icon_view_unselect_path (icon_view, path);
-			gtk_tree_path_free (path);
-			g_list_free (selected);
+			gtk_single_selection_set_selected (selection, GTK_INVALID_LIST_POSITION);
 			return;
 		}
 		page--;
-
 	}
 
-	gtk_tree_path_free (path);
-	g_list_free (selected);
-
 	ev_document_model_set_page (priv->model, page);
 }
 
 static void
-ev_sidebar_init_icon_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
+ev_sidebar_init_grid_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv;
 
@@ -714,44 +963,22 @@ ev_sidebar_thumbnails_device_scale_factor_changed_cb (EvSidebarThumbnails *sideb
         ev_sidebar_thumbnails_reload (sidebar_thumbnails);
 }
 
-static void
-ev_sidebar_thumbnails_row_changed (GtkTreeModel *model,
-                                   GtkTreePath  *path,
-                                   GtkTreeIter  *iter,
-                                   gpointer      data)
-{
-	guint signal_id;
-
-	signal_id = GPOINTER_TO_UINT (data);
-
-	/* PREVENT GtkIconView "row-changed" handler to be reached, as it will
-	 * perform a full invalidate and relayout of all items, See bug:
-	 * https://bugzilla.gnome.org/show_bug.cgi?id=691448#c9 */
-	g_signal_stop_emission (model, signal_id, 0);
-}
-
 static void
 ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv;
-	guint signal_id;
 
 	priv = ev_sidebar_thumbnails->priv = ev_sidebar_thumbnails_get_instance_private (ev_sidebar_thumbnails);
 	priv->blank_first_dual_mode = FALSE;
+	priv->start_page = -1;
+	priv->end_page = -1;
+	priv->bound_items = g_hash_table_new (NULL, NULL);
 
 	gtk_widget_init_template (GTK_WIDGET (ev_sidebar_thumbnails));
 
-	signal_id = g_signal_lookup ("row-changed", GTK_TYPE_TREE_MODEL);
-	g_signal_connect (GTK_TREE_MODEL (priv->list_store), "row-changed",
-			  G_CALLBACK (ev_sidebar_thumbnails_row_changed),
-			  GUINT_TO_POINTER (signal_id));
-
-
-	priv->vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (priv->swindow));
-	g_signal_connect_data (priv->vadjustment, "value-changed",
-			       G_CALLBACK (adjustment_changed_cb),
-			       ev_sidebar_thumbnails, NULL,
-			       G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+	priv->list = g_object_new (EV_TYPE_SIDEBAR_THUMBNAILS_LIST, NULL);
+	priv->list->sidebar = ev_sidebar_thumbnails;
+	gtk_single_selection_set_model (priv->selection, G_LIST_MODEL (priv->list));
 
 	g_signal_connect (ev_sidebar_thumbnails, "notify::scale-factor",
 			  G_CALLBACK (ev_sidebar_thumbnails_device_scale_factor_changed_cb), NULL);
@@ -761,29 +988,23 @@ static void
 ev_sidebar_thumbnails_set_current_page (EvSidebarThumbnails *sidebar,
 					gint                 page)
 {
-	GtkTreePath *path;
+	EvSidebarThumbnailsPrivate *priv = sidebar->priv;
 
-	if (sidebar->priv->blank_first_dual_mode)
+	if (priv->blank_first_dual_mode)
 		page++;
 
-	path = gtk_tree_path_new_from_indices (page, -1);
-
-	if (sidebar->priv->icon_view) {
-
-		g_signal_handlers_block_by_func
-			(sidebar->priv->icon_view,
-			 G_CALLBACK (ev_sidebar_icon_selection_changed), sidebar);
-
-		gtk_icon_view_select_path (GTK_ICON_VIEW (sidebar->priv->icon_view), path);
-
-		g_signal_handlers_unblock_by_func
-			(sidebar->priv->icon_view,
-			 G_CALLBACK (ev_sidebar_icon_selection_changed), sidebar);
+	if (page < 0 || (guint)page >= priv->n_items)
+		return;
 
-		gtk_icon_view_scroll_to_path (GTK_ICON_VIEW (sidebar->priv->icon_view), path, FALSE, 0.0, 0.0);
-	}
+	g_signal_handlers_block_by_func (priv->selection,
+					 G_CALLBACK (ev_sidebar_thumbnails_selection_changed),
+					 sidebar);
+	gtk_single_selection_set_selected (priv->selection, page);
+	g_signal_handlers_unblock_by_func (priv->selection,
+					   G_CALLBACK (ev_sidebar_thumbnails_selection_changed),
+					   sidebar);
 
-	gtk_tree_path_free (path);
+	gtk_widget_activate_action (priv->grid_view, "list.scroll-to-item", "u", page);
 }
 
 static void
@@ -797,26 +1018,25 @@ page_changed_cb (EvSidebarThumbnails *sidebar,
 static void
 ev_sidebar_thumbnails_reload (EvSidebarThumbnails *sidebar_thumbnails)
 {
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 	EvDocumentModel *model;
 
-	if (sidebar_thumbnails->priv->loading_icons)
-		g_hash_table_remove_all (sidebar_thumbnails->priv->loading_icons);
+	if (priv->loading_icons)
+		g_hash_table_remove_all (priv->loading_icons);
 
-	if (sidebar_thumbnails->priv->document == NULL ||
-	    sidebar_thumbnails->priv->n_pages <= 0)
+	if (priv->document == NULL ||
+	    priv->n_pages <= 0)
 		return;
 
-	model = sidebar_thumbnails->priv->model;
+	model = priv->model;
 
 	ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
-	ev_sidebar_thumbnails_fill_model (sidebar_thumbnails);
+	ev_sidebar_thumbnails_set_n_items (sidebar_thumbnails, priv->n_items);
 
 	/* Trigger a redraw */
-	sidebar_thumbnails->priv->start_page = -1;
-	sidebar_thumbnails->priv->end_page = -1;
 	ev_sidebar_thumbnails_set_current_page (sidebar_thumbnails,
 						ev_document_model_get_page (model));
-	g_idle_add_once ((GSourceOnceFunc)adjustment_changed_cb, sidebar_thumbnails);
+	ev_sidebar_thumbnails_queue_update_range (sidebar_thumbnails);
 }
 
 static void
@@ -847,10 +1067,10 @@ thumbnail_job_completed_callback (EvJobThumbnailCairo *job,
 {
         GtkWidget                  *widget = GTK_WIDGET (sidebar_thumbnails);
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreeIter                *iter;
         cairo_surface_t            *surface;
 	GdkTexture                 *texture;
         gint                        device_scale;
+	gint                        page = job->page;
 
         if (ev_job_is_failed (EV_JOB (job)))
           return;
@@ -862,21 +1082,66 @@ thumbnail_job_completed_callback (EvJobThumbnailCairo *job,
                                                                         job->thumbnail_surface,
                                                                         -1, -1);
 
-	iter = (GtkTreeIter *) g_object_get_data (G_OBJECT (job), "tree_iter");
 	if (priv->inverted_colors)
 		ev_document_misc_invert_surface (surface);
 
 	texture = gdk_texture_new_for_surface (surface);
 
-	gtk_list_store_set (priv->list_store,
-			    iter,
-			    COLUMN_SURFACE, texture,
-			    COLUMN_THUMBNAIL_SET, TRUE,
-			    COLUMN_JOB, NULL,
-			    -1);
+	ev_sidebar_thumbnails_add_thumbnail (sidebar_thumbnails, page, texture);
+	ev_sidebar_thumbnails_update_item (sidebar_thumbnails, page);
+	ev_sidebar_thumbnails_evict_thumbnails (sidebar_thumbnails);
+
+	g_object_unref (texture);
         cairo_surface_destroy (surface);
 
-	gtk_widget_queue_draw (priv->icon_view);
+	/* Drops the last reference to the job */
+	g_clear_object (&priv->jobs[page]);
+}
+
+/* Returns the thumbnails of the pages of @document, a new version of
+ * the current document, that didn't change, least recently used first.
+ */
+static GList *
+ev_sidebar_thumbnails_get_unchanged_thumbnails (EvSidebarThumbnails *sidebar_thumbnails,
+						EvDocument          *document)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GList *thumbnails = NULL;
+	GList *link;
+
+	if (!priv->document || !ev_document_get_page_fingerprint (document, 0))
+		return NULL;
+
+	for (link = priv->thumbnails_lru.head; link; link = link->next) {
+		gint        page = GPOINTER_TO_INT (link->data);
+		GdkTexture *texture = priv->thumbnails[page];
+
+		if (!ev_document_page_is_unchanged (document, priv->document, page))
+			continue;
+
+		g_object_set_data (G_OBJECT (texture), "page", GINT_TO_POINTER (page));
+		thumbnails = g_list_prepend (thumbnails, g_object_ref (texture));
+	}
+
+	return thumbnails;
+}
+
+static void
+ev_sidebar_thumbnails_restore_thumbnails (EvSidebarThumbnails *sidebar_thumbnails,
+					  GList               *thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GList *l;
+
+	for (l = thumbnails; l; l = l->next) {
+		GdkTexture *texture = l->data;
+		gint        page = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (texture), "page"));
+
+		if (page >= priv->n_pages)
+			continue;
+
+		ev_sidebar_thumbnails_add_thumbnail (sidebar_thumbnails, page, texture);
+	}
 }
 
 static void
@@ -886,15 +1151,33 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 {
 	EvDocument *document = ev_document_model_get_document (model);
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GList *thumbnails;
+	gboolean init_grid_view;
 
 	if (ev_document_get_n_pages (document) <= 0 ||
 	    !ev_document_check_dimensions (document)) {
 		return;
 	}
 
+	/* Thumbnails of the pages that didn't change on reload are kept */
+	thumbnails = ev_sidebar_thumbnails_get_unchanged_thumbnails (sidebar_thumbnails,
+								     document);
+	init_grid_view = priv->document == NULL;
+
+	if (priv->document)
+		ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
+
 	priv->size_cache = ev_thumbnails_size_cache_get (document);
-	priv->document = document;
+	g_set_object (&priv->document, document);
 	priv->n_pages = ev_document_get_n_pages (document);
+	g_free (priv->thumbnails);
+	priv->thumbnails = g_new0 (GdkTexture *, priv->n_pages);
+	g_free (priv->jobs);
+	priv->jobs = g_new0 (EvJob *, priv->n_pages);
+	g_free (priv->thumbnail_links);
+	priv->thumbnail_links = g_new0 (GList, priv->n_pages);
+	g_free (priv->thumbnail_sizes);
+	priv->thumbnail_sizes = g_new0 (gsize, priv->n_pages);
 	priv->rotation = ev_document_model_get_rotation (model);
 	priv->inverted_colors = ev_document_model_get_inverted_colors (model);
 	if (priv->loading_icons) {
@@ -903,17 +1186,17 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
                 priv->loading_icons = g_hash_table_new_full (g_str_hash,
                                                              g_str_equal,
                                                              (GDestroyNotify)g_free,
-                                                             (GDestroyNotify)cairo_surface_destroy);
+                                                             (GDestroyNotify)g_object_unref);
 	}
 
-	ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
-	ev_sidebar_thumbnails_fill_model (sidebar_thumbnails);
+	ev_sidebar_thumbnails_restore_thumbnails (sidebar_thumbnails, thumbnails);
+	g_list_free_full (thumbnails, g_object_unref);
 
-	if (! priv->icon_view) {
-		ev_sidebar_init_icon_view (sidebar_thumbnails);
-	} else {
-		gtk_widget_queue_resize (priv->icon_view);
-	}
+	ev_sidebar_thumbnails_set_n_items (sidebar_thumbnails,
+					   priv->n_pages + (priv->blank_first_dual_mode ? 1 : 0));
+
+	if (init_grid_view)
+		ev_sidebar_init_grid_view (sidebar_thumbnails);
 
 	/* Connect to the signal and trigger a fake callback */
 	g_signal_connect_swapped (priv->model, "page-changed",
@@ -925,11 +1208,9 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 	g_signal_connect (priv->model, "notify::inverted-colors",
 			  G_CALLBACK (ev_sidebar_thumbnails_inverted_colors_changed_cb),
 			  sidebar_thumbnails);
-	sidebar_thumbnails->priv->start_page = -1;
-	sidebar_thumbnails->priv->end_page = -1;
 	ev_sidebar_thumbnails_set_current_page (sidebar_thumbnails,
 						ev_document_model_get_page (model));
-	adjustment_changed_cb (sidebar_thumbnails);
+	ev_sidebar_thumbnails_queue_update_range (sidebar_thumbnails);
 }
 
 static void
@@ -948,32 +1229,19 @@ ev_sidebar_thumbnails_set_model (EvSidebarPage   *sidebar_page,
 			  sidebar_page);
 }
 
-static gboolean
-ev_sidebar_thumbnails_clear_job (GtkTreeModel *model,
-			         GtkTreePath *path,
-			         GtkTreeIter *iter,
-				 gpointer data)
-{
-	EvJob *job;
-
-	gtk_tree_model_get (model, iter, COLUMN_JOB, &job, -1);
-
-	if (job != NULL) {
-		ev_job_cancel (job);
-		g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, data);
-		g_object_unref (job);
-	}
-
-	return FALSE;
-}
-
+/* Cancels the jobs and drops the rendered thumbnails */
 static void
 ev_sidebar_thumbnails_clear_model (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 
-	gtk_tree_model_foreach (GTK_TREE_MODEL (priv->list_store), ev_sidebar_thumbnails_clear_job, sidebar_thumbnails);
-	gtk_list_store_clear (priv->list_store);
+	if (priv->start_page >= 0 && priv->end_page >= priv->start_page)
+		cancel_running_jobs (sidebar_thumbnails, priv->start_page, priv->end_page);
+	if (priv->thumbnails)
+		ev_sidebar_thumbnails_clear_thumbnails_lru (sidebar_thumbnails);
+
+	priv->start_page = -1;
+	priv->end_page = -1;
 }
 
 static gboolean
@@ -990,26 +1258,6 @@ ev_sidebar_thumbnails_page_iface_init (EvSidebarPageInterface *iface)
 	iface->set_model = ev_sidebar_thumbnails_set_model;
 }
 
-static gboolean
-iter_is_blank_thumbnail (GtkTreeModel *tree_model,
-			 GtkTreeIter  *iter)
-{
-	GdkTexture *texture = NULL;
-	EvJob *job = NULL;
-	gboolean thumbnail_set = FALSE;
-
-	gtk_tree_model_get (tree_model, iter,
-			    COLUMN_SURFACE, &texture,
-			    COLUMN_THUMBNAIL_SET, &thumbnail_set,
-			    COLUMN_JOB, &job, -1);
-
-	/* The blank thumbnail item can be distinguished among all
-	 * other items in the GtkIconView as it's the only one which
-	 * has the COLUMN_SURFACE as NULL while COLUMN_THUMBNAIL_SET
-	 * is set to TRUE. */
-	return texture == NULL && job == NULL && thumbnail_set;
-}
-
 /* Returns the total horizontal(left+right) width of thumbnail frames.
  * As it was added in ev_document_misc_render_thumbnail_frame() */
 static gint
@@ -1061,43 +1309,26 @@ ev_sidebar_thumbnails_get_column_widths (EvSidebarThumbnails *sidebar,
 					 gint *three_columns_width)
 {
 	EvSidebarThumbnailsPrivate *priv;
-	GtkIconView *icon_view;
-	gint margin, column_spacing, item_padding, thumbnail_width;
+	gint item_width, thumbnail_width;
 	static gint frame_horizontal_width;
 
 	priv = sidebar->priv;
-	icon_view = GTK_ICON_VIEW (priv->icon_view);
 
 	ev_thumbnails_size_cache_get_size (priv->size_cache, 0,
 					   priv->rotation,
 					   &thumbnail_width, NULL);
 
-	margin = gtk_icon_view_get_margin (icon_view);
-	column_spacing = gtk_icon_view_get_column_spacing (icon_view);
-	item_padding = gtk_icon_view_get_item_padding (icon_view);
 	frame_horizontal_width = ev_sidebar_thumbnails_frame_horizontal_width (sidebar);
-
-	if (one_column_width) {
-		*one_column_width = 2 * margin +
-				    2 * item_padding +
-				    1 * frame_horizontal_width +
-				    1 * thumbnail_width +
-				    column_spacing;
-	}
-	if (two_columns_width) {
-		*two_columns_width = 2 * margin +
-				     4 * item_padding +
-				     2 * frame_horizontal_width +
-				     2 * thumbnail_width +
-				     column_spacing;
-	}
-	if (three_columns_width) {
-		*three_columns_width = 2 * margin +
-				       6 * item_padding +
-				       3 * frame_horizontal_width +
-				       3 * thumbnail_width +
-				       2 * column_spacing;
-	}
+	item_width = 2 * THUMBNAIL_ITEM_PADDING +
+		     frame_horizontal_width +
+		     MAX (thumbnail_width, THUMBNAIL_WIDTH);
+
+	if (one_column_width)
+		*one_column_width = 2 * THUMBNAIL_ITEM_MARGIN + 1 * item_width;
+	if (two_columns_width)
+		*two_columns_width = 2 * THUMBNAIL_ITEM_MARGIN + 2 * item_width;
+	if (three_columns_width)
+		*three_columns_width = 2 * THUMBNAIL_ITEM_MARGIN + 3 * item_width;
 }
 
 static void
@@ -1211,9 +1442,7 @@ check_toggle_blank_first_dual_mode_real (EvSidebarThumbnails *sidebar_thumbnails
 					 gboolean resize_sidebar)
 {
 	EvSidebarThumbnailsPrivate *priv;
-	GtkTreeModel *tree_model;
 	EvSidebar *sidebar;
-	GtkTreeIter first;
 	gboolean should_be_enabled, is_two_columns, is_one_column, odd_pages_left, dual_mode;
 
 	priv = sidebar_thumbnails->priv;
@@ -1229,21 +1458,14 @@ check_toggle_blank_first_dual_mode_real (EvSidebarThumbnails *sidebar_thumbnails
 
 	if (should_be_enabled && !priv->blank_first_dual_mode) {
 		/* Do enable it */
-		tree_model = GTK_TREE_MODEL (priv->list_store);
-
-		if (!gtk_tree_model_get_iter_first (tree_model, &first))
+		if (priv->n_items == 0)
 			return;
 
 		if (is_two_columns || is_one_column) {
 			priv->blank_first_dual_mode = TRUE;
-			if (iter_is_blank_thumbnail (tree_model, &first))
-				return; /* extra check */
-
-			gtk_list_store_insert_with_values (priv->list_store, &first, 0,
-							   COLUMN_SURFACE, NULL,
-							   COLUMN_THUMBNAIL_SET, TRUE,
-							   COLUMN_JOB, NULL,
-							   -1);
+			priv->n_items++;
+			g_list_model_items_changed (G_LIST_MODEL (priv->list), 0, 0, 1);
+			ev_sidebar_thumbnails_queue_update_range (sidebar_thumbnails);
 		}
 		if (resize_sidebar && is_one_column) {
 			sidebar = ev_sidebar_thumbnails_get_ev_sidebar (sidebar_thumbnails);
@@ -1254,16 +1476,13 @@ check_toggle_blank_first_dual_mode_real (EvSidebarThumbnails *sidebar_thumbnails
 		}
 	} else if (!should_be_enabled && priv->blank_first_dual_mode) {
 		/* Do disable it */
-		tree_model = GTK_TREE_MODEL (priv->list_store);
-
-		if (!gtk_tree_model_get_iter_first (tree_model, &first))
+		if (priv->n_items == 0)
 			return;
 
 		priv->blank_first_dual_mode = FALSE;
-		if (!iter_is_blank_thumbnail (tree_model, &first))
-			return; /* extra check */
-
-		gtk_list_store_remove (priv->list_store, &first);
+		priv->n_items--;
+		g_list_model_items_changed (G_LIST_MODEL (priv->list), 0, 1, 0);
+		ev_sidebar_thumbnails_queue_update_range (sidebar_thumbnails);
 
 		if (resize_sidebar && is_two_columns) {
 			sidebar = ev_sidebar_thumbnails_get_ev_sidebar (sidebar_thumbnails);
@@ -1321,11 +1540,14 @@ ev_sidebar_thumbnails_class_init (EvSidebarThumbnailsClass *ev_sidebar_thumbnail
 
 	gtk_widget_class_set_template_from_resource (widget_class,
 				"/org/gnome/evince/ui/sidebar-thumbnails.ui");
-	gtk_widget_class_bind_template_child_private (widget_class, EvSidebarThumbnails, icon_view);
-	gtk_widget_class_bind_template_child_private (widget_class, EvSidebarThumbnails, list_store);
+	gtk_widget_class_bind_template_child_private (widget_class, EvSidebarThumbnails, grid_view);
+	gtk_widget_class_bind_template_child_private (widget_class, EvSidebarThumbnails, selection);
 	gtk_widget_class_bind_template_child_private (widget_class, EvSidebarThumbnails, swindow);
 
-	gtk_widget_class_bind_template_callback (widget_class, ev_sidebar_icon_selection_changed);
+	gtk_widget_class_bind_template_callback (widget_class, ev_sidebar_thumbnails_setup_item);
+	gtk_widget_class_bind_template_callback (widget_class, ev_sidebar_thumbnails_bind_item);
+	gtk_widget_class_bind_template_callback (widget_class, ev_sidebar_thumbnails_unbind_item);
+	gtk_widget_class_bind_template_callback (widget_class, ev_sidebar_thumbnails_selection_changed);
 
 	g_object_class_override_property (g_object_class, PROP_WIDGET, "main-widget");
 	g_object_class_override_property (g_object_class, PROP_DOCUMENT_MODEL, "document-model");
@@ -2332,18 +2332,16 @@ ev_window_open_uri (EvWindow       *ev_window,
 	else
 		priv->uri = g_strdup (uri);
 
+	if (priv->metadata)
+		ev_metadata_flush (priv->metadata);
 	g_clear_object (&priv->metadata);
 	g_clear_object (&priv->bookmarks);
 
-	if (ev_is_metadata_supported_for_file (source_file)) {
-		priv->metadata = ev_metadata_new (source_file);
-		ev_window_init_metadata_with_default_values (ev_window);
-		if (priv->metadata) {
-			priv->bookmarks = ev_bookmarks_new (priv->metadata);
-			ev_sidebar_bookmarks_set_bookmarks (EV_SIDEBAR_BOOKMARKS (priv->sidebar_bookmarks),
-							    priv->bookmarks);
-		}
-	}
+	priv->metadata = ev_metadata_new (source_file);
+	ev_window_init_metadata_with_default_values (ev_window);
+	priv->bookmarks = ev_bookmarks_new (priv->metadata);
+	ev_sidebar_bookmarks_set_bookmarks (EV_SIDEBAR_BOOKMARKS (priv->sidebar_bookmarks),
+					    priv->bookmarks);
 
 	g_clear_object (&priv->dest);
 	priv->dest = dest ? g_object_ref (dest) : NULL;
@@ -2483,6 +2481,9 @@ ev_window_reload_local (EvWindow *ev_window)
 
 	uri = priv->local_uri ? priv->local_uri : priv->uri;
 	priv->reload_job = ev_job_load_new (uri);
+	/* Fingerprints tell which pages are unchanged the next time */
+	ev_job_load_set_load_flags (EV_JOB_LOAD (priv->reload_job),
+				    EV_DOCUMENT_LOAD_FLAG_FINGERPRINTS);
 	g_signal_connect (priv->reload_job, "finished",
 			  G_CALLBACK (ev_window_reload_job_cb),
 			  ev_window);
@@ -5860,6 +5861,8 @@ ev_window_dispose (GObject *object)
 #endif /* ENABLE_DBUS */
 
 	g_clear_object (&priv->bookmarks);
+	if (priv->metadata)
+		ev_metadata_flush (priv->metadata);
 	g_clear_object (&priv->metadata);
 
 	g_clear_handle_id (&priv->setup_document_idle, g_source_remove);
@@ -6578,10 +6581,10 @@ image_save_dialog_response_cb (GtkFileChooserNative *fc,
                         goto has_error;
 	}
 
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (priv->document);
 	pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (priv->document),
 					       priv->image);
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (priv->document);
 
 	file_format = gdk_pixbuf_format_get_name (format);
 	gdk_pixbuf_save (pixbuf, filename, file_format, &error, NULL);
@@ -6661,10 +6664,10 @@ ev_window_popup_cmd_copy_image (GSimpleAction *action,
 		return;
 
 	clipboard = gtk_widget_get_clipboard (GTK_WIDGET (window));
-	ev_document_doc_mutex_lock ();
+	ev_document_reader_lock (priv->document);
 	pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (priv->document),
 					       priv->image);
-	ev_document_doc_mutex_unlock ();
+	ev_document_reader_unlock (priv->document);
 
 	gdk_clipboard_set_texture (clipboard,
 			gdk_texture_new_for_pixbuf (pixbuf));
@@ -6726,11 +6729,11 @@ ev_window_popup_cmd_annot_properties_response_cb (GtkDialog	*self,
 	}
 
 	if (mask != EV_ANNOTATIONS_SAVE_NONE) {
-		ev_document_doc_mutex_lock ();
+		ev_document_writer_lock (priv->document);
 		ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (priv->document),
 							 priv->annot,
 							 mask);
-		ev_document_doc_mutex_unlock ();
+		ev_document_writer_unlock (priv->document);
 
 		/* FIXME: update annot region only */
 		ev_view_reload (EV_VIEW (priv->view));
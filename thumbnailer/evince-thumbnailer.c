@@ -162,7 +162,10 @@ evince_thumbnailer_get_document (GFile *file)
 		g_free (path);
 	}
 
-	document = ev_document_factory_get_document_full (uri, EV_DOCUMENT_LOAD_FLAG_NO_CACHE, &error);
+	document = ev_document_factory_get_document_full (uri,
+							  EV_DOCUMENT_LOAD_FLAG_NO_CACHE |
+							  EV_DOCUMENT_LOAD_FLAG_THUMBNAIL_CACHE,
+							  &error);
 	if (tmp_file) {
 		if (document) {
 			g_object_weak_ref (G_OBJECT (document),